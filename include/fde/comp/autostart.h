@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <fde/comp/compositor.h>
+
+/*
+ * [autostart] launcher. Groups start in config order; the commands of a group are spawned together
+ * with posix_spawnp (no shell, no copy of the compositor's address space). A group marked with
+ * exec_wait commands holds back the next one until those clients commit their first buffer or
+ * ready_timeout_ms passes. A client is matched to its command by PID, process group or ancestry,
+ * so wrappers that fork the real application still count. Commands without a frame stop being
+ * tracked after ready_timeout_ms (exec ones after the default when it is 0), so new surfaces do not
+ * pay for the ancestry walk forever.
+ */
+
+#define AUTOSTART_DEFAULT_READY_TIMEOUT_MS 5000
+
+typedef enum {
+    AUTOSTART_PENDING,    // Its group has not started yet
+    AUTOSTART_STARTED,    // Running, no frame yet
+    AUTOSTART_READY,      // Committed its first buffer
+    AUTOSTART_TIMED_OUT,  // No frame within ready_timeout_ms, no longer tracked
+    AUTOSTART_EXITED,     // Failed before its first frame
+    AUTOSTART_FAILED,     // Could not be spawned
+} autostart_state_t;
+
+// Copies the commands, so the config may be reloaded while groups are still waiting
+bool autostart_run(compositor_t *server, const struct autostart *config);
+// A reaped child; other PIDs are ignored
+void autostart_child_exited(pid_t pid, int status);
+void autostart_finish(void);
+
+const char *autostart_state_name(autostart_state_t state);
+// ready_usec: spawn to first frame, -1 without one
+typedef void (*autostart_iter_t)(const char *command, const char *group, pid_t pid,
+    autostart_state_t state, int64_t ready_usec, void *data);
+void autostart_for_each(autostart_iter_t iter, void *data);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <fde/comp/compositor.h>
+
+/*
+ * Screen capture: ext-image-copy-capture-v1 over our own output capture sources, one per client and
+ * output. Only the damaged rectangles of a frame are copied into the client's buffer: a GPU blit for
+ * dmabuf buffers (when the renderer exports dmabuf formats), read_pixels for shm ones. Each source
+ * copies at most [capture] max_fps frames per second; output frames in between are merged into the
+ * next one, so a greedy recorder costs at most max_fps copies per second.
+ * Copies the CPU does itself (shm client buffers from CPU-readable output buffers: pixman renderer,
+ * headless outputs) run on [capture] workers threads, split into bands of rows; the frame completes
+ * on the event loop.
+ */
+
+#define CAPTURE_DEFAULT_MAX_FPS 30
+#define CAPTURE_DEFAULT_WORKERS 2
+
+typedef struct capture_stats {
+    uint64_t frames;      // Copied into a client buffer
+    uint64_t bytes;       // Written: damaged rectangles only
+    uint64_t full_bytes;  // What whole-frame copies would have written
+    uint64_t throttled;   // Output frames merged into a later one by max_fps
+    uint64_t failed;
+    bool dmabuf;          // The last copy went to a dmabuf
+} capture_stats_t;
+
+bool capture_init(compositor_t *server, const struct capture *config);
+
+typedef void (*capture_iter_t)(pid_t pid, const char *output, const capture_stats_t *stats, void *data);
+void capture_for_each(capture_iter_t iter, void *data);
@@ -2,6 +2,7 @@
 
 #include <fde/input/seat.h>
 #include <fde/config.h>
+#include <fde/utils/hashmap.h>
 #include <dbus/dbus.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
@@ -42,9 +43,15 @@ typedef struct compositor {
     DBusConnection *dbus_conn;
     char *dbus_service_name;
     struct wl_list plugins; // plugin_instance_t
+    fde_hashmap_t plugins_by_name;
+    fde_hashmap_t plugins_by_pid;
+    fde_hashmap_t plugins_by_bus_name;
     struct wl_event_source *dbus_source;
+    struct wl_event_source *dbus_dispatch_idle;  // Drains messages queued outside dbus_fd_handler
+    struct wl_event_source *sigchld_source;
 
     const char *socket;
+    bool startup_failed;  // A required startup task failed after comp_init returned
 
     struct wlr_scene *scene;
 
@@ -57,14 +64,24 @@ typedef struct compositor {
     // Output
     struct wlr_output_layout *output_layout;
     struct wl_listener new_output;
+    struct wl_listener output_layout_change;  // Mode, scale, transform or position of an output changed
     struct wl_list outputs;
-    struct wl_list workspaces;
+
+    // Workspaces
+    struct wl_list workspaces;             // workspace_t, in config order
+    struct fde_workspace **workspace_index;  // Dense: workspace_index[ws->index]
+    size_t num_workspaces, workspace_index_cap;
+    fde_hashmap_t workspaces_by_name;
+    struct wl_list unassigned_workspaces;  // workspace_t.unassigned_link, by index
 } compositor_t;
 
 // Singleton
 extern compositor_t *server;
 
-bool comp_start(compositor_t *server);
 void comp_run(compositor_t *server);
+// Builds and starts the startup graph: everything up to the backend start runs before returning,
+// D-Bus, plugins and the cursor theme finish from the event loop
 bool comp_init(compositor_t *server);
+// First output commit: releases the startup tasks deferred until then
+void comp_first_frame(compositor_t *server);
 void comp_destroy(compositor_t *server, struct fde_config *config, char *config_path);
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <pixman.h>
+#include <stdbool.h>
+#include <wayland-server-core.h>
 #include <wayland-util.h>
 
 enum container_type {
@@ -19,6 +22,14 @@ typedef struct fde_container {
     // Основные данные окна
     struct wlr_surface *surface;          // Поверхность Wayland клиента
     struct wlr_scene_surface *scene_surface;  // Узел сцены для рендеринга surface
+    struct wl_listener output_sample;  // Tells the output whether its buffer was scanned out directly
+
+    // Occlusion: a container fully covered by opaque regions of the ones above is disabled in the scene
+    struct fde_workspace *workspace;
+    struct wl_listener surface_commit;
+    bool occluded;
+    pixman_region32_t opaque;  // Surface opaque region and size at the last pass: plain frames skip it
+    int surface_width, surface_height;
     // Позиция и размер контейнера (логические пиксели)
     int x, y;
     int width, height;
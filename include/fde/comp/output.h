@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include <wayland-server.h>
 #include <wayland-util.h>
 
@@ -9,18 +12,60 @@
 typedef struct fde_workspace workspace_t;
 typedef struct compositor compositor_t;
 
+// Commit to present of the frames committed in the frame handler. Timestamps come from the backend
+// present event (the vblank on DRM), the same ones presentation-time clients get
+typedef struct output_present_stats {
+    uint64_t presented;
+    uint64_t discarded;       // Committed but not shown (presented = false)
+    uint64_t missed_vblanks;  // Refresh intervals a frame waited past the first one
+    uint64_t latency_sum_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency_last_ns;
+    uint32_t refresh_ns;      // Last reported refresh interval, 0 = unknown (headless, VRR)
+} output_present_stats_t;
+
+// Why a frame with a fullscreen container was composited instead of scanned out
+typedef enum scanout_fallback {
+    SCANOUT_FALLBACK_SOFTWARE_CURSOR,  // Cursors drawn into the frame (screen capture locks them)
+    SCANOUT_FALLBACK_GEOMETRY,         // The buffer does not cover the output exactly
+    SCANOUT_FALLBACK_TRANSFORM,        // Buffer and output transforms differ
+    SCANOUT_FALLBACK_NOT_DMABUF,       // shm or single-pixel buffer
+    SCANOUT_FALLBACK_REJECTED,         // The backend refused it: format, modifier, planes, other visible nodes
+    SCANOUT_FALLBACK_COUNT,
+} scanout_fallback_t;
+
+typedef struct output_scanout_stats {
+    uint64_t direct;
+    uint64_t fallback[SCANOUT_FALLBACK_COUNT];
+} output_scanout_stats_t;
+
+const char *scanout_fallback_name(scanout_fallback_t reason);
+
 typedef struct fde_output {
     struct wl_list link;
     struct wlr_output *wlr_output;
     compositor_t *server;
 
     struct wl_listener frame;
+    struct wl_listener present;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 
     struct wlr_scene_output *scene_output;
 
     workspace_t *active_ws;
+
+    bool commit_pending;  // Waiting for the present event of commit_seq
+    uint32_t commit_seq;
+    struct timespec commit_time;
+    output_present_stats_t present_stats;
+
+    bool scanout_direct;  // Set during the commit by the fullscreen container's scene buffer
+    int scanout_last;     // -1: direct, else the last scanout_fallback_t, for logging changes
+    output_scanout_stats_t scanout_stats;
 } fde_output_t;
 
-void server_new_output(struct wl_listener *listener, void *data);
\ No newline at end of file
+void server_new_output(struct wl_listener *listener, void *data);
+void server_output_layout_change(struct wl_listener *listener, void *data);
+// Re-applies [outputs] settings (scale) to a running output
+void output_apply_config(fde_output_t *output);
\ No newline at end of file
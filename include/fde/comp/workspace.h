@@ -1,44 +1,73 @@
 #pragma once
 
-#define MAX_NUM_WORKSPACES 50
-#define MAX_WORKSPACE_NAME_LEN 80
-
 #include <fde/comp/compositor.h>
 #include <fde/comp/output.h>
+#include <fde/utils/intern.h>
 
 typedef struct fde_output fde_output_t;
 typedef struct compositor compositor_t;
 typedef struct fde_container fde_container_t;
+struct workspaces;
 
 typedef struct fde_workspace {
-    char name[100];
-    
+    fde_istr_t name;  // Interned, also the key in server->workspaces_by_name
+
     fde_output_t *output;
     compositor_t *server;
 
     struct wl_list containers;
     fde_container_t *focused_container;
     fde_container_t *fullscreen_container;
+    size_t occluded_containers;  // At the last occlusion pass
 
-    // Scene nodes для иерархии: root -> output -> workspace
-    struct wlr_scene_tree *scene_tree;  // Корень для workspace (добавляется в output->scene_output->scene->tree)
+    // Scene nodes для иерархии: root -> workspace. NULL until first activated; disabled while hidden
+    struct wlr_scene_tree *scene_tree;  // Корень для workspace (в server->scene->tree)
 
     // Внутри workspace: background (leaf, без детей) и container (subtree для окон)
     struct wlr_scene_rect *background_node;  // Или кастомный node для фона (e.g., изображение/3D)
     struct wlr_scene_tree *container_tree;   // Subtree для всех containers (окон)
 
     struct wl_list server_link;
+    size_t index;                  // Position in server->workspace_index
+    struct wl_list unassigned_link;  // In server->unassigned_workspaces while output == NULL
 } workspace_t;  
 
 void workspace_assign_to_output(workspace_t *ws, fde_output_t *output);
-void init_workspaces(
-    struct wl_list *ws_list,
-    char ws_names[MAX_NUM_WORKSPACES][MAX_WORKSPACE_NAME_LEN],
-    compositor_t *server
-);
+// Shows the workspace on its output and hides the one shown there before
+bool workspace_activate(workspace_t *ws);
+void workspace_hide(workspace_t *ws);
+// The output is going away: its workspaces are hidden and unassigned (their scene is kept)
+void workspace_park_output(compositor_t *server, fde_output_t *output);
+// The output changed size, scale or position in the layout: backgrounds, tree positions and
+// container layouts of its workspaces follow
+void workspace_output_changed(fde_output_t *output);
+
+workspace_t *workspace_find_by_name(compositor_t *server, const char *name);
+workspace_t *workspace_from_index(compositor_t *server, size_t index);
+// First unassigned workspace in config order, NULL when all have outputs
+workspace_t *workspace_next_unassigned(compositor_t *server);
+// Shows ws on `output`: only the previously shown tree and ws's are toggled. A workspace shown on
+// another output swaps places with the one shown on `output`
+bool workspace_switch(fde_output_t *output, workspace_t *ws);
+
+void init_workspaces(struct wl_list *ws_list, const struct workspaces *names, compositor_t *server);
+
+void finish_workspaces(compositor_t *server);
+
+// Appends a workspace without a scene (it gets one when assigned to an output)
+workspace_t *workspace_create(struct wl_list *ws_list, const char *name, compositor_t *server);
+void workspace_rename(workspace_t *ws, const char *name);
+// Only unassigned workspaces without containers can be destroyed
+bool workspace_destroy(workspace_t *ws);
 
-void workspace_init_scene(workspace_t *ws);
+bool workspace_init_scene(workspace_t *ws);
 void workspace_add_container(workspace_t *ws, fde_container_t *container);  // Добавление контейнера в scene
 void workspace_remove_container(workspace_t *ws, fde_container_t *container);  // Удаление
 void workspace_set_background_color(workspace_t *ws, float color[4]);  // Пример: настройка фона
-void workspace_update_layout(workspace_t *ws);  // Перерасположение containers в scene (позиции, z-order)
\ No newline at end of file
+void workspace_update_layout(workspace_t *ws);  // Перерасположение containers в scene (позиции, z-order)
+// Top to bottom: containers covered by the opaque regions above them are disabled in the scene, so
+// the scene walk skips them and they get no frame callbacks. Also applies fullscreen visibility
+void workspace_update_occlusion(workspace_t *ws);
+// NULL leaves fullscreen. The rest of the workspace (background, other containers) is disabled in the
+// scene meanwhile, so the output can scan the client buffer out without composition
+void workspace_set_fullscreen(workspace_t *ws, fde_container_t *container);
\ No newline at end of file
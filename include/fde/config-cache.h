@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <fde/config.h>
+
+// Compiled config cache: $XDG_CACHE_HOME/fde/config-<hash of the root path>.cache.
+// Holds every file of the include tree (dev, inode, mtime, size) and every applied value in order;
+// when none of the files changed the records are replayed from the mmapped cache without reading them.
+typedef struct config_cache_builder config_cache_builder_t;
+
+config_cache_builder_t *config_cache_builder_create(void);
+void config_cache_builder_destroy(config_cache_builder_t *builder);
+void config_cache_add_dep(config_cache_builder_t *builder, const char *path, const struct stat *sb);
+void config_cache_add_record(config_cache_builder_t *builder, uint16_t section, config_span_t key, config_span_t value, int line_num);
+bool config_cache_store(config_cache_builder_t *builder, const char *root_path);
+
+bool config_cache_load(const char *root_path, struct fde_config *config);
+
+// Provided by config.c
+uint64_t config_layout_hash(void);
+bool config_apply_value(struct fde_config *config, uint16_t section, config_span_t key, config_span_t value, int line_num);
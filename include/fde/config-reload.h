@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct compositor compositor_t;
+
+// Re-reads config->path into a fresh config, diffs it against the active one and re-applies only the
+// changed sections (plus plugins whose "<plugin>.conf" changed). On a parse error the active config is kept.
+// Emits one org.fde.Compositor.Config.ConfigChanged signal with the changed "section.key" names.
+bool config_reload(compositor_t *server);
@@ -0,0 +1,6 @@
+#pragma once
+
+// Batch validation (fde -C): every file and every *.ini of a directory is parsed on a worker pool.
+// Diagnostics go to stdout as JSON lines {"file","line","key","code","message"}, the summary with the
+// throughput to stderr. Returns the number of invalid configs.
+int config_validate_paths(char *const *paths, int num_paths, int jobs);
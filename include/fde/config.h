@@ -1,6 +1,6 @@
 #pragma once
 
-#include <fde/comp/workspace.h>
+#include <fde/utils/intern.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -18,14 +18,52 @@ typedef struct {
     size_t offset; 
 } config_key_desc_t;
 
+// Non NUL-terminated slice of the (mmapped) config file
+typedef struct {
+    const char *ptr;
+    size_t len;
+} config_span_t;
+
+typedef enum {
+    CONFIG_ERR_SYNTAX,
+    CONFIG_ERR_UNKNOWN_SECTION,
+    CONFIG_ERR_UNKNOWN_KEY,
+    CONFIG_ERR_INVALID_VALUE,
+    CONFIG_ERR_INCLUDE,
+    CONFIG_ERR_IO,
+} config_error_code_t;
+
+typedef struct config_diagnostic {
+    const char *file;  // NULL for anonymous buffers
+    int line;
+    config_error_code_t code;
+    config_span_t key;  // Empty when the error is not about a key
+    const char *message;
+} config_diagnostic_t;
+
+typedef void (*config_diag_fn_t)(const config_diagnostic_t *diag, void *data);
+
+struct fde_config;
+typedef bool (*config_section_handler_t)(config_span_t key, config_span_t value, struct fde_config *config, int line_num);
+typedef bool (*config_section_equal_t)(const struct fde_config *a, const struct fde_config *b);
+
 typedef struct {
     const char *section_name;
     config_key_desc_t *keys;
     size_t num_keys;
+    config_section_handler_t handler;  // Sections with special syntax (keys == NULL)
+    config_section_equal_t equal;      // Diff of handler sections, compared as a whole
 } config_section_desc_t;
 
+#define CONFIG_MAX_INCLUDE_DEPTH 16
+#define CONFIG_MAX_WORKSPACE_GAP 64  // wsN may skip at most this many slots
+
 struct plugins {
     char *dir;
+    int compositor_cpu_weight;
+    int call_budget_ms;
+    int demote_after;
+    int kill_after;
 };
 
 struct hotreload {
@@ -33,16 +71,65 @@ struct hotreload {
     int scan_interval;    
 };
 
+struct capture {
+    int max_fps;      // Frames copied per client and output, 0 = unlimited
+    bool screencopy;  // Also offer wlr-screencopy-unstable-v1 (whole frames, not rate limited)
+    int workers;      // Threads for CPU (shm) copies, 0 = copy on the event loop
+};
+
+// Interned names in config order; wsN keys can leave NULL gaps, the list ends at the first one
 struct workspaces {
-    char list[MAX_NUM_WORKSPACES][MAX_WORKSPACE_NAME_LEN];
+    fde_istr_t *names;
+    size_t count, capacity;
+};
+
+size_t config_workspace_count(const struct workspaces *workspaces);
+
+typedef struct output_config {
+    fde_istr_t name;
+    float scale;
+} output_config_t;
+
+// [outputs]: scale = <all outputs>, scale.<output name> = <this one>. Scales are rounded to 1/120,
+// the fractional-scale-v1 step, so clients can render exactly at device resolution
+struct outputs {
+    output_config_t *items;
+    size_t count, capacity;
+    float default_scale;  // 0 = not set
+};
+
+// 0 when neither the output nor the default has a scale
+float config_output_scale(const struct outputs *outputs, const char *name);
+
+typedef struct autostart_command {
+    char **argv;  // NULL-terminated, started without a shell
+    int group;    // Groups start in order, commands of one group together
+    bool wait;    // exec_wait: the next group waits until this client shows its first frame
+} autostart_command_t;
+
+// [autostart]: exec / exec_wait add a command to the current group, `group = <name>` starts the next one
+struct autostart {
+    autostart_command_t *commands;
+    size_t count, capacity;
+    char **group_names;  // group_names[i] of group i, NULL when unnamed
+    int groups;
+    int ready_timeout_ms;  // Per group
+    bool from_file;        // The defaults were replaced by the config file
 };
 
 struct fde_config {
     bool active; bool validating;
+    char *path;  // File the config was loaded from, used by ReloadConfig
+    const char *current_file;  // While parsing: file for error messages (changes inside include())
+    config_diag_fn_t diag;     // Diagnostics sink while validating, stderr when NULL
+    void *diag_data;
 
     struct plugins plugins;
     struct hotreload hr;
     struct workspaces workspaces;
+    struct autostart autostart;
+    struct capture capture;
+    struct outputs outputs;
 };
 
 // Singleton
@@ -51,4 +138,14 @@ extern struct fde_config default_conf;
 
 bool load_config(const char *path, struct fde_config *config);
 bool read_config(FILE *file, struct fde_config *config);
-void free_config(struct fde_config *config);
\ No newline at end of file
+bool parse_config_buffer(const char *data, size_t len, struct fde_config *config);
+// Defaults + file, returns false on any syntax or value error (unlike load_config)
+bool parse_config_file(const char *path, struct fde_config *config);
+// Like parse_config_file, but always parses (no compiled cache is read or written)
+bool validate_config_file(const char *path, struct fde_config *config);
+const char *config_error_code_name(config_error_code_t code);
+void free_config(struct fde_config *config);
+
+// Called for every key that differs between two configs (key == NULL: a handler section changed as a whole)
+typedef void (*config_diff_iter_t)(const config_section_desc_t *section, const config_key_desc_t *key, void *data);
+size_t config_diff(const struct fde_config *old, const struct fde_config *new, config_diff_iter_t iter, void *data);
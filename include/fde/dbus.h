@@ -1,8 +1,12 @@
 #pragma once
 
 #include <stdbool.h>
+#include <sys/types.h>
 #include <fde/comp/compositor.h>
 
+#define DBUS_PID_QUERY_TIMEOUT_MS 500
+#define FDE_DBUS_SERVICE_NAME "org.fde.Compositor"
+
 typedef DBusHandlerResult (*method_handler_t)(compositor_t *server, DBusMessage *msg);
 
 typedef struct {
@@ -11,6 +15,12 @@ typedef struct {
     method_handler_t handler;    // Функция-обработчик (callback, handler)
 } method_entry_t;
 
+// Session bus connection with match rules and the service name acquired. Blocks on bus round trips
+// and touches no compositor state, so it can run on a worker thread
+DBusConnection *dbus_connect(const char *service_name);
+// Event loop side: message filter, queued messages and the fd source
+bool dbus_attach(compositor_t *server, DBusConnection *conn);
+// dbus_connect + dbus_attach
 bool init_dbus(compositor_t *server);
 void cleanup_dbus(compositor_t *server);
 
@@ -25,12 +35,36 @@ method_entry_t *get_core_method_entries(void);
 
 // Handlers (примеры; добавляйте новые)
 DBusHandlerResult handle_register_plugin(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_unregister_plugin(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_plugin_resources(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_plugin_status(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_call_latency(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_reload_config(compositor_t *server, DBusMessage *msg);
 DBusHandlerResult handle_get_property(compositor_t *server, DBusMessage *msg);
 DBusHandlerResult handle_set_property(compositor_t *server, DBusMessage *msg);
 DBusHandlerResult handle_inject_input(compositor_t *server, DBusMessage *msg);  // Пример для Input
+DBusHandlerResult handle_set_log_level(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_log_levels(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_set_tracing(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_log_drop_counters(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_startup_report(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_autostart_report(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_switch_workspace(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_pool_stats(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_capture_stats(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_output_stats(compositor_t *server, DBusMessage *msg);
+DBusHandlerResult handle_get_scanout_stats(compositor_t *server, DBusMessage *msg);
 DBusHandlerResult handle_introspect(compositor_t *server, DBusMessage *msg); // Introspection XML data
 
 // Утилиты (для сигналов и т.д.)
 void send_dbus_signal(compositor_t *server, const char *interface, const char *signal_name, ...);
+// Unicast сигнал одному плагину (по unique bus name из реестра)
+void send_plugin_signal(compositor_t *server, const char *plugin_name, const char *interface, const char *signal_name, ...);
+// org.freedesktop.DBus.GetConnectionUnixProcessID without blocking the event loop: `done` runs from dispatch
+// with pid 0 when the query failed. `free_data` releases `data` after `done`, or when the query is dropped
+// with the connection. Returns false (and frees nothing) if the call could not be sent
+typedef void (*dbus_pid_reply_t)(compositor_t *server, pid_t pid, void *data);
+bool dbus_get_connection_pid(compositor_t *server, const char *bus_name, dbus_pid_reply_t done, void *data,
+    DBusFreeFunction free_data);
 // size_t get_num_plugins(compositor_t *server);  // Пример getter для свойств
 int dbus_fd_handler(int fd, uint32_t mask, void *data);  // Исправленная сигнатура
\ No newline at end of file
@@ -17,6 +17,7 @@ typedef struct fde_seat {
 
     struct wlr_cursor *cursor;
     struct wlr_xcursor_manager *cursor_mgr;
+    bool cursor_theme_ready;  // The theme is loaded off the main thread during startup
 
     struct wl_listener cursor_button;
     struct wl_listener cursor_motion_absolute;
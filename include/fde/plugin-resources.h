@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct fde_config;
+
+// cgroup v2 default cpu.weight, used for plugins without an explicit value
+#define PLUGIN_DEFAULT_CPU_WEIGHT 100
+#define COMPOSITOR_DEFAULT_CPU_WEIGHT 400
+
+// Resource settings of a single plugin, read from "<plugin>.conf" ([resources] section)
+typedef struct plugin_resources {
+    int cpu_weight;          // cpu.weight (1..10000)
+    uint64_t memory_max;     // memory.max in bytes, 0 = unlimited
+    char *cgroup_path;       // Own cgroup of the plugin, NULL when falling back to setrlimit
+} plugin_resources_t;
+
+typedef struct plugin_usage {
+    uint64_t cpu_usec;
+    uint64_t memory_bytes;
+} plugin_usage_t;
+
+// Creates the delegated subtree (<own cgroup>/compositor + <own cgroup>/plugins) and moves the compositor
+// into its leaf. Returns false when cgroups are not writable; plugins then get setrlimit limits instead.
+// compositor_cpu_weight <= 0 uses COMPOSITOR_DEFAULT_CPU_WEIGHT
+bool plugin_resources_init(int compositor_cpu_weight);
+bool plugin_resources_cgroups_available(void);
+
+void plugin_resources_defaults(plugin_resources_t *res);
+bool plugin_resources_load_conf(plugin_resources_t *res, const char *conf_path);
+
+// Parent side, before fork(): creates and configures the plugin cgroup
+bool plugin_resources_prepare(plugin_resources_t *res, const char *plugin_name);
+// Live update of a running plugin. Returns false when the new limits need a restart (no cgroup)
+bool plugin_resources_update(plugin_resources_t *res, const plugin_resources_t *updated);
+bool plugin_resources_equal(const plugin_resources_t *a, const plugin_resources_t *b);
+bool plugin_resources_set_compositor_weight(int weight);
+// Child side, after fork() and before exec(): only async-signal-safe calls
+void plugin_resources_apply_child(const plugin_resources_t *res);
+
+bool plugin_resources_get_usage(const plugin_resources_t *res, pid_t pid, plugin_usage_t *usage);
+void plugin_resources_release(plugin_resources_t *res);
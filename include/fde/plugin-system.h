@@ -2,8 +2,11 @@
 
 #include <fde/config.h>
 #include <fde/comp/compositor.h>
+#include <fde/plugin-resources.h>
+#include <fde/utils/intern.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 
 #include <dbus/dbus.h>
@@ -11,22 +14,69 @@
 
 typedef struct plugin_instance {
     pid_t pid;
-    char *name;
+    fde_istr_t name;       // Interned: the set of installed plugins is bounded
+    fde_istr_t exec_path;
     char *dbus_path;
+    char *bus_name;  // Unique bus name (":1.42") of the registered plugin, NULL until RegisterPlugin.
+                     // Not interned: every connection gets a new one
     
     struct wl_list link;
 
+    plugin_resources_t resources;
+
+    // Watchdog: missed call budgets; demoted plugins only get occasional probe calls
+    uint32_t budget_violations;
+    uint64_t violation_decay_ms;  // CLOCK_MONOTONIC, start of the current decay interval
+    uint64_t last_probe_ms;
+    bool demoted;
+
     // Metadata
     bool supports_input;
     bool supports_rendering;
     bool supports_protocols;
 } plugin_instance_t;
 
-// Функции для работы со списком (опционально, можно inline)
+bool plugin_system_init(compositor_t *server);
+void plugin_system_finish(compositor_t *server);
+
+// Registry: server->plugins plus hash indexes by name, pid and unique bus name
 void plugin_list_add(compositor_t *server, plugin_instance_t *plugin);
 void plugin_list_remove(compositor_t *server, plugin_instance_t *plugin);
+bool plugin_list_set_name(compositor_t *server, plugin_instance_t *plugin, const char *name);
+bool plugin_list_set_pid(compositor_t *server, plugin_instance_t *plugin, pid_t pid);
+bool plugin_list_set_bus_name(compositor_t *server, plugin_instance_t *plugin, const char *bus_name);
 
 plugin_instance_t *plugin_list_find_by_name(compositor_t *server, const char *name);
+plugin_instance_t *plugin_list_find_by_pid(compositor_t *server, pid_t pid);
+plugin_instance_t *plugin_list_find_by_bus_name(compositor_t *server, const char *bus_name);
+// Zeroed, from the plugin pool
+plugin_instance_t *plugin_instance_create(void);
 void plugin_instance_destroy(plugin_instance_t *plugin);
 
+// Input filter hook: plugins registered with handler_type "input" get a synchronous
+// org.fde.Plugin.Input.FilterButton(u time_msec, u button, u state) -> b consumed call, under the watchdog budget.
+// Returns true when a plugin consumed the event; a late or demoted plugin counts as "not consumed"
+bool plugins_filter_button(compositor_t *server, uint32_t time_msec, uint32_t button, uint32_t state);
+
+// Drops the plugin from the registry, emits PluginUnregistered and destroys it (the process is left alone)
+void plugin_unregister(compositor_t *server, plugin_instance_t *plugin, const char *reason);
+
+// Forks and execs a plugin executable; "<path>.conf" holds its resource limits
+plugin_instance_t *plugin_launch(compositor_t *server, const char *path, const char *name);
+// Terminates the plugin, drops it from the registry and launches the same executable again
+plugin_instance_t *plugin_restart(compositor_t *server, plugin_instance_t *plugin);
+
+// Plugin executables of a directory. Scanning touches no compositor state (worker thread is fine),
+// launching has to happen on the event loop thread
+typedef struct plugin_scan {
+    char **paths;
+    char **names;
+    int count;
+} plugin_scan_t;
+
+// dir_path may start with "~"
+bool plugin_scan_dir(const char *dir_path, plugin_scan_t *scan);
+int plugin_launch_scanned(compositor_t *server, const plugin_scan_t *scan);
+void plugin_scan_finish(plugin_scan_t *scan);
+
 bool load_plugins_from_dir(compositor_t *server, struct fde_config *config);
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <dbus/dbus.h>
+
+typedef struct compositor compositor_t;
+typedef struct plugin_instance plugin_instance_t;
+
+#define PLUGIN_DEFAULT_CALL_BUDGET_MS 8
+#define PLUGIN_DEFAULT_DEMOTE_AFTER 3
+#define PLUGIN_DEFAULT_KILL_AFTER 10
+#define PLUGIN_VIOLATION_DECAY_MS 10000  // One violation is forgiven per quiet interval
+#define PLUGIN_PROBE_INTERVAL_MS 1000    // Demoted plugins still get one call per interval
+
+#define PLUGIN_INPUT_INTERFACE "org.fde.Plugin.Input"
+
+typedef struct plugin_latency_report {
+    const char *method;  // "interface.Member"
+    uint64_t calls;
+    uint64_t timeouts;
+    uint64_t p50_usec;
+    uint64_t p99_usec;
+} plugin_latency_report_t;
+
+// Method call addressed to the plugin's bus name and object path
+DBusMessage *plugin_call_new(plugin_instance_t *plugin, const char *interface, const char *method);
+
+// Synchronous compositor->plugin call with a deadline (budget_ms <= 0 uses [plugins] call_budget_ms).
+// Returns the reply, or NULL on timeout/error or when the plugin is demoted: the caller then falls back
+// to the default behaviour. A demoted plugin still gets a probe call every PLUGIN_PROBE_INTERVAL_MS, so
+// its violations keep counting towards kill_after, and it is promoted back once they decay to 0.
+// Takes ownership of `call`.
+DBusMessage *plugin_call(compositor_t *server, plugin_instance_t *plugin, DBusMessage *call, int budget_ms);
+
+typedef void (*plugin_latency_iter_t)(const plugin_latency_report_t *report, void *data);
+void plugin_watchdog_for_each_method(plugin_latency_iter_t iter, void *data);
+void plugin_watchdog_finish(void);
@@ -7,6 +7,12 @@ struct cli_args {
     bool verbose;
     bool validate;
     bool debug;
+    bool startup_report;
+
+    // fde -C [paths...]: configs or directories of *.ini to validate
+    char **validate_paths;
+    int num_validate_paths;
+    int jobs;  // Validation threads, 0 = one per CPU
 };
 
 struct cli_args parse_cli_args(int argc, char *argv[]);
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Open addressing (linear probing) map with either string or integer keys.
+// String keys are not copied: they must stay valid while the entry exists.
+typedef struct fde_hashmap_entry {
+    uint64_t hash;  // 0 = empty, 1 = deleted
+    union {
+        const char *str_key;
+        uint64_t int_key;
+    };
+    void *value;
+} fde_hashmap_entry_t;
+
+typedef struct fde_hashmap {
+    fde_hashmap_entry_t *entries;
+    size_t capacity;  // Power of two
+    size_t count;
+    size_t used;      // count + deleted slots
+    bool str_keys;
+} fde_hashmap_t;
+
+uint64_t fde_hash_string(const char *str);
+uint64_t fde_hash_bytes(const void *data, size_t len);
+uint64_t fde_hash_int(uint64_t value);
+
+void fde_hashmap_init(fde_hashmap_t *map, bool str_keys);
+void fde_hashmap_finish(fde_hashmap_t *map);
+
+// Replaces the value of an existing key
+bool fde_hashmap_set_str(fde_hashmap_t *map, const char *key, void *value);
+void *fde_hashmap_get_str(const fde_hashmap_t *map, const char *key);
+void *fde_hashmap_remove_str(fde_hashmap_t *map, const char *key);
+
+bool fde_hashmap_set_int(fde_hashmap_t *map, uint64_t key, void *value);
+void *fde_hashmap_get_int(const fde_hashmap_t *map, uint64_t key);
+void *fde_hashmap_remove_int(fde_hashmap_t *map, uint64_t key);
+
+// Iteration: size_t it = 0; while ((entry = fde_hashmap_next(map, &it))) { ... }
+fde_hashmap_entry_t *fde_hashmap_next(const fde_hashmap_t *map, size_t *iter);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Interned names shared by the config and the compositor (workspace names and the like).
+ * Each distinct string is stored once in a chunked arena, length-prefixed and NUL-terminated.
+ * The handle is the pointer to its characters: it stays valid until fde_intern_finish(), can be
+ * used as a plain C string and as a hashmap key, and equal strings have equal handles.
+ * Strings are never freed one by one, so only names with a bounded set of values belong here.
+ */
+
+typedef const char *fde_istr_t;
+
+fde_istr_t fde_intern(const char *str);
+fde_istr_t fde_intern_len(const char *str, size_t len);
+
+static inline size_t fde_istr_len(fde_istr_t str) {
+    uint32_t len;
+    memcpy(&len, str - sizeof(len), sizeof(len));
+    return len;
+}
+
+// Equal handles <=> equal strings; NULL is only equal to NULL
+static inline int fde_istr_eq(fde_istr_t a, fde_istr_t b) {
+    return a == b;
+}
+
+void fde_intern_stats(size_t *strings, size_t *bytes);
+// Shutdown: all handles become invalid
+void fde_intern_finish(void);
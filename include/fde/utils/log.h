@@ -2,6 +2,8 @@
 
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 // #include <string.h>
 #include <wlr/util/log.h>
 #include <errno.h>
@@ -14,6 +16,36 @@ typedef enum {
 	FDE_LOG_IMPORTANCE_LAST,
 } fde_log_importance_t;
 
+// Least important level compiled in (meson -Dlog-level); fde_log calls above it compile to nothing
+#ifndef FDE_LOG_COMPILED_LEVEL
+#define FDE_LOG_COMPILED_LEVEL FDE_DEBUG
+#endif
+
+// Runtime levels per subsystem. A source file selects its subsystem with
+// `#define FDE_LOG_SUBSYSTEM FDE_LOG_INPUT` before the includes (default: FDE_LOG_CORE)
+typedef enum {
+	FDE_LOG_CORE = 0,
+	FDE_LOG_OUTPUT,
+	FDE_LOG_INPUT,
+	FDE_LOG_DBUS,
+	FDE_LOG_PLUGINS,
+	FDE_LOG_CONFIG,
+	FDE_LOG_WLR,
+	FDE_LOG_SUBSYSTEM_LAST,
+} fde_log_subsystem_t;
+
+#ifndef FDE_LOG_SUBSYSTEM
+#define FDE_LOG_SUBSYSTEM FDE_LOG_CORE
+#endif
+
+extern _Atomic uint8_t fde_log_levels[FDE_LOG_SUBSYSTEM_LAST];
+
+typedef enum {
+	LOG_PREFIX_NONE = 0,
+	LOG_PREFIX_WLR,
+	LOG_PREFIX_LAST,
+} log_prefix_t;
+
 #ifdef __GNUC__
 #define ATTRIB_PRINTF(start, end) __attribute__((format(printf, start, end)))
 #else
@@ -24,7 +56,43 @@ void error_handler(int sig);
 
 typedef void (*terminate_callback_t)(int exit_code);
 
+// Starts the writer thread: messages are queued in per-thread rings and written asynchronously
 void fde_log_init(fde_log_importance_t verbosity, terminate_callback_t terminate);
+// Waits (bounded) until every queued message is written; called on abort
+void fde_log_flush(void);
+// Flushes and joins the writer thread (registered with atexit)
+void fde_log_finish(void);
+// Messages dropped because a ring was full
+uint64_t fde_log_dropped(void);
+
+const char *fde_log_subsystem_name(fde_log_subsystem_t subsystem);
+const char *fde_log_importance_name(fde_log_importance_t importance);
+// "all" sets every subsystem; returns false for unknown names
+bool fde_log_set_level(const char *subsystem, const char *level);
+
+// Token bucket per fde_log_ratelimited call site: BURST messages at once, then PER_SEC per second.
+// Suppressed messages are counted and reported as one "repeated N times" line
+#define FDE_LOG_RATELIMIT_BURST 10
+#define FDE_LOG_RATELIMIT_PER_SEC 2
+
+typedef struct fde_log_site {
+	const char *file;
+	int line;
+	const char *format;
+	fde_log_importance_t verbosity;  // Of the last message, used for the summary
+	uint64_t refill_ns;
+	uint32_t tokens;
+	uint64_t suppressed;        // Since the last summary
+	uint64_t suppressed_total;
+	bool registered;
+	struct fde_log_site *next;
+} fde_log_site_t;
+
+bool _fde_log_site_allow(fde_log_site_t *site, fde_log_importance_t verbosity);
+
+typedef void (*fde_log_site_iter_t)(const fde_log_site_t *site, void *data);
+// Sites that have logged at least once
+void fde_log_for_each_site(fde_log_site_iter_t iter, void *data);
 fde_log_importance_t convert_wlr_log_importance(enum wlr_log_importance importance);
 
 void _fde_log(fde_log_importance_t verbosity, const char *format, ...) ATTRIB_PRINTF(2, 3);
@@ -40,11 +108,27 @@ void handle_wlr_log(enum wlr_log_importance importance, const char *fmt, va_list
 #define _FDE_FILENAME __FILE__
 #endif
 
-#define fde_log(verb, fmt, ...) \
-	_fde_log(verb, "[%s:%d] " fmt, _FDE_FILENAME, __LINE__, ##__VA_ARGS__)
+// Single load and compare at the call site; arguments are not evaluated when the level is disabled
+#define fde_log_enabled(verb) \
+	((verb) <= FDE_LOG_COMPILED_LEVEL && \
+	 (verb) <= atomic_load_explicit(&fde_log_levels[FDE_LOG_SUBSYSTEM], memory_order_relaxed))
+
+#define fde_log(verb, fmt, ...) do { \
+	if (fde_log_enabled(verb)) \
+		_fde_log(verb, "[%s:%d] " fmt, _FDE_FILENAME, __LINE__, ##__VA_ARGS__); \
+} while (0)
+
+#define fde_vlog(verb, fmt, args) do { \
+	if (fde_log_enabled(verb)) \
+		_fde_vlog(verb, "[%s:%d] " fmt, _FDE_FILENAME, __LINE__, args); \
+} while (0)
 
-#define fde_vlog(verb, fmt, args) \
-	_fde_vlog(verb, "[%s:%d] " fmt, _FDE_FILENAME, __LINE__, args)
+// For paths that can fire on every frame or event: see FDE_LOG_RATELIMIT_*
+#define fde_log_ratelimited(verb, fmt, ...) do { \
+	static fde_log_site_t _fde_log_site = { .file = _FDE_FILENAME, .line = __LINE__, .format = fmt }; \
+	if (fde_log_enabled(verb) && _fde_log_site_allow(&_fde_log_site, verb)) \
+		_fde_log(verb, "[%s:%d] " fmt, _FDE_FILENAME, __LINE__, ##__VA_ARGS__); \
+} while (0)
 
 #define fde_log_errno(verb, fmt, ...) \
 	fde_log(verb, fmt ": %s", ##__VA_ARGS__, strerror(errno))
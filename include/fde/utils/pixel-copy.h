@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CPU copies between the 32-bit layouts outputs and shm clients use: DRM_FORMAT_{X,A}RGB8888 and
+ * {X,A}BGR8888. The same channel order is copied row by row; otherwise R and B are swapped by
+ * vector kernels (GCC vector extensions, lowered to SSE2/AVX2/NEON by the compiler). X to A makes the
+ * pixels opaque. Thread-safe: no state.
+ */
+
+bool fde_pixel_copy_supported(uint32_t dst_format, uint32_t src_format);
+// Rectangle of width x height pixels; strides in bytes
+void fde_pixel_copy(void *dst, size_t dst_stride, uint32_t dst_format,
+    const void *src, size_t src_stride, uint32_t src_format, int width, int height);
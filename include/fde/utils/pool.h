@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Typed object pools for compositor objects. Objects are carved from slabs, padded to a cache line and
+ * recycled through a per-type free list, so create/destroy churn does not go through malloc and two
+ * objects never share a line. Allocation returns zeroed memory. Event loop thread only.
+ * With FDE_POOL_DEBUG freed objects are poisoned: writes after free and double frees are reported.
+ */
+
+#ifndef FDE_POOL_DEBUG
+#define FDE_POOL_DEBUG 0
+#endif
+
+#define FDE_POOL_CACHE_LINE 64
+#define FDE_POOL_SLAB_SIZE (16 * 1024)  // At least one object per slab
+#define FDE_POOL_POISON 0x6b
+
+typedef struct fde_pool_slab fde_pool_slab_t;
+
+typedef struct fde_pool {
+    const char *name;
+    size_t object_size;
+    size_t stride;        // object_size rounded up to the cache line
+    size_t per_slab;
+    void *free_list;
+    fde_pool_slab_t *slabs;
+    size_t num_slabs;
+
+    size_t live;
+    size_t peak;
+    uint64_t allocs;
+    uint64_t frees;
+
+    bool registered;
+    struct fde_pool *next;
+} fde_pool_t;
+
+#define FDE_POOL_INIT(type_name, size) { .name = type_name, .object_size = size }
+
+// File-local pool with typed helpers: FDE_POOL(ws_pool, workspace_t) gives ws_pool_alloc() / ws_pool_free()
+#define FDE_POOL(pool, type) \
+    static fde_pool_t pool = FDE_POOL_INIT(#type, sizeof(type)); \
+    static inline type *pool##_alloc(void) { return fde_pool_alloc(&pool); } \
+    static inline void pool##_free(type *object) { fde_pool_free(&pool, object); }
+
+void *fde_pool_alloc(fde_pool_t *pool);
+// NULL is ignored
+void fde_pool_free(fde_pool_t *pool, void *object);
+
+typedef void (*fde_pool_iter_t)(const fde_pool_t *pool, void *data);
+// Pools that have allocated at least once
+void fde_pool_for_each(fde_pool_iter_t iter, void *data);
+size_t fde_pool_reserved_bytes(const fde_pool_t *pool);
+// Shutdown: releases the slabs of empty pools, logs the ones that still have live objects
+void fde_pool_finish_all(void);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Startup phases in the order they normally finish; time to first frame is the end of the last one
+typedef enum {
+    FDE_STARTUP_CONFIG = 0,
+    FDE_STARTUP_DISPLAY,        // Workspaces and wl_display
+    FDE_STARTUP_BACKEND,
+    FDE_STARTUP_RENDERER,
+    FDE_STARTUP_ALLOCATOR,
+    FDE_STARTUP_GLOBALS,        // wlr_compositor and the other protocol globals, output layout, scene
+    FDE_STARTUP_SEAT,           // Seat and cursor
+    FDE_STARTUP_BACKEND_START,
+    FDE_STARTUP_SOCKET,
+    FDE_STARTUP_DBUS,
+    FDE_STARTUP_PLUGINS,
+    FDE_STARTUP_FIRST_FRAME,    // First output commit
+    FDE_STARTUP_PHASE_LAST,
+} fde_startup_phase_t;
+
+// Starts the clock; with `report` the breakdown is printed to stderr after the first frame
+void fde_startup_init(bool report);
+// The phase has just finished: its duration is the time since the previous mark. Only the first mark counts
+void fde_startup_mark(fde_startup_phase_t phase);
+bool fde_startup_reached(fde_startup_phase_t phase);
+
+typedef void (*fde_startup_iter_t)(const char *phase, uint64_t duration_usec, uint64_t end_usec, void *data);
+// Reached phases, in the order they were marked
+void fde_startup_for_each_phase(fde_startup_iter_t iter, void *data);
+void fde_startup_report(FILE *out);
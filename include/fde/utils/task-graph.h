@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <wayland-server-core.h>
+
+/*
+ * Dependency graph of one-shot tasks. Main tasks run on the event loop thread, worker tasks on an
+ * fde_workqueue; a finished worker task wakes the event loop through an eventfd, which then starts
+ * whatever became ready. Milestones have no work and are completed from outside (e.g. first frame).
+ * A failed task fails everything that depends on it.
+ */
+
+#define FDE_TASK_GRAPH_MAX_TASKS 64
+#define FDE_TASK_GRAPH_JOIN_TIMEOUT_MS 2000
+
+typedef enum {
+    FDE_TASK_MAIN,
+    FDE_TASK_WORKER,
+    FDE_TASK_MILESTONE,
+} fde_task_kind_t;
+
+typedef bool (*fde_task_fn_t)(void *data);
+
+typedef struct fde_task_graph fde_task_graph_t;
+// ok is false if a required task failed or was skipped
+typedef void (*fde_task_graph_done_fn_t)(bool ok, void *data);
+
+fde_task_graph_t *fde_task_graph_create(struct wl_event_loop *loop, int threads,
+    fde_task_graph_done_fn_t done, void *data);
+// Returns the task id, or -1 when the graph is full. deps: FDE_TASK_DEP(id) | ...
+int fde_task_graph_add(fde_task_graph_t *graph, const char *name, fde_task_kind_t kind,
+    fde_task_fn_t fn, void *data, uint64_t deps, bool required);
+// Runs every ready main task right away and queues the worker tasks; false if a required task failed.
+// The graph destroys itself after calling `done` (possibly from inside this call)
+bool fde_task_graph_start(fde_task_graph_t *graph);
+void fde_task_graph_complete(fde_task_graph_t *graph, int milestone);
+// Waits up to FDE_TASK_GRAPH_JOIN_TIMEOUT_MS for running worker tasks; `done` is not called.
+// Returns false if a worker task is still running: it is left behind (with the graph memory it
+// references), so whatever it writes must stay valid or be leaked by the caller
+bool fde_task_graph_destroy(fde_task_graph_t *graph);
+
+#define FDE_TASK_DEP(id) (1ULL << (id))
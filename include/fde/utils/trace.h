@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary trace recording. Every thread writes fixed-size records into its own ring, which is an
+ * mmapped file in the session directory ($XDG_RUNTIME_DIR/fde-trace-<pid>-<n>-XXXXXX/thread-<tid>.trace),
+ * so a recording survives a crash. Call site names go to the "names" file of the same directory.
+ * When the ring is full the oldest records are overwritten (flight recorder).
+ * `fde-trace <dir>` converts a session to Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ */
+
+#define FDE_TRACE_MAGIC "FDETRACE"
+#define FDE_TRACE_VERSION 1
+#define FDE_TRACE_RING_RECORDS (64 * 1024)  // Per thread, 1.5 MiB
+
+typedef enum {
+    FDE_TRACE_BEGIN = 'B',
+    FDE_TRACE_END = 'E',
+    FDE_TRACE_COUNTER = 'C',
+} fde_trace_type_t;
+
+// On-disk layout, shared with fde-trace
+typedef struct fde_trace_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int32_t pid;
+    int32_t tid;
+    uint64_t capacity;          // Records in the ring
+    _Atomic uint64_t written;   // Records ever written; the ring holds the last min(written, capacity)
+    char thread_name[16];
+} fde_trace_file_header_t;
+
+typedef struct fde_trace_record {
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC
+    uint32_t site;          // Id from the names file
+    uint32_t type;          // fde_trace_type_t
+    int64_t value;          // Counter value
+} fde_trace_record_t;
+
+typedef struct fde_trace_site {
+    const char *name;
+    _Atomic uint32_t id;  // 0 until the site is first recorded
+} fde_trace_site_t;
+
+extern _Atomic bool fde_trace_enabled;
+
+static inline bool fde_trace_active(void) {
+    return atomic_load_explicit(&fde_trace_enabled, memory_order_relaxed);
+}
+
+void fde_trace_record(fde_trace_site_t *site, fde_trace_type_t type, int64_t value);
+// Site for a name built at runtime (the name is copied)
+fde_trace_site_t *fde_trace_site(const char *name);
+
+// Starts a new session; returns its directory or NULL
+const char *fde_trace_start(void);
+void fde_trace_stop(void);
+// Directory of the running session, NULL when stopped
+const char *fde_trace_dir(void);
+void fde_trace_finish(void);
+
+static inline fde_trace_site_t *fde_trace_scope_begin(fde_trace_site_t *site) {
+    if (!site) {
+        return NULL;
+    }
+    fde_trace_record(site, FDE_TRACE_BEGIN, 0);
+    return site;
+}
+
+static inline void fde_trace_scope_end(fde_trace_site_t **site) {
+    if (*site) {
+        fde_trace_record(*site, FDE_TRACE_END, 0);
+        *site = NULL;
+    }
+}
+
+#define _FDE_TRACE_CAT2(a, b) a##b
+#define _FDE_TRACE_CAT(a, b) _FDE_TRACE_CAT2(a, b)
+
+#define FDE_TRACE_BEGIN(label) do { \
+    static fde_trace_site_t _fde_trace_site = { .name = label }; \
+    if (fde_trace_active()) fde_trace_record(&_fde_trace_site, FDE_TRACE_BEGIN, 0); \
+} while (0)
+
+#define FDE_TRACE_END(label) do { \
+    static fde_trace_site_t _fde_trace_site = { .name = label }; \
+    if (fde_trace_active()) fde_trace_record(&_fde_trace_site, FDE_TRACE_END, 0); \
+} while (0)
+
+#define FDE_TRACE_COUNTER(label, val) do { \
+    static fde_trace_site_t _fde_trace_site = { .name = label }; \
+    if (fde_trace_active()) fde_trace_record(&_fde_trace_site, FDE_TRACE_COUNTER, (int64_t)(val)); \
+} while (0)
+
+// Begin now, end when the enclosing block is left
+#define FDE_TRACE_SCOPE(label) \
+    static fde_trace_site_t _FDE_TRACE_CAT(_fde_trace_site_, __LINE__) = { .name = label }; \
+    fde_trace_site_t *_FDE_TRACE_CAT(_fde_trace_scope_, __LINE__) __attribute__((cleanup(fde_trace_scope_end))) = \
+        fde_trace_active() ? fde_trace_scope_begin(&_FDE_TRACE_CAT(_fde_trace_site_, __LINE__)) : NULL
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*fde_work_fn_t)(void *data);
+
+// Fixed pool of worker threads with a FIFO of jobs
+typedef struct fde_workqueue fde_workqueue_t;
+
+// threads <= 0: one per online CPU
+fde_workqueue_t *fde_workqueue_create(int threads);
+// Waits for the queued jobs, then joins the workers
+void fde_workqueue_destroy(fde_workqueue_t *wq);
+
+bool fde_workqueue_push(fde_workqueue_t *wq, fde_work_fn_t fn, void *data);
+// Blocks until every pushed job has finished
+void fde_workqueue_wait(fde_workqueue_t *wq);
+// Same with a deadline; false if jobs are still queued or running after timeout_ms
+bool fde_workqueue_wait_timeout(fde_workqueue_t *wq, int timeout_ms);
+// Drops queued jobs and detaches the workers instead of joining them: a stuck job keeps running,
+// the queue frees itself when its last worker exits
+void fde_workqueue_abandon(fde_workqueue_t *wq);
+int fde_workqueue_threads(const fde_workqueue_t *wq);
@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# bench_capture.sh: Measures bytes copied per captured frame on a static headless screen.
+# Starts fde on the headless backend, runs an ext-image-copy-capture-v1 client for a few seconds,
+# then reads the per-client totals fde logs when the capture ends and appends
+# "<commit> <frames> <bytes per frame> <full-frame bytes per frame>" to a results file.
+# Usage: ./scripts/bench_capture.sh [-t seconds] [-f max_fps] [-w workers] [-c capture command] [-b build dir] [-o results file]
+# The capture command runs inside the compositor session, e.g. -c "wf-recorder -f /tmp/out.mkv"
+
+set -euo pipefail
+
+SECONDS_TO_RUN=5
+MAX_FPS=0  # No cap: every output frame the client asks for is copied
+WORKERS=2  # Copy threads, 0 = copy on the event loop
+BUILD_DIR="$(pwd)/build"
+RESULTS="$(pwd)/capture-bench.txt"
+CAPTURE_CMD=""
+TIMEOUT=10  # Seconds to wait for the compositor socket
+
+while getopts "t:f:w:c:b:o:h" opt; do
+    case "$opt" in
+        t) SECONDS_TO_RUN="$OPTARG" ;;
+        f) MAX_FPS="$OPTARG" ;;
+        w) WORKERS="$OPTARG" ;;
+        c) CAPTURE_CMD="$OPTARG" ;;
+        b) BUILD_DIR="$OPTARG" ;;
+        o) RESULTS="$OPTARG" ;;
+        *) echo "Usage: $0 [-t seconds] [-f max_fps] [-w workers] [-c capture command] [-b build dir] [-o results file]" >&2; exit 1 ;;
+    esac
+done
+
+FDE="$BUILD_DIR/src/fde"
+if [[ ! -x "$FDE" ]]; then
+    echo "No fde binary at $FDE (build first: meson compile -C $BUILD_DIR)" >&2
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [[ -z "$CAPTURE_CMD" ]]; then
+    if ! command -v wf-recorder > /dev/null; then
+        echo "No capture client: pass one with -c" >&2
+        exit 1
+    fi
+    CAPTURE_CMD="wf-recorder -f $WORK_DIR/capture.mkv"
+fi
+
+# Пустой экран: без клиентов повреждений нет, после первого кадра копировать нечего
+mkdir -p "$WORK_DIR/plugins" "$WORK_DIR/runtime" "$WORK_DIR/cache"
+chmod 700 "$WORK_DIR/runtime"
+cat > "$WORK_DIR/config.ini" <<EOF
+[plugins]
+dir = $WORK_DIR/plugins
+
+[workspaces]
+list = 1
+
+[capture]
+max_fps = $MAX_FPS
+screencopy = false
+workers = $WORKERS
+EOF
+
+export XDG_RUNTIME_DIR="$WORK_DIR/runtime"
+export XDG_CACHE_HOME="$WORK_DIR/cache"
+export WLR_BACKENDS=headless
+export WLR_HEADLESS_OUTPUTS=1
+export WLR_RENDERER="${WLR_RENDERER:-pixman}"
+export WLR_LIBINPUT_NO_DEVICES=1
+
+log="$WORK_DIR/fde.log"
+"$FDE" -c "$WORK_DIR/config.ini" 2> "$log" &
+fde_pid=$!
+
+socket=""
+for ((t = 0; t < TIMEOUT * 20; t++)); do
+    socket="$(cd "$XDG_RUNTIME_DIR" && ls wayland-* 2> /dev/null | grep -v '\.lock$' | head -n 1 || true)"
+    [[ -n "$socket" ]] && break
+    kill -0 "$fde_pid" 2> /dev/null || break
+    sleep 0.05
+done
+if [[ -z "$socket" ]]; then
+    kill "$fde_pid" 2> /dev/null || true
+    echo "fde did not create a Wayland socket within ${TIMEOUT}s, log:" >&2
+    cat "$log" >&2
+    exit 1
+fi
+
+WAYLAND_DISPLAY="$socket" $CAPTURE_CMD > "$WORK_DIR/client.log" 2>&1 &
+client_pid=$!
+sleep "$SECONDS_TO_RUN"
+kill -INT "$client_pid" 2> /dev/null || true
+wait "$client_pid" 2> /dev/null || true
+
+# Итоги клиента пишутся в лог, когда он отключается
+sleep 0.5
+kill "$fde_pid" 2> /dev/null || true
+wait "$fde_pid" 2> /dev/null || true
+
+read -r frames bytes full_bytes < <(sed -n \
+    's/.*Capture by pid [0-9-]* on [^ ]* finished: \([0-9]*\) frames, \([0-9]*\) bytes copied, \([0-9]*\) for full frames.*/\1 \2 \3/p' \
+    "$log" | awk '{ f += $1; b += $2; fb += $3 } END { printf "%d %d %d\n", f, b, fb }')
+
+if [[ "$frames" -eq 0 ]]; then
+    echo "The client captured no frames, client log:" >&2
+    cat "$WORK_DIR/client.log" >&2
+    exit 1
+fi
+
+per_frame=$((bytes / frames))
+full_per_frame=$((full_bytes / frames))
+echo "Captured $frames frames in ${SECONDS_TO_RUN}s: $per_frame bytes copied per frame (full frames: $full_per_frame)"
+
+commit="$(git rev-parse --short HEAD 2> /dev/null || echo unknown)"
+echo "$commit $frames $per_frame $full_per_frame" >> "$RESULTS"
@@ -0,0 +1,107 @@
+#!/bin/bash
+
+# bench_commit.sh: Measures the compositor CPU time one client commit costs, shm versus single-pixel buffers.
+# Builds scripts/commit_client.c, starts fde on the headless backend and runs the client once per buffer type.
+# fde's CPU time (from /proc/<pid>/schedstat, minus its idle rate) is divided by the number of commits.
+# Appends "<commit> <shm us per commit> <single-pixel us per commit>" to a results file.
+# Usage: ./scripts/bench_commit.sh [-n commits] [-s WxH] [-b build dir] [-o results file]
+
+set -euo pipefail
+
+COMMITS=1000
+SIZE="1920x1080"
+BUILD_DIR="$(pwd)/build"
+RESULTS="$(pwd)/commit-bench.txt"
+TIMEOUT=10  # Seconds to wait for the compositor socket
+IDLE_SECONDS=1
+
+while getopts "n:s:b:o:h" opt; do
+    case "$opt" in
+        n) COMMITS="$OPTARG" ;;
+        s) SIZE="$OPTARG" ;;
+        b) BUILD_DIR="$OPTARG" ;;
+        o) RESULTS="$OPTARG" ;;
+        *) echo "Usage: $0 [-n commits] [-s WxH] [-b build dir] [-o results file]" >&2; exit 1 ;;
+    esac
+done
+
+FDE="$BUILD_DIR/src/fde"
+if [[ ! -x "$FDE" ]]; then
+    echo "No fde binary at $FDE (build first: meson compile -C $BUILD_DIR)" >&2
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# Клиент собирается здесь же: протокол берётся из установленных wayland-protocols
+protocols_dir="$(pkg-config --variable=pkgdatadir wayland-protocols)"
+xml="$protocols_dir/staging/single-pixel-buffer/single-pixel-buffer-v1.xml"
+wayland-scanner client-header "$xml" "$WORK_DIR/single-pixel-buffer-v1-client-protocol.h"
+wayland-scanner private-code "$xml" "$WORK_DIR/single-pixel-buffer-v1-protocol.c"
+client="$WORK_DIR/commit_client"
+cc -O2 -I"$WORK_DIR" "$(dirname "$0")/commit_client.c" "$WORK_DIR/single-pixel-buffer-v1-protocol.c" \
+    $(pkg-config --cflags --libs wayland-client) -o "$client"
+
+mkdir -p "$WORK_DIR/plugins" "$WORK_DIR/runtime" "$WORK_DIR/cache"
+chmod 700 "$WORK_DIR/runtime"
+cat > "$WORK_DIR/config.ini" <<CONF
+[plugins]
+dir = $WORK_DIR/plugins
+
+[workspaces]
+list = 1
+CONF
+
+export XDG_RUNTIME_DIR="$WORK_DIR/runtime"
+export XDG_CACHE_HOME="$WORK_DIR/cache"
+export WLR_BACKENDS=headless
+export WLR_HEADLESS_OUTPUTS=1
+export WLR_RENDERER="${WLR_RENDERER:-pixman}"
+export WLR_LIBINPUT_NO_DEVICES=1
+
+log="$WORK_DIR/fde.log"
+"$FDE" -c "$WORK_DIR/config.ini" 2> "$log" &
+fde_pid=$!
+
+socket=""
+for ((t = 0; t < TIMEOUT * 20; t++)); do
+    socket="$(cd "$XDG_RUNTIME_DIR" && ls wayland-* 2> /dev/null | grep -v '\.lock$' | head -n 1 || true)"
+    [[ -n "$socket" ]] && break
+    kill -0 "$fde_pid" 2> /dev/null || break
+    sleep 0.05
+done
+if [[ -z "$socket" ]]; then
+    kill "$fde_pid" 2> /dev/null || true
+    echo "fde did not create a Wayland socket within ${TIMEOUT}s, log:" >&2
+    cat "$log" >&2
+    exit 1
+fi
+
+cpu_ns() {
+    cut -d ' ' -f 1 "/proc/$fde_pid/schedstat"
+}
+
+# Простой без клиентов: кадры headless output
+sleep 0.5
+idle_start="$(cpu_ns)"
+sleep "$IDLE_SECONDS"
+idle_ns_per_s=$(( ($(cpu_ns) - idle_start) / IDLE_SECONDS ))
+
+width="${SIZE%x*}"
+height="${SIZE#*x}"
+declare -A per_commit
+for mode in shm single-pixel; do
+    start="$(cpu_ns)"
+    read -r commits seconds < <(WAYLAND_DISPLAY="$socket" "$client" "$mode" "$COMMITS" "$width" "$height")
+    spent=$(( $(cpu_ns) - start ))
+    idle="$(awk -v r="$idle_ns_per_s" -v s="$seconds" 'BEGIN { printf "%d", r * s }')"
+    per_commit[$mode]="$(awk -v n="$spent" -v i="$idle" -v c="$commits" 'BEGIN { v = (n - i) / c / 1000; printf "%.1f", v < 0 ? 0 : v }')"
+    echo "$mode: $commits commits of ${SIZE} in ${seconds}s, ${per_commit[$mode]} us of compositor CPU per commit"
+done
+
+kill "$fde_pid" 2> /dev/null || true
+wait "$fde_pid" 2> /dev/null || true
+
+commit="$(git rev-parse --short HEAD 2> /dev/null || echo unknown)"
+echo "$commit ${per_commit[shm]} ${per_commit[single-pixel]}" >> "$RESULTS"
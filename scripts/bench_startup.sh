@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# bench_startup.sh: Measures fde time-to-first-frame on the headless backend.
+# Runs the compositor N times with --startup-report, takes the median and appends
+# "<commit> <median ms> <min ms> <max ms>" to a results file, so the number can be tracked across commits.
+# Usage: ./scripts/bench_startup.sh [-n runs] [-b build dir] [-o results file]
+
+set -euo pipefail
+
+RUNS=10
+BUILD_DIR="$(pwd)/build"
+RESULTS="$(pwd)/startup-bench.txt"
+TIMEOUT=10  # Seconds to wait for the first frame
+
+while getopts "n:b:o:h" opt; do
+    case "$opt" in
+        n) RUNS="$OPTARG" ;;
+        b) BUILD_DIR="$OPTARG" ;;
+        o) RESULTS="$OPTARG" ;;
+        *) echo "Usage: $0 [-n runs] [-b build dir] [-o results file]" >&2; exit 1 ;;
+    esac
+done
+
+FDE="$BUILD_DIR/src/fde"
+if [[ ! -x "$FDE" ]]; then
+    echo "No fde binary at $FDE (build first: meson compile -C $BUILD_DIR)" >&2
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# Минимальный конфиг: пустой каталог плагинов, один workspace
+mkdir -p "$WORK_DIR/plugins" "$WORK_DIR/runtime" "$WORK_DIR/cache"
+chmod 700 "$WORK_DIR/runtime"
+cat > "$WORK_DIR/config.ini" <<EOF
+[plugins]
+dir = $WORK_DIR/plugins
+
+[workspaces]
+list = 1
+EOF
+
+export XDG_RUNTIME_DIR="$WORK_DIR/runtime"
+export XDG_CACHE_HOME="$WORK_DIR/cache"
+export WLR_BACKENDS=headless
+export WLR_HEADLESS_OUTPUTS=1
+export WLR_RENDERER="${WLR_RENDERER:-pixman}"
+export WLR_LIBINPUT_NO_DEVICES=1
+
+samples=()
+for ((i = 1; i <= RUNS; i++)); do
+    log="$WORK_DIR/run-$i.log"
+    "$FDE" -c "$WORK_DIR/config.ini" --startup-report 2> "$log" &
+    pid=$!
+
+    ms=""
+    for ((t = 0; t < TIMEOUT * 20; t++)); do
+        ms="$(sed -n 's/^Time to first frame: \([0-9.]*\) ms$/\1/p' "$log")"
+        [[ -n "$ms" ]] && break
+        kill -0 "$pid" 2> /dev/null || break
+        sleep 0.05
+    done
+    kill "$pid" 2> /dev/null || true
+    wait "$pid" 2> /dev/null || true
+
+    if [[ -z "$ms" ]]; then
+        echo "Run $i: no first frame within ${TIMEOUT}s, log:" >&2
+        cat "$log" >&2
+        exit 1
+    fi
+    echo "Run $i: $ms ms"
+    samples+=("$ms")
+done
+
+# Breakdown of the last run
+sed -n '/^Startup report:/,/^Time to first frame/p' "$log"
+
+read -r median min max < <(printf '%s\n' "${samples[@]}" | sort -g | awk '
+    { v[NR] = $1 }
+    END {
+        m = (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2
+        printf "%.3f %.3f %.3f\n", m, v[1], v[NR]
+    }')
+
+commit="$(git rev-parse --short HEAD 2> /dev/null || echo unknown)"
+echo "Time to first frame: median $median ms (min $min, max $max) over $RUNS runs"
+echo "$commit $median $min $max" >> "$RESULTS"
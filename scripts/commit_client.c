@@ -0,0 +1,163 @@
+// commit_client: commits buffers to a wl_surface without a role, one round trip per commit, so every
+// commit is fully processed by the compositor before the next one. Used by bench_commit.sh.
+// shm: a full-size buffer repainted every commit, as a client drawing a solid background on the CPU
+// single-pixel: a wp_single_pixel_buffer_v1 of a new colour every commit
+// Usage: commit_client shm|single-pixel [commits] [width] [height]
+// Prints "<commits> <seconds>"
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "single-pixel-buffer-v1-client-protocol.h"
+
+#define NUM_SHM_BUFFERS 3
+
+typedef struct shm_buffer {
+    struct wl_buffer *buffer;
+    uint32_t *data;
+    bool busy;  // Until the compositor releases it
+} shm_buffer_t;
+
+static struct wl_compositor *compositor;
+static struct wl_shm *shm;
+static struct wp_single_pixel_buffer_manager_v1 *single_pixel;
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name, const char *interface,
+        uint32_t version) {
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if (strcmp(interface, wp_single_pixel_buffer_manager_v1_interface.name) == 0) {
+        single_pixel = wl_registry_bind(registry, name, &wp_single_pixel_buffer_manager_v1_interface, 1);
+    }
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+}
+
+static const struct wl_registry_listener registry_listener = {
+    .global = registry_global,
+    .global_remove = registry_global_remove,
+};
+
+static void buffer_release(void *data, struct wl_buffer *buffer) {
+    shm_buffer_t *shm_buffer = data;
+    shm_buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = buffer_release,
+};
+
+static bool create_shm_buffers(shm_buffer_t *buffers, int width, int height) {
+    size_t stride = (size_t)width * 4, size = stride * (size_t)height;
+    int fd = memfd_create("commit-client", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, (off_t)(size * NUM_SHM_BUFFERS)) < 0) {
+        perror("memfd");
+        return false;
+    }
+    char *data = mmap(NULL, size * NUM_SHM_BUFFERS, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return false;
+    }
+    struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, (int32_t)(size * NUM_SHM_BUFFERS));
+    for (int i = 0; i < NUM_SHM_BUFFERS; i++) {
+        buffers[i].data = (uint32_t *)(data + size * i);
+        buffers[i].buffer = wl_shm_pool_create_buffer(pool, (int32_t)(size * i), width, height, (int32_t)stride,
+            WL_SHM_FORMAT_XRGB8888);
+        wl_buffer_add_listener(buffers[i].buffer, &buffer_listener, &buffers[i]);
+    }
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return true;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || (strcmp(argv[1], "shm") != 0 && strcmp(argv[1], "single-pixel") != 0)) {
+        fprintf(stderr, "Usage: %s shm|single-pixel [commits] [width] [height]\n", argv[0]);
+        return 1;
+    }
+    bool use_shm = strcmp(argv[1], "shm") == 0;
+    int commits = argc > 2 ? atoi(argv[2]) : 1000;
+    int width = argc > 3 ? atoi(argv[3]) : 1920;
+    int height = argc > 4 ? atoi(argv[4]) : 1080;
+
+    struct wl_display *display = wl_display_connect(NULL);
+    if (!display) {
+        fprintf(stderr, "Cannot connect to the Wayland display\n");
+        return 1;
+    }
+    struct wl_registry *registry = wl_display_get_registry(display);
+    wl_registry_add_listener(registry, &registry_listener, NULL);
+    wl_display_roundtrip(display);
+    if (!compositor || (use_shm && !shm) || (!use_shm && !single_pixel)) {
+        fprintf(stderr, "The compositor lacks wl_compositor, wl_shm or wp_single_pixel_buffer_manager_v1\n");
+        return 1;
+    }
+
+    shm_buffer_t buffers[NUM_SHM_BUFFERS] = {0};
+    if (use_shm && !create_shm_buffers(buffers, width, height)) {
+        return 1;
+    }
+    struct wl_surface *surface = wl_compositor_create_surface(compositor);
+
+    double start = now_s();
+    for (int i = 0; i < commits; i++) {
+        uint32_t shade = (uint32_t)i & 0xff;
+        struct wl_buffer *single_pixel_buffer = NULL;
+        if (use_shm) {
+            shm_buffer_t *buffer = NULL;
+            while (!buffer) {
+                for (int b = 0; b < NUM_SHM_BUFFERS && !buffer; b++) {
+                    buffer = buffers[b].busy ? NULL : &buffers[b];
+                }
+                if (!buffer && wl_display_dispatch(display) < 0) {
+                    return 1;
+                }
+            }
+            uint32_t pixel = 0xff000000u | shade << 16 | shade << 8 | shade;
+            for (size_t p = 0; p < (size_t)width * (size_t)height; p++) {
+                buffer->data[p] = pixel;
+            }
+            buffer->busy = true;
+            wl_surface_attach(surface, buffer->buffer, 0, 0);
+            wl_surface_damage_buffer(surface, 0, 0, width, height);
+        } else {
+            uint32_t value = shade * 0x01010101u;
+            single_pixel_buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(single_pixel,
+                value, value, value, UINT32_MAX);
+            wl_surface_attach(surface, single_pixel_buffer, 0, 0);
+            wl_surface_damage_buffer(surface, 0, 0, 1, 1);
+        }
+        wl_surface_commit(surface);
+        if (wl_display_roundtrip(display) < 0) {
+            return 1;
+        }
+        if (single_pixel_buffer) {
+            wl_buffer_destroy(single_pixel_buffer);
+        }
+    }
+    printf("%d %.6f\n", commits, now_s() - start);
+
+    wl_surface_destroy(surface);
+    wl_display_disconnect(display);
+    return 0;
+}
@@ -0,0 +1,427 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fde/comp/autostart.h>
+#include <fde/utils/log.h>
+#include <fde/utils/pool.h>
+#include <fde/utils/trace.h>
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+
+extern char **environ;
+
+#define MAX_ANCESTRY_DEPTH 16
+
+typedef struct autostart_entry {
+    char **argv;
+    char *command;  // argv joined, for logs and reports
+    int group;
+    bool wait;
+    bool exited;    // Exited with status 0 before its first frame: a wrapper, its children may still show up
+    pid_t pid;
+    autostart_state_t state;
+    uint64_t spawn_ns;
+    uint64_t ready_ns;
+    uint64_t deadline_ns;  // Tracked until then, 0 = until the first frame
+} autostart_entry_t;
+
+// Commit listener on a surface of a client that may belong to an autostart command
+typedef struct surface_watch {
+    struct wl_list link;
+    struct wlr_surface *surface;
+    struct wl_listener commit;
+    struct wl_listener destroy;
+} surface_watch_t;
+
+FDE_POOL(watch_pool, surface_watch_t)
+
+static struct {
+    compositor_t *server;
+    autostart_entry_t *entries;
+    size_t count;
+    char **group_names;
+    int groups;
+    int ready_timeout_ms;
+
+    int current_group;  // -1 before the first one
+    int waiting;        // exec_wait commands of the current group without a frame
+    int tracked;        // Started commands without a frame and before their deadline, any group
+    struct wl_event_source *timer;
+
+    struct wl_listener new_surface;
+    struct wl_list watches;  // surface_watch_t
+    bool listening;
+} autostart = { .current_group = -1 };
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+const char *autostart_state_name(autostart_state_t state) {
+    switch (state) {
+        case AUTOSTART_PENDING: return "pending";
+        case AUTOSTART_STARTED: return "started";
+        case AUTOSTART_READY: return "ready";
+        case AUTOSTART_TIMED_OUT: return "timed-out";
+        case AUTOSTART_EXITED: return "exited";
+        case AUTOSTART_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+static const char *group_name(int group) {
+    return autostart.group_names[group] ?: "";
+}
+
+static char *join_argv(char **argv) {
+    size_t len = 1;
+    for (size_t i = 0; argv[i]; i++) len += strlen(argv[i]) + 1;
+    char *command = malloc(len);
+    if (!command) return NULL;
+    char *p = command;
+    for (size_t i = 0; argv[i]; i++) {
+        p += sprintf(p, i ? " %s" : "%s", argv[i]);
+    }
+    *p = '\0';
+    return command;
+}
+
+static void stop_watching(void);
+static void start_next_group(void);
+
+static void watch_destroy(surface_watch_t *watch) {
+    wl_list_remove(&watch->link);
+    wl_list_remove(&watch->commit.link);
+    wl_list_remove(&watch->destroy.link);
+    watch_pool_free(watch);
+}
+
+// Выполненная команда больше не ждёт кадра
+static void entry_settle(autostart_entry_t *entry, autostart_state_t state) {
+    bool was_tracked = entry->state == AUTOSTART_STARTED;
+    bool was_waited = entry->state == AUTOSTART_STARTED && entry->wait && entry->group == autostart.current_group;
+    entry->state = state;
+    if (was_tracked) {
+        autostart.tracked--;
+    }
+    if (was_waited && --autostart.waiting == 0) {
+        start_next_group();
+    }
+    if (autostart.tracked == 0 && autostart.current_group >= autostart.groups - 1) {
+        stop_watching();
+    }
+}
+
+static bool read_stat(pid_t pid, pid_t *ppid, pid_t *pgrp) {
+    char path[64], buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *file = fopen(path, "re");
+    if (!file) return false;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    buf[len] = '\0';
+
+    // comm may contain spaces and parentheses: fields continue after the last ')'
+    char *p = strrchr(buf, ')');
+    int parent, group;
+    if (!p || sscanf(p + 1, " %*c %d %d", &parent, &group) != 2) return false;
+    *ppid = parent;
+    *pgrp = group;
+    return true;
+}
+
+static autostart_entry_t *find_running(pid_t pid) {
+    for (size_t i = 0; i < autostart.count; i++) {
+        autostart_entry_t *entry = &autostart.entries[i];
+        if (entry->pid == pid && entry->state == AUTOSTART_STARTED) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Each command leads its own process group, which survives a wrapper that exits after forking
+static autostart_entry_t *find_entry_for_client(pid_t pid) {
+    pid_t self = getpid();
+    for (int depth = 0; depth < MAX_ANCESTRY_DEPTH && pid > 1 && pid != self; depth++) {
+        autostart_entry_t *entry = find_running(pid);
+        if (entry) return entry;
+
+        pid_t ppid, pgrp;
+        if (!read_stat(pid, &ppid, &pgrp)) return NULL;
+        if ((entry = find_running(pgrp))) return entry;
+        pid = ppid;
+    }
+    return NULL;
+}
+
+static void handle_watch_commit(struct wl_listener *listener, void *data) {
+    surface_watch_t *watch = wl_container_of(listener, watch, commit);
+    if (!wlr_surface_has_buffer(watch->surface)) {
+        return;
+    }
+
+    pid_t pid;
+    wl_client_get_credentials(wl_resource_get_client(watch->surface->resource), &pid, NULL, NULL);
+    autostart_entry_t *entry = find_entry_for_client(pid);
+    watch_destroy(watch);
+    if (!entry) {
+        return;
+    }
+
+    entry->ready_ns = monotonic_ns();
+    fde_log(FDE_INFO, "Autostart: '%s' (PID %d) showed its first frame after %.1f ms",
+        entry->command, entry->pid, (entry->ready_ns - entry->spawn_ns) / 1e6);
+    FDE_TRACE_COUNTER("autostart.ready_ms", (entry->ready_ns - entry->spawn_ns) / 1000000);
+    entry_settle(entry, AUTOSTART_READY);
+}
+
+static void handle_watch_destroy(struct wl_listener *listener, void *data) {
+    surface_watch_t *watch = wl_container_of(listener, watch, destroy);
+    watch_destroy(watch);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+    struct wlr_surface *surface = data;
+    pid_t pid;
+    wl_client_get_credentials(wl_resource_get_client(surface->resource), &pid, NULL, NULL);
+    if (!find_entry_for_client(pid)) {
+        return;
+    }
+
+    surface_watch_t *watch = watch_pool_alloc();
+    if (!watch) {
+        return;
+    }
+    watch->surface = surface;
+    watch->commit.notify = handle_watch_commit;
+    wl_signal_add(&surface->events.commit, &watch->commit);
+    watch->destroy.notify = handle_watch_destroy;
+    wl_signal_add(&surface->events.destroy, &watch->destroy);
+    wl_list_insert(&autostart.watches, &watch->link);
+}
+
+static void stop_watching(void) {
+    if (!autostart.listening) {
+        return;
+    }
+    autostart.listening = false;
+    wl_list_remove(&autostart.new_surface.link);
+    surface_watch_t *watch, *tmp;
+    wl_list_for_each_safe(watch, tmp, &autostart.watches, link) {
+        watch_destroy(watch);
+    }
+}
+
+static bool spawn_entry(autostart_entry_t *entry) {
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr) != 0) {
+        return false;
+    }
+    // SIGCHLD and friends are blocked for signalfd in the compositor: the child starts clean
+    sigset_t empty, all;
+    sigemptyset(&empty);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    entry->spawn_ns = monotonic_ns();
+    int err = posix_spawnp(&entry->pid, entry->argv[0], NULL, &attr, entry->argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        fde_log(FDE_ERROR, "Autostart: cannot start '%s': %s", entry->command, strerror(err));
+        entry->pid = 0;
+        return false;
+    }
+    fde_log(FDE_DEBUG, "Autostart: started '%s' (PID %d)", entry->command, entry->pid);
+    return true;
+}
+
+// Earliest deadline of the tracked commands, 0 if none
+static uint64_t next_deadline(void) {
+    uint64_t next = 0;
+    for (size_t i = 0; i < autostart.count; i++) {
+        const autostart_entry_t *entry = &autostart.entries[i];
+        if (entry->state == AUTOSTART_STARTED && entry->deadline_ns && (!next || entry->deadline_ns < next)) {
+            next = entry->deadline_ns;
+        }
+    }
+    return next;
+}
+
+static void arm_timer(void) {
+    uint64_t next = next_deadline();
+    if (!autostart.timer) {
+        return;
+    }
+    if (!next) {
+        wl_event_source_timer_update(autostart.timer, 0);
+        return;
+    }
+    uint64_t now = monotonic_ns();
+    int delay_ms = next > now ? (int)((next - now + 999999) / 1000000) : 1;
+    wl_event_source_timer_update(autostart.timer, delay_ms);
+}
+
+// Команды без кадра к дедлайну больше не отслеживаются; exec_wait перестают держать группу
+static int handle_ready_timeout(void *data) {
+    uint64_t now = monotonic_ns();
+    for (size_t i = 0; i < autostart.count; i++) {
+        autostart_entry_t *entry = &autostart.entries[i];
+        if (entry->state != AUTOSTART_STARTED || !entry->deadline_ns || entry->deadline_ns > now) {
+            continue;
+        }
+        if (entry->wait) {
+            fde_log(FDE_ERROR, "Autostart: '%s' showed no frame within %d ms, not waiting for it",
+                entry->command, autostart.ready_timeout_ms);
+        } else {
+            fde_log(FDE_DEBUG, "Autostart: '%s' showed no frame in time, no longer tracking it", entry->command);
+        }
+        entry_settle(entry, AUTOSTART_TIMED_OUT);
+    }
+    arm_timer();
+    return 0;
+}
+
+// Groups without exec_wait commands do not hold anything back, so several may start at once
+static void start_next_group(void) {
+    while (autostart.waiting == 0 && autostart.current_group < autostart.groups - 1) {
+        int group = ++autostart.current_group;
+        if (group_name(group)[0]) {
+            fde_log(FDE_DEBUG, "Autostart: starting group %s", group_name(group));
+        }
+        for (size_t i = 0; i < autostart.count; i++) {
+            autostart_entry_t *entry = &autostart.entries[i];
+            if (entry->group != group) continue;
+            if (!spawn_entry(entry)) {
+                entry->state = AUTOSTART_FAILED;
+                continue;
+            }
+            entry->state = AUTOSTART_STARTED;
+            autostart.tracked++;
+            if (entry->wait) autostart.waiting++;
+            // exec_wait с нулевым таймаутом ждет кадра без ограничения
+            int timeout_ms = autostart.ready_timeout_ms > 0 ? autostart.ready_timeout_ms :
+                entry->wait ? 0 : AUTOSTART_DEFAULT_READY_TIMEOUT_MS;
+            entry->deadline_ns = timeout_ms ? entry->spawn_ns + (uint64_t)timeout_ms * 1000000ULL : 0;
+        }
+    }
+    arm_timer();
+    if (autostart.tracked == 0 && autostart.current_group >= autostart.groups - 1) {
+        stop_watching();
+    }
+}
+
+bool autostart_run(compositor_t *server, const struct autostart *config) {
+    if (autostart.entries) {
+        fde_log(FDE_ERROR, "Autostart already ran");
+        return false;
+    }
+    if (config->count == 0) {
+        return true;
+    }
+
+    autostart.server = server;
+    autostart.ready_timeout_ms = config->ready_timeout_ms;
+    autostart.entries = calloc(config->count, sizeof(autostart_entry_t));
+    autostart.group_names = calloc((size_t)config->groups, sizeof(char *));
+    if (!autostart.entries || !autostart.group_names) {
+        autostart_finish();
+        return false;
+    }
+    autostart.groups = config->groups;
+    for (int i = 0; i < config->groups; i++) {
+        if (config->group_names[i]) autostart.group_names[i] = strdup(config->group_names[i]);
+    }
+
+    for (size_t i = 0; i < config->count; i++) {
+        const autostart_command_t *cmd = &config->commands[i];
+        size_t argc = 0;
+        while (cmd->argv[argc]) argc++;
+        char **argv = calloc(argc + 1, sizeof(char *));
+        size_t copied = 0;
+        while (argv && copied < argc && (argv[copied] = strdup(cmd->argv[copied]))) copied++;
+        char *command = copied == argc ? join_argv(argv) : NULL;
+        if (!command) {
+            for (size_t j = 0; j < copied; j++) free(argv[j]);
+            free(argv);
+            autostart_finish();
+            return false;
+        }
+        autostart.entries[autostart.count++] = (autostart_entry_t){
+            .argv = argv,
+            .command = command,
+            .group = cmd->group,
+            .wait = cmd->wait,
+        };
+    }
+
+    wl_list_init(&autostart.watches);
+    autostart.new_surface.notify = handle_new_surface;
+    wl_signal_add(&server->compositor->events.new_surface, &autostart.new_surface);
+    autostart.listening = true;
+    autostart.timer = wl_event_loop_add_timer(server->wl_event_loop, handle_ready_timeout, NULL);
+
+    fde_log(FDE_INFO, "Autostart: %zu command(s) in %d group(s)", autostart.count, autostart.groups);
+    start_next_group();
+    return true;
+}
+
+void autostart_child_exited(pid_t pid, int status) {
+    autostart_entry_t *entry = find_running(pid);
+    if (!entry || entry->exited) {
+        return;
+    }
+    // Нулевой код и живая группа процессов: обёртка, запустившая приложение
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && (kill(-pid, 0) == 0 || errno != ESRCH)) {
+        fde_log(FDE_DEBUG, "Autostart: '%s' exited before its first frame, watching its process group", entry->command);
+        entry->exited = true;
+        return;
+    }
+    if (WIFSIGNALED(status)) {
+        fde_log(FDE_ERROR, "Autostart: '%s' (PID %d) killed by signal %d", entry->command, pid, WTERMSIG(status));
+    } else if (WEXITSTATUS(status) == 0) {
+        fde_log(FDE_INFO, "Autostart: '%s' (PID %d) exited without showing a frame", entry->command, pid);
+    } else {
+        fde_log(FDE_ERROR, "Autostart: '%s' (PID %d) exited with status %d", entry->command, pid, WEXITSTATUS(status));
+    }
+    entry_settle(entry, AUTOSTART_EXITED);
+}
+
+void autostart_for_each(autostart_iter_t iter, void *data) {
+    for (size_t i = 0; i < autostart.count; i++) {
+        const autostart_entry_t *entry = &autostart.entries[i];
+        int64_t ready_usec = entry->ready_ns ? (int64_t)((entry->ready_ns - entry->spawn_ns) / 1000) : -1;
+        iter(entry->command, group_name(entry->group), entry->pid, entry->state, ready_usec, data);
+    }
+}
+
+void autostart_finish(void) {
+    stop_watching();
+    DESTROY_AND_NULL(autostart.timer, wl_event_source_remove);
+    for (size_t i = 0; i < autostart.count; i++) {
+        char **argv = autostart.entries[i].argv;
+        for (size_t j = 0; argv && argv[j]; j++) free(argv[j]);
+        free(argv);
+        free(autostart.entries[i].command);
+    }
+    free(autostart.entries);
+    for (int i = 0; i < autostart.groups; i++) free(autostart.group_names[i]);
+    free(autostart.group_names);
+    memset(&autostart, 0, sizeof(autostart));
+    autostart.current_group = -1;
+}
@@ -0,0 +1,684 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_OUTPUT
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_ext_image_capture_source_v1.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_screencopy_v1.h>
+
+#include "ext-image-capture-source-v1-protocol.h"
+#include "ext-image-copy-capture-v1-protocol.h"
+
+#include <fde/comp/capture.h>
+#include <fde/config.h>
+#include <fde/utils/log.h>
+#include <fde/utils/pixel-copy.h>
+#include <fde/utils/pool.h>
+#include <fde/utils/workqueue.h>
+
+#define CAPTURE_SOURCE_MANAGER_VERSION 1
+#define CAPTURE_COPY_MANAGER_VERSION 1
+#define CAPTURE_BYTES_PER_PIXEL 4  // Output render formats are 32 bpp
+#define CAPTURE_MAX_READ_RECTS 16  // More damaged rectangles: one read of their bounding box
+#define CAPTURE_BAND_MIN_ROWS 64   // Smaller bands are not worth waking another worker
+
+typedef struct capture_source {
+    struct wlr_ext_image_capture_source_v1 base;
+    struct wlr_output *output;
+    struct wl_client *client;
+    pid_t pid;
+    struct wl_list link;  // capture.sources
+
+    int started;  // Sessions
+    int copies_in_flight;  // On the workers; frames wait in pending meanwhile
+
+    // Held back by max_fps: the newest output buffer and everything damaged since the last frame
+    struct wlr_buffer *pending_buffer;
+    struct timespec pending_when;
+    pixman_region32_t pending_damage;
+    struct wl_event_source *timer;
+    bool timer_armed;
+    uint64_t last_copy_ns;
+
+    capture_stats_t stats;
+
+    struct wl_listener output_commit;
+    struct wl_listener output_destroy;
+    struct wl_listener client_destroy;
+} capture_source_t;
+
+typedef struct capture_frame_event {
+    struct wlr_ext_image_capture_source_v1_frame_event base;
+    struct wlr_buffer *buffer;
+    struct timespec when;
+} capture_frame_event_t;
+
+// A CPU copy handed to the workers. Both buffers stay locked until it completes on the event loop
+typedef struct copy_job {
+    capture_source_t *source;  // NULL once the source is gone
+    struct wlr_ext_image_copy_capture_frame_v1 *frame;  // NULL once the client dropped it
+    struct wl_listener frame_destroy;
+    struct wl_list link;  // capture.jobs
+
+    struct wlr_buffer *src, *dst;
+    const char *src_data;
+    size_t src_stride;
+    uint32_t src_format;
+    char *dst_data;  // dst is in data pointer access until completion
+    size_t dst_stride;
+    uint32_t dst_format;
+
+    pixman_box32_t *rects;
+    int num_rects;
+    uint64_t bytes;
+    struct timespec when;
+
+    _Atomic int parts_left;
+    int num_parts;
+    struct copy_part {
+        struct copy_job *job;
+        int y1, y2;  // Band of rows
+    } parts[];
+} copy_job_t;
+
+FDE_POOL(capture_source_pool, capture_source_t)
+
+static struct {
+    compositor_t *server;
+    struct wl_global *global;
+    struct wl_list sources;  // capture_source_t
+    struct wl_listener display_destroy;
+
+    // CPU copies, created with the first one
+    fde_workqueue_t *wq;
+    int workers;
+    int event_fd;
+    struct wl_event_source *event_source;
+    struct wl_list jobs;  // copy_job_t
+} capture;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Read on every frame, so a reload applies at once
+static uint64_t frame_interval_ns(void) {
+    int max_fps = config ? config->capture.max_fps : CAPTURE_DEFAULT_MAX_FPS;
+    return max_fps > 0 ? 1000000000ULL / (uint64_t)max_fps : 0;
+}
+
+static uint64_t region_area(const pixman_box32_t *rects, int count) {
+    uint64_t area = 0;
+    for (int i = 0; i < count; i++) {
+        area += (uint64_t)(rects[i].x2 - rects[i].x1) * (uint64_t)(rects[i].y2 - rects[i].y1);
+    }
+    return area;
+}
+
+static bool read_rects(struct wlr_texture *texture, struct wlr_buffer *dst,
+        const pixman_box32_t *rects, int count) {
+    void *data;
+    uint32_t format;
+    size_t stride;
+    if (!wlr_buffer_begin_data_ptr_access(dst, WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &data, &format, &stride)) {
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < count; i++) {
+        const pixman_box32_t *rect = &rects[i];
+        ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options){
+            .data = data,
+            .format = format,
+            .stride = stride,
+            .dst_x = (uint32_t)rect->x1,
+            .dst_y = (uint32_t)rect->y1,
+            .src_box = {
+                .x = rect->x1,
+                .y = rect->y1,
+                .width = rect->x2 - rect->x1,
+                .height = rect->y2 - rect->y1,
+            },
+        });
+    }
+    wlr_buffer_end_data_ptr_access(dst);
+    return ok;
+}
+
+// Copies `damage` of src into dst; *bytes is what was written
+static bool copy_damage(capture_source_t *source, struct wlr_buffer *src, struct wlr_buffer *dst,
+        const pixman_region32_t *damage, uint64_t *bytes) {
+    int count;
+    const pixman_box32_t *rects = pixman_region32_rectangles(damage, &count);
+    if (count == 0) {
+        *bytes = 0;
+        return true;
+    }
+    struct wlr_renderer *renderer = source->output->renderer;
+    struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src);
+    if (!texture) {
+        return false;
+    }
+
+    bool ok;
+    struct wlr_dmabuf_attributes dmabuf;
+    source->stats.dmabuf = wlr_buffer_get_dmabuf(dst, &dmabuf);
+    if (source->stats.dmabuf) {
+        // Zero-copy: the GPU blits the damaged rectangles, nothing passes through the CPU
+        struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, dst, NULL);
+        ok = pass != NULL;
+        if (pass) {
+            wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+                .texture = texture,
+                .clip = damage,
+                .blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+            });
+            ok = wlr_render_pass_submit(pass);
+        }
+        *bytes = region_area(rects, count) * CAPTURE_BYTES_PER_PIXEL;
+    } else if (count > CAPTURE_MAX_READ_RECTS) {
+        // Каждый read_pixels — отдельное чтение из GPU: много мелких прямоугольников дороже одного общего
+        const pixman_box32_t *extents = pixman_region32_extents(damage);
+        ok = read_rects(texture, dst, extents, 1);
+        *bytes = region_area(extents, 1) * CAPTURE_BYTES_PER_PIXEL;
+    } else {
+        ok = read_rects(texture, dst, rects, count);
+        *bytes = region_area(rects, count) * CAPTURE_BYTES_PER_PIXEL;
+    }
+    wlr_texture_destroy(texture);
+    return ok;
+}
+
+static void source_start(struct wlr_ext_image_capture_source_v1 *base, bool with_cursors) {
+    capture_source_t *source = wl_container_of(base, source, base);
+    // Cursors are always painted into the frame, like the wlroots output source does
+    (void)with_cursors;
+    if (source->started++ == 0) {
+        wlr_output_lock_software_cursors(source->output, true);
+    }
+}
+
+static void drop_pending(capture_source_t *source) {
+    if (source->pending_buffer) {
+        wlr_buffer_unlock(source->pending_buffer);
+        source->pending_buffer = NULL;
+    }
+    pixman_region32_clear(&source->pending_damage);
+    if (source->timer_armed) {
+        wl_event_source_timer_update(source->timer, 0);
+        source->timer_armed = false;
+    }
+}
+
+static void source_stop(struct wlr_ext_image_capture_source_v1 *base) {
+    capture_source_t *source = wl_container_of(base, source, base);
+    if (source->started > 0 && --source->started == 0) {
+        wlr_output_lock_software_cursors(source->output, false);
+        drop_pending(source);
+    }
+}
+
+static void source_schedule_frame(struct wlr_ext_image_capture_source_v1 *base) {
+    capture_source_t *source = wl_container_of(base, source, base);
+    // A static screen has no frames of its own: render one, even if nothing is damaged
+    wlr_output_update_needs_frame(source->output);
+}
+
+static void finish_copy(capture_source_t *source, struct wlr_ext_image_copy_capture_frame_v1 *frame,
+        bool ok, uint64_t bytes, const struct timespec *when) {
+    if (!ok || !source) {
+        if (source) {
+            source->stats.failed++;
+            fde_log_ratelimited(FDE_ERROR, "Failed to copy a frame of %s for pid %d", source->output->name, source->pid);
+        }
+        wlr_ext_image_copy_capture_frame_v1_fail(frame, source ? EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_UNKNOWN :
+            EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_STOPPED);
+        return;
+    }
+    source->stats.frames++;
+    source->stats.bytes += bytes;
+    source->stats.full_bytes += (uint64_t)frame->buffer->width * (uint64_t)frame->buffer->height * CAPTURE_BYTES_PER_PIXEL;
+    wlr_ext_image_copy_capture_frame_v1_ready(frame, source->output->transform, when);
+}
+
+static void run_copy_part(void *data) {
+    struct copy_part *part = data;
+    copy_job_t *job = part->job;
+    for (int i = 0; i < job->num_rects; i++) {
+        const pixman_box32_t *rect = &job->rects[i];
+        int y1 = rect->y1 > part->y1 ? rect->y1 : part->y1;
+        int y2 = rect->y2 < part->y2 ? rect->y2 : part->y2;
+        if (y1 >= y2) {
+            continue;
+        }
+        fde_pixel_copy(job->dst_data + (size_t)y1 * job->dst_stride + (size_t)rect->x1 * CAPTURE_BYTES_PER_PIXEL,
+            job->dst_stride, job->dst_format,
+            job->src_data + (size_t)y1 * job->src_stride + (size_t)rect->x1 * CAPTURE_BYTES_PER_PIXEL,
+            job->src_stride, job->src_format, rect->x2 - rect->x1, y2 - y1);
+    }
+
+    // Последняя полоса будит event loop
+    if (atomic_fetch_sub_explicit(&job->parts_left, 1, memory_order_acq_rel) == 1) {
+        uint64_t one = 1;
+        if (write(capture.event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            fde_log(FDE_ERROR, "Failed to wake the event loop after a capture copy: %s", strerror(errno));
+        }
+    }
+}
+
+static void send_or_defer(capture_source_t *source);
+
+static void complete_job(copy_job_t *job) {
+    wlr_buffer_end_data_ptr_access(job->dst);
+    wlr_buffer_unlock(job->dst);
+    wlr_buffer_unlock(job->src);
+    if (job->frame) {
+        wl_list_remove(&job->frame_destroy.link);
+        finish_copy(job->source, job->frame, true, job->bytes, &job->when);
+    }
+    capture_source_t *source = job->source;
+    wl_list_remove(&job->link);
+    free(job->rects);
+    free(job);
+
+    // Кадры, пришедшие во время копии, ждали в pending
+    if (source && --source->copies_in_flight == 0 && source->pending_buffer) {
+        send_or_defer(source);
+    }
+}
+
+static int handle_copy_done(int fd, uint32_t mask, void *data) {
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        fde_log(FDE_ERROR, "Failed to read the capture eventfd: %s", strerror(errno));
+    }
+    copy_job_t *job, *tmp;
+    wl_list_for_each_safe(job, tmp, &capture.jobs, link) {
+        if (atomic_load_explicit(&job->parts_left, memory_order_acquire) == 0) {
+            complete_job(job);
+        }
+    }
+    return 0;
+}
+
+static void handle_frame_destroy(struct wl_listener *listener, void *data) {
+    copy_job_t *job = wl_container_of(listener, job, frame_destroy);
+    wl_list_remove(&job->frame_destroy.link);
+    job->frame = NULL;
+}
+
+static bool start_workers(void) {
+    if (capture.wq) {
+        return true;
+    }
+    capture.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (capture.event_fd < 0) {
+        fde_log(FDE_ERROR, "Failed to create the capture eventfd: %s", strerror(errno));
+        return false;
+    }
+    capture.event_source = wl_event_loop_add_fd(capture.server->wl_event_loop, capture.event_fd,
+        WL_EVENT_READABLE, handle_copy_done, NULL);
+    capture.wq = capture.event_source ? fde_workqueue_create(capture.workers) : NULL;
+    if (!capture.wq) {
+        fde_log(FDE_ERROR, "Failed to start capture workers, copying on the event loop");
+        DESTROY_AND_NULL(capture.event_source, wl_event_source_remove);
+        close(capture.event_fd);
+        capture.workers = 0;
+        return false;
+    }
+    return true;
+}
+
+// CPU-side shm copies (pixman renderer, headless outputs) go to the workers, split into bands of rows.
+// false: not applicable, the caller copies on the event loop
+static bool start_async_copy(capture_source_t *source, struct wlr_ext_image_copy_capture_frame_v1 *frame,
+        const capture_frame_event_t *event, const pixman_region32_t *damage) {
+    struct wlr_dmabuf_attributes dmabuf;
+    int count;
+    const pixman_box32_t *rects = pixman_region32_rectangles(damage, &count);
+    if (capture.workers <= 0 || count == 0 || wlr_buffer_get_dmabuf(frame->buffer, &dmabuf)) {
+        return false;
+    }
+
+    // Output buffers the CPU can read are persistent mappings (shm and dumb allocators): the lock keeps
+    // the mapping alive and the swapchain from reusing it, so the access is not held across the copy
+    void *src_data;
+    uint32_t src_format;
+    size_t src_stride;
+    if (!wlr_buffer_begin_data_ptr_access(event->buffer, WLR_BUFFER_DATA_PTR_ACCESS_READ, &src_data, &src_format, &src_stride)) {
+        return false;
+    }
+    wlr_buffer_end_data_ptr_access(event->buffer);
+
+    void *dst_data;
+    uint32_t dst_format;
+    size_t dst_stride;
+    if (!wlr_buffer_begin_data_ptr_access(frame->buffer, WLR_BUFFER_DATA_PTR_ACCESS_WRITE, &dst_data, &dst_format, &dst_stride)) {
+        return false;
+    }
+    if (!fde_pixel_copy_supported(dst_format, src_format) || !start_workers()) {
+        wlr_buffer_end_data_ptr_access(frame->buffer);
+        return false;
+    }
+
+    const pixman_box32_t *extents = pixman_region32_extents(damage);
+    int rows = extents->y2 - extents->y1;
+    int num_parts = rows / CAPTURE_BAND_MIN_ROWS;
+    num_parts = num_parts < 1 ? 1 : num_parts > capture.workers ? capture.workers : num_parts;
+
+    copy_job_t *job = calloc(1, sizeof(copy_job_t) + (size_t)num_parts * sizeof(struct copy_part));
+    pixman_box32_t *job_rects = job ? malloc((size_t)count * sizeof(pixman_box32_t)) : NULL;
+    if (!job_rects) {
+        free(job);
+        wlr_buffer_end_data_ptr_access(frame->buffer);
+        return false;
+    }
+    memcpy(job_rects, rects, (size_t)count * sizeof(pixman_box32_t));
+    *job = (copy_job_t){
+        .source = source,
+        .frame = frame,
+        .src = wlr_buffer_lock(event->buffer),
+        .src_data = src_data,
+        .src_stride = src_stride,
+        .src_format = src_format,
+        .dst = wlr_buffer_lock(frame->buffer),
+        .dst_data = dst_data,
+        .dst_stride = dst_stride,
+        .dst_format = dst_format,
+        .rects = job_rects,
+        .num_rects = count,
+        .bytes = region_area(rects, count) * CAPTURE_BYTES_PER_PIXEL,
+        .when = event->when,
+        .num_parts = num_parts,
+    };
+    atomic_init(&job->parts_left, num_parts);
+    job->frame_destroy.notify = handle_frame_destroy;
+    wl_signal_add(&frame->events.destroy, &job->frame_destroy);
+    wl_list_insert(capture.jobs.prev, &job->link);
+    source->copies_in_flight++;
+
+    int band = (rows + num_parts - 1) / num_parts;
+    for (int i = 0; i < num_parts; i++) {
+        job->parts[i] = (struct copy_part){
+            .job = job,
+            .y1 = extents->y1 + i * band,
+            .y2 = i == num_parts - 1 ? extents->y2 : extents->y1 + (i + 1) * band,
+        };
+        if (!fde_workqueue_push(capture.wq, run_copy_part, &job->parts[i])) {
+            // Очередь не принимает: полоса копируется здесь же
+            run_copy_part(&job->parts[i]);
+        }
+    }
+    return true;
+}
+
+static void source_copy_frame(struct wlr_ext_image_capture_source_v1 *base,
+        struct wlr_ext_image_copy_capture_frame_v1 *frame,
+        struct wlr_ext_image_capture_source_v1_frame_event *base_event) {
+    capture_source_t *source = wl_container_of(base, source, base);
+    capture_frame_event_t *event = wl_container_of(base_event, event, base);
+    struct wlr_buffer *dst = frame->buffer;
+    source->last_copy_ns = monotonic_ns();
+
+    // buffer_damage: what the session accumulated since the client's last frame plus what the client
+    // reported as stale in this buffer. Everything else already holds the current contents
+    pixman_region32_t damage;
+    pixman_region32_init_rect(&damage, 0, 0, (unsigned)dst->width, (unsigned)dst->height);
+    pixman_region32_intersect(&damage, &damage, &frame->buffer_damage);
+    if (start_async_copy(source, frame, event, &damage)) {
+        pixman_region32_fini(&damage);
+        return;
+    }
+    uint64_t bytes = 0;
+    bool ok = copy_damage(source, event->buffer, dst, &damage, &bytes);
+    pixman_region32_fini(&damage);
+    finish_copy(source, frame, ok, bytes, &event->when);
+}
+
+static const struct wlr_ext_image_capture_source_v1_interface source_impl = {
+    .start = source_start,
+    .stop = source_stop,
+    .schedule_frame = source_schedule_frame,
+    .copy_frame = source_copy_frame,
+};
+
+// Sessions waiting for a frame copy it from here; the others only accumulate the damage
+static void send_pending(capture_source_t *source) {
+    if (!source->pending_buffer || source->copies_in_flight) {
+        return;
+    }
+    capture_frame_event_t event = {
+        .base = { .damage = &source->pending_damage },
+        .buffer = source->pending_buffer,
+        .when = source->pending_when,
+    };
+    wl_signal_emit_mutable(&source->base.events.frame, &event.base);
+    drop_pending(source);
+}
+
+static int handle_timer(void *data) {
+    capture_source_t *source = data;
+    source->timer_armed = false;
+    send_pending(source);
+    return 0;
+}
+
+static void send_or_defer(capture_source_t *source) {
+    uint64_t interval = frame_interval_ns();
+    uint64_t since_copy = monotonic_ns() - source->last_copy_ns;
+    if (!interval || since_copy >= interval) {
+        send_pending(source);
+        return;
+    }
+    // Слишком рано: кадр ждёт таймера, следующие коммиты сливаются с ним
+    source->stats.throttled++;
+    if (!source->timer_armed) {
+        uint64_t wait_ms = (interval - since_copy + 999999) / 1000000;
+        wl_event_source_timer_update(source->timer, (int)wait_ms);
+        source->timer_armed = true;
+    }
+}
+
+static void update_constraints(capture_source_t *source) {
+    struct wlr_output *output = source->output;
+    if (!output->enabled || !output->swapchain) {
+        return;
+    }
+    // dmabuf formats are offered only when the renderer can blit into dmabufs, shm ones always
+    if (!wlr_ext_image_capture_source_v1_set_constraints_from_swapchain(&source->base, output->swapchain, output->renderer)) {
+        fde_log(FDE_ERROR, "Failed to set capture constraints for output %s", output->name);
+    }
+}
+
+static void handle_output_commit(struct wl_listener *listener, void *data) {
+    capture_source_t *source = wl_container_of(listener, source, output_commit);
+    const struct wlr_output_event_commit *event = data;
+    const struct wlr_output_state *state = event->state;
+
+    if (state->committed & (WLR_OUTPUT_STATE_ENABLED | WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_RENDER_FORMAT)) {
+        update_constraints(source);
+    }
+    if (!source->started || !(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+        return;
+    }
+
+    if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
+        pixman_region32_union(&source->pending_damage, &source->pending_damage, &state->damage);
+    } else {
+        pixman_region32_union_rect(&source->pending_damage, &source->pending_damage,
+            0, 0, (unsigned)state->buffer->width, (unsigned)state->buffer->height);
+    }
+    if (source->pending_buffer) {
+        wlr_buffer_unlock(source->pending_buffer);
+    }
+    source->pending_buffer = wlr_buffer_lock(state->buffer);
+    clock_gettime(CLOCK_MONOTONIC, &source->pending_when);
+    send_or_defer(source);
+}
+
+static void source_destroy(capture_source_t *source) {
+    fde_log(FDE_INFO, "Capture by pid %d on %s finished: %" PRIu64 " frames, %" PRIu64 " bytes copied, %" PRIu64
+        " for full frames, %" PRIu64 " throttled", source->pid, source->output->name, source->stats.frames,
+        source->stats.bytes, source->stats.full_bytes, source->stats.throttled);
+
+    copy_job_t *job;
+    wl_list_for_each(job, &capture.jobs, link) {
+        if (job->source == source) {
+            job->source = NULL;
+        }
+    }
+    // Sessions stop on the destroy signal
+    wlr_ext_image_capture_source_v1_finish(&source->base);
+    if (source->started) {
+        wlr_output_lock_software_cursors(source->output, false);
+    }
+    drop_pending(source);
+    pixman_region32_fini(&source->pending_damage);
+    wl_event_source_remove(source->timer);
+    wl_list_remove(&source->output_commit.link);
+    wl_list_remove(&source->output_destroy.link);
+    wl_list_remove(&source->client_destroy.link);
+    wl_list_remove(&source->link);
+    capture_source_pool_free(source);
+}
+
+static void handle_output_destroy(struct wl_listener *listener, void *data) {
+    capture_source_t *source = wl_container_of(listener, source, output_destroy);
+    source_destroy(source);
+}
+
+static void handle_client_destroy(struct wl_listener *listener, void *data) {
+    capture_source_t *source = wl_container_of(listener, source, client_destroy);
+    source_destroy(source);
+}
+
+// One source per client and output: max_fps and the statistics are per client
+static capture_source_t *source_get(struct wl_client *client, struct wlr_output *output) {
+    capture_source_t *source;
+    wl_list_for_each(source, &capture.sources, link) {
+        if (source->client == client && source->output == output) {
+            return source;
+        }
+    }
+
+    source = capture_source_pool_alloc();
+    if (!source) {
+        return NULL;
+    }
+    source->timer = wl_event_loop_add_timer(capture.server->wl_event_loop, handle_timer, source);
+    if (!source->timer) {
+        capture_source_pool_free(source);
+        return NULL;
+    }
+    wlr_ext_image_capture_source_v1_init(&source->base, &source_impl);
+    source->output = output;
+    source->client = client;
+    wl_client_get_credentials(client, &source->pid, NULL, NULL);
+    pixman_region32_init(&source->pending_damage);
+
+    source->output_commit.notify = handle_output_commit;
+    wl_signal_add(&output->events.commit, &source->output_commit);
+    source->output_destroy.notify = handle_output_destroy;
+    wl_signal_add(&output->events.destroy, &source->output_destroy);
+    source->client_destroy.notify = handle_client_destroy;
+    wl_client_add_destroy_listener(client, &source->client_destroy);
+    wl_list_insert(&capture.sources, &source->link);
+
+    update_constraints(source);
+    fde_log(FDE_DEBUG, "New capture source for pid %d on output %s", source->pid, output->name);
+    return source;
+}
+
+static void manager_handle_create_source(struct wl_client *client, struct wl_resource *manager_resource,
+        uint32_t new_id, struct wl_resource *output_resource) {
+    // A gone output gives an inert source: its sessions are stopped right away
+    struct wlr_output *output = wlr_output_from_resource(output_resource);
+    capture_source_t *source = output ? source_get(client, output) : NULL;
+    wlr_ext_image_capture_source_v1_create_resource(source ? &source->base : NULL, client, new_id);
+}
+
+static void manager_handle_destroy(struct wl_client *client, struct wl_resource *manager_resource) {
+    wl_resource_destroy(manager_resource);
+}
+
+static const struct ext_output_image_capture_source_manager_v1_interface manager_impl = {
+    .create_source = manager_handle_create_source,
+    .destroy = manager_handle_destroy,
+};
+
+static void manager_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client,
+        &ext_output_image_capture_source_manager_v1_interface, (int)version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &manager_impl, NULL, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+    wl_list_remove(&capture.display_destroy.link);
+    if (capture.wq) {
+        // Waits for the running copies: their buffers are released here
+        fde_workqueue_destroy(capture.wq);
+        capture.wq = NULL;
+        copy_job_t *job, *tmp;
+        wl_list_for_each_safe(job, tmp, &capture.jobs, link) {
+            complete_job(job);
+        }
+        DESTROY_AND_NULL(capture.event_source, wl_event_source_remove);
+        close(capture.event_fd);
+    }
+    wl_global_destroy(capture.global);
+    capture.global = NULL;
+}
+
+bool capture_init(compositor_t *server, const struct capture *config) {
+    capture.server = server;
+    capture.workers = config->workers;
+    wl_list_init(&capture.sources);
+    wl_list_init(&capture.jobs);
+
+    if (!wlr_ext_image_copy_capture_manager_v1_create(server->wl_display, CAPTURE_COPY_MANAGER_VERSION)) {
+        fde_log(FDE_ERROR, "Failed to create the image copy capture manager");
+        return false;
+    }
+    capture.global = wl_global_create(server->wl_display, &ext_output_image_capture_source_manager_v1_interface,
+        CAPTURE_SOURCE_MANAGER_VERSION, NULL, manager_bind);
+    if (!capture.global) {
+        fde_log(FDE_ERROR, "Failed to create the output capture source manager");
+        return false;
+    }
+    capture.display_destroy.notify = handle_display_destroy;
+    wl_display_add_destroy_listener(server->wl_display, &capture.display_destroy);
+
+    if (config->screencopy) {
+        wlr_screencopy_manager_v1_create(server->wl_display);
+    }
+    fde_log(FDE_DEBUG, "Screen capture ready: max %d fps per client, %d copy workers%s", config->max_fps, config->workers,
+        config->screencopy ? ", wlr-screencopy enabled" : "");
+    return true;
+}
+
+void capture_for_each(capture_iter_t iter, void *data) {
+    if (!capture.server) {
+        return;
+    }
+    capture_source_t *source;
+    wl_list_for_each(source, &capture.sources, link) {
+        iter(source->pid, source->output->name, &source->stats, data);
+    }
+}
@@ -1,14 +1,20 @@
 #include <fde/input/seat.h>
+#include <fde/comp/autostart.h>
+#include <fde/comp/capture.h>
 #include <fde/plugin-system.h>
 #include <fde/dbus.h>
 #include <fde/utils/log.h>
+#include <fde/utils/startup.h>
+#include <fde/utils/task-graph.h>
 #include <fde/comp/compositor.h>
 #include <fde/config.h>
 #include <fde/comp/output.h>
 #include <fde/input/input-manager.h>
 #include <fde/input/cursor.h>
+#include <fde/plugin-resources.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <wayland-server-core.h>
 #include <wayland-server.h>
@@ -21,10 +27,14 @@
 #include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_fractional_scale_v1.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/types/wlr_output_power_management_v1.h>
-#include <wlr/types/wlr_screencopy_v1.h>
+#include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_primary_selection_v1.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_single_pixel_buffer_v1.h>
+#include <wlr/types/wlr_viewporter.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 
@@ -45,39 +55,156 @@ wl_signal_add(&server->default_seat->cursor->events.evt, &server->default_seat->
         return false; \
     };
 
-bool comp_init(compositor_t *server) {
-    fde_log(FDE_DEBUG, "Initializing wayland server");
+/*
+ * Startup graph. Worker tasks (bus connection, plugin scan, cursor theme) start first and overlap with
+ * the backend; the socket exists before the backend so clients can connect while we initialize, and
+ * plugins are launched only after the first frame.
+ */
 
-    // Dynamically create workspaces according to the user configuration
-    init_workspaces(&server->workspaces, config->workspaces.list, server);
+#define FIRST_FRAME_TIMEOUT_MS 1000  // Headless or no outputs: do not wait for a frame forever
+#define STARTUP_THREADS 3
 
-    server->wl_display = wl_display_create();
-    server->wl_event_loop = wl_display_get_event_loop(server->wl_display);
+static struct {
+    fde_task_graph_t *graph;
+    int first_frame;  // Milestone id
+    struct wl_event_source *first_frame_timer;
+    DBusConnection *dbus_conn;  // Connected on a worker, attached on the main thread
+    plugin_scan_t plugins;
+    // plugins_scan не трогает config: перезагрузка может освободить его, пока задача в работе
+    char *plugins_dir;
+    int compositor_cpu_weight;
+} startup;
+
+static bool task_dbus_connect(void *data) {
+    startup.dbus_conn = dbus_connect(FDE_DBUS_SERVICE_NAME);
+    return startup.dbus_conn != NULL;
+}
+
+static bool task_dbus_attach(void *data) {
+    compositor_t *server = data;
+    DBusConnection *conn = startup.dbus_conn;
+    startup.dbus_conn = NULL;
+    bool ok = dbus_attach(server, conn);
+    fde_startup_mark(FDE_STARTUP_DBUS);
+    return ok;
+}
+
+static bool task_plugins_scan(void *data) {
+    plugin_resources_init(startup.compositor_cpu_weight);
+    return plugin_scan_dir(startup.plugins_dir, &startup.plugins);
+}
+
+static bool task_plugins_launch(void *data) {
+    compositor_t *server = data;
+    if (!plugin_launch_scanned(server, &startup.plugins)) {
+        fde_log(FDE_ERROR, "Failed to load plugins.");
+    }
+    plugin_scan_finish(&startup.plugins);
+    free(startup.plugins_dir);
+    startup.plugins_dir = NULL;
+    fde_startup_mark(FDE_STARTUP_PLUGINS);
+    return true;
+}
 
+static bool task_socket(void *data) {
+    compositor_t *server = data;
+    server->socket = wl_display_add_socket_auto(server->wl_display);
+    if (!server->socket) {
+        fde_log(FDE_ERROR, "Unable to create the wayland socket");
+        return false;
+    }
+
+    // Set the WAYLAND_DISPLAY environment variable, so that clients know how to connect
+    // to our server
+    setenv("WAYLAND_DISPLAY", server->socket, true);
+
+    // Set up env vars to encourage applications to use wayland if possible
+    setenv("QT_QPA_PLATFORM", "wayland", true);
+    setenv("MOZ_ENABLE_WAYLAND", "1", true);
+    fde_startup_mark(FDE_STARTUP_SOCKET);
+    return true;
+}
+
+static bool task_backend(void *data) {
+    compositor_t *server = data;
     CREATE_ASSIGN_N_CHECK(server->backend, wlr_backend_autocreate(server->wl_event_loop, &server->session), "Unable to create backend");
+    fde_startup_mark(FDE_STARTUP_BACKEND);
+    return true;
+}
+
+static bool task_renderer(void *data) {
+    compositor_t *server = data;
     CREATE_ASSIGN_N_CHECK(server->renderer, wlr_renderer_autocreate(server->backend), "Failed to create renderer");
+    fde_startup_mark(FDE_STARTUP_RENDERER);
+    return true;
+}
+
+static bool task_allocator(void *data) {
+    compositor_t *server = data;
     CREATE_ASSIGN_N_CHECK(server->allocator, wlr_allocator_autocreate(server->backend, server->renderer), "Failed to create allocator");
+    fde_startup_mark(FDE_STARTUP_ALLOCATOR);
+    return true;
+}
+
+// wl_shm always; linux-dmabuf only when the renderer can import DMA-BUFs (not pixman). The scene sends
+// per-surface feedback with the scanout formats of the output the surface is on
+static bool init_client_buffers(compositor_t *server) {
+    if (!wlr_renderer_init_wl_shm(server->renderer, server->wl_display)) {
+        fde_log(FDE_ERROR, "Failed to create wl_shm");
+        return false;
+    }
+    if (wlr_renderer_get_texture_formats(server->renderer, WLR_BUFFER_CAP_DMABUF)) {
+        struct wlr_linux_dmabuf_v1 *linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(server->wl_display, 4, server->renderer);
+        if (linux_dmabuf) {
+            wlr_scene_set_linux_dmabuf_v1(server->scene, linux_dmabuf);
+        } else {
+            fde_log(FDE_ERROR, "Failed to create linux-dmabuf, clients fall back to wl_shm");
+        }
+    } else {
+        fde_log(FDE_INFO, "Renderer cannot import DMA-BUFs, clients use wl_shm");
+    }
+    // Сплошные цвета без буфера: сцена рисует их прямоугольником
+    wlr_single_pixel_buffer_manager_v1_create(server->wl_display);
+    // Fractional scales: clients render at device resolution and crop/scale with a viewport; the scene
+    // sends each surface the preferred scale of its output
+    wlr_viewporter_create(server->wl_display);
+    wlr_fractional_scale_manager_v1_create(server->wl_display, 1);
+    return true;
+}
+
+static bool task_globals(void *data) {
+    compositor_t *server = data;
     CREATE_ASSIGN_N_CHECK(server->compositor, wlr_compositor_create(server->wl_display, 6, server->renderer), "Failed to create compositor");
 	
     wlr_subcompositor_create(server->wl_display);
     wlr_data_device_manager_create(server->wl_display);
-    wlr_screencopy_manager_v1_create(server->wl_display);
+    capture_init(server, &config->capture);
     wlr_primary_selection_v1_device_manager_create(server->wl_display);
+    // Scene surfaces get feedback with the output's vblank timestamps, refresh and seq
+    wlr_presentation_create(server->wl_display, server->backend, 2);
 
     // Create an output layout, for handling the arrangement of multiple outputs
 	server->output_layout = wlr_output_layout_create(server->wl_display);
+    server->output_layout_change.notify = server_output_layout_change;
+    wl_signal_add(&server->output_layout->events.change, &server->output_layout_change);
 
-    wl_list_init(&server->outputs);
     ADD_EVENT(new_output, server_new_output, server);
 
     server->scene = wlr_scene_create();
+    if (!init_client_buffers(server)) {
+        return false;
+    }
 
     ADD_EVENT(new_input, server_new_input, server);
+    fde_startup_mark(FDE_STARTUP_GLOBALS);
+    return true;
+}
 
-    wl_list_init(&server->seats);
+static bool task_seat(void *data) {
+    compositor_t *server = data;
     server->default_seat = create_seat(server, DEFAULT_SEAT_NAME);
 
-    // Cursor
+    // Cursor; the theme is loaded by task_cursor_theme
     server->default_seat->cursor = wlr_cursor_create();
     wlr_cursor_attach_output_layout(server->default_seat->cursor, server->output_layout);
     server->default_seat->cursor_mgr = wlr_xcursor_manager_create(NULL, 24);
@@ -87,26 +214,124 @@ bool comp_init(compositor_t *server) {
     ADD_CURSOR_EVENT(motion_absolute, cursor_motion_absolute, cursor_motion_absolute_handler, server);
     ADD_CURSOR_EVENT(button, cursor_button, cursor_button_handler, server);
     ADD_CURSOR_EVENT(frame, cursor_frame, cursor_frame_handler, server);
+    fde_startup_mark(FDE_STARTUP_SEAT);
+    return true;
+}
+
+// Reads the theme files; nothing touches cursor_mgr until cursor_theme_ready is set
+static bool task_cursor_theme(void *data) {
+    compositor_t *server = data;
+    return wlr_xcursor_manager_load(server->default_seat->cursor_mgr, 1);
+}
 
+static bool task_cursor_apply(void *data) {
+    compositor_t *server = data;
+    fde_seat_t *seat = server->default_seat;
+    seat->cursor_theme_ready = true;
+    wlr_cursor_set_xcursor(seat->cursor, seat->cursor_mgr, "default");
     return true;
 }
 
-bool comp_start(compositor_t *server) {
-    fde_log(FDE_INFO, "Starting backend on wayland display '%s'", "wayland-0"); // server->socket_name
+static int handle_first_frame_timeout(void *data) {
+    compositor_t *server = data;
+    comp_first_frame(server);
+    return 0;
+}
+
+static bool task_backend_start(void *data) {
+    compositor_t *server = data;
+    fde_log(FDE_INFO, "Starting backend on wayland display '%s'", server->socket ?: "(none)");
     if (!wlr_backend_start(server->backend)) {
         fde_log(FDE_ERROR, "Failed to start wayland backend.");
-        wlr_backend_destroy(server->backend);
         return false;
     }
+    fde_startup_mark(FDE_STARTUP_BACKEND_START);
 
-    // Startup functional (Autostart applications, etc.)
-	if (fork() == 0) {
-		execl("/bin/sh", "/bin/sh", "-c", "kitty", (void *)NULL);
-	}
-
+    startup.first_frame_timer = wl_event_loop_add_timer(server->wl_event_loop, handle_first_frame_timeout, server);
+    if (startup.first_frame_timer) {
+        wl_event_source_timer_update(startup.first_frame_timer, FIRST_FRAME_TIMEOUT_MS);
+    }
     return true;
 }
 
+static bool task_autostart(void *data) {
+    compositor_t *server = data;
+    return autostart_run(server, &config->autostart);
+}
+
+static void startup_done(bool ok, void *data) {
+    compositor_t *server = data;
+    startup.graph = NULL;
+    DESTROY_AND_NULL(startup.first_frame_timer, wl_event_source_remove);
+    if (!ok) {
+        fde_log(FDE_ERROR, "Startup failed");
+        server->startup_failed = true;
+        wl_display_terminate(server->wl_display);
+        return;
+    }
+    fde_log(FDE_INFO, "Startup finished");
+}
+
+bool comp_init(compositor_t *server) {
+    fde_log(FDE_DEBUG, "Initializing wayland server");
+
+    // Dynamically create workspaces according to the user configuration
+    init_workspaces(&server->workspaces, &config->workspaces, server);
+
+    server->wl_display = wl_display_create();
+    server->wl_event_loop = wl_display_get_event_loop(server->wl_display);
+    wl_list_init(&server->outputs);
+    wl_list_init(&server->seats);
+    plugin_system_init(server);
+    fde_startup_mark(FDE_STARTUP_DISPLAY);
+
+    fde_task_graph_t *graph = fde_task_graph_create(server->wl_event_loop, STARTUP_THREADS, startup_done, server);
+    if (!graph) {
+        return false;
+    }
+    startup.graph = graph;
+
+    // Worker tasks without dependencies go first, so they overlap with the rest
+    int dbus_connect = fde_task_graph_add(graph, "dbus_connect", FDE_TASK_WORKER, task_dbus_connect, server, 0, true);
+    startup.plugins_dir = strdup(config->plugins.dir ? config->plugins.dir : "");
+    startup.compositor_cpu_weight = config->plugins.compositor_cpu_weight;
+    int plugins_scan = fde_task_graph_add(graph, "plugins_scan", FDE_TASK_WORKER, task_plugins_scan, server, 0, false);
+    int wl_socket = fde_task_graph_add(graph, "socket", FDE_TASK_MAIN, task_socket, server, 0, true);
+    int backend = fde_task_graph_add(graph, "backend", FDE_TASK_MAIN, task_backend, server, 0, true);
+    int renderer = fde_task_graph_add(graph, "renderer", FDE_TASK_MAIN, task_renderer, server,
+        FDE_TASK_DEP(backend), true);
+    int allocator = fde_task_graph_add(graph, "allocator", FDE_TASK_MAIN, task_allocator, server,
+        FDE_TASK_DEP(renderer), true);
+    int globals = fde_task_graph_add(graph, "globals", FDE_TASK_MAIN, task_globals, server,
+        FDE_TASK_DEP(renderer), true);
+    int seat = fde_task_graph_add(graph, "seat", FDE_TASK_MAIN, task_seat, server,
+        FDE_TASK_DEP(globals), true);
+    int cursor_theme = fde_task_graph_add(graph, "cursor_theme", FDE_TASK_WORKER, task_cursor_theme, server,
+        FDE_TASK_DEP(seat), false);
+    fde_task_graph_add(graph, "cursor_apply", FDE_TASK_MAIN, task_cursor_apply, server,
+        FDE_TASK_DEP(cursor_theme), false);
+    int backend_start = fde_task_graph_add(graph, "backend_start", FDE_TASK_MAIN, task_backend_start, server,
+        FDE_TASK_DEP(allocator) | FDE_TASK_DEP(globals) | FDE_TASK_DEP(seat), true);
+    int dbus_attach = fde_task_graph_add(graph, "dbus_attach", FDE_TASK_MAIN, task_dbus_attach, server,
+        FDE_TASK_DEP(dbus_connect), true);
+    startup.first_frame = fde_task_graph_add(graph, "first_frame", FDE_TASK_MILESTONE, NULL, NULL,
+        FDE_TASK_DEP(backend_start), false);
+    fde_task_graph_add(graph, "plugins_launch", FDE_TASK_MAIN, task_plugins_launch, server,
+        FDE_TASK_DEP(plugins_scan) | FDE_TASK_DEP(dbus_attach) | FDE_TASK_DEP(wl_socket) |
+        FDE_TASK_DEP(startup.first_frame), false);
+    fde_task_graph_add(graph, "autostart", FDE_TASK_MAIN, task_autostart, server,
+        FDE_TASK_DEP(wl_socket) | FDE_TASK_DEP(backend_start), false);
+
+    // Главные задачи выполняются сразу; рабочие завершаются уже в wl_display_run
+    return fde_task_graph_start(graph);
+}
+
+void comp_first_frame(compositor_t *server) {
+    if (startup.graph) {
+        fde_task_graph_complete(startup.graph, startup.first_frame);
+    }
+}
+
 void comp_run(compositor_t *server) {
     fde_log(FDE_INFO, "Running compositor");
 	wl_display_run(server->wl_display);
@@ -117,18 +342,35 @@ void comp_destroy(compositor_t *server, struct fde_config *config, char *config_
 
     fde_log(FDE_DEBUG, "Destroying server resources");
 
+    // Startup did not finish: wait for its workers
+    DESTROY_AND_NULL(startup.first_frame_timer, wl_event_source_remove);
+    // Зависший worker (dbus_bus_get) бросаем: его результаты и входные данные не освобождаем
+    bool joined = fde_task_graph_destroy(startup.graph);
+    startup.graph = NULL;
+    if (joined) {
+        DESTROY_AND_NULL(startup.dbus_conn, dbus_connection_unref);
+        plugin_scan_finish(&startup.plugins);
+        free(startup.plugins_dir);
+        startup.plugins_dir = NULL;
+    }
+
     if (server->dbus_source) {
         wl_event_source_remove(server->dbus_source);
         server->dbus_source = NULL;
     }
     cleanup_dbus(server);
+    autostart_finish();
 
+    if (server->output_layout_change.link.next) {
+        wl_list_remove(&server->output_layout_change.link);
+    }
     if (server->wl_display) {
         wl_display_destroy_clients(server->wl_display);
         wl_display_destroy(server->wl_display);
         server->wl_display = NULL;
         server->wl_event_loop = NULL;  // Авто-уничтожается с display
     }
+    finish_workspaces(server);
 
     if (config) free_config(config);
     FREE_AND_NULL(config_path);
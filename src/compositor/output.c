@@ -1,13 +1,26 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_OUTPUT
+
 #include <fde/comp/workspace.h>
 #include <fde/comp/compositor.h>
+#include <fde/comp/container.h>
 #include <fde/comp/output.h>
+#include <fde/config.h>
 #include <fde/utils/log.h>
+#include <fde/utils/pool.h>
+#include <fde/utils/startup.h>
+#include <fde/utils/trace.h>
 
 #include <stdlib.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+
+FDE_POOL(output_pool, fde_output_t)
 
 #define HANDLE_OUTPUT_EVENT(evt_name, evt, func) static void evt_name(struct wl_listener *list, void *data){\
     fde_output_t *output = wl_container_of(list, output, evt); \
@@ -22,55 +35,209 @@ static void apply_output_mode(struct wlr_output *wlr_output, struct wlr_output_s
         wlr_output_state_set_mode(state, mode);
         // wlr_output_state_set_custom_mode() to use mode from config
     }
+    float scale = config_output_scale(&config->outputs, wlr_output->name);
+    if (scale > 0) {
+        wlr_output_state_set_scale(state, scale);
+    }
+}
+
+void output_apply_config(fde_output_t *output) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    float scale = config_output_scale(&config->outputs, wlr_output->name);
+    if (scale <= 0) {
+        scale = 1;  // Убрали из конфига
+    }
+    if (scale == wlr_output->scale) {
+        return;
+    }
+    struct wlr_output_state state;
+    wlr_output_state_init(&state);
+    wlr_output_state_set_scale(&state, scale);
+    if (wlr_output_commit_state(wlr_output, &state)) {
+        fde_log(FDE_INFO, "Output %s scale set to %.3f", wlr_output->name, scale);
+    } else {
+        fde_log(FDE_ERROR, "Failed to set scale %.3f on output %s", scale, wlr_output->name);
+    }
+    wlr_output_state_finish(&state);
 }
 
 // TODO: Add plugins event init to add elements to scene
 static void start_using_output(fde_output_t *output) {
     compositor_t *server = output->server;
     wl_list_insert(&server->outputs, &output->link);
+    // Сначала в layout: активированный workspace берёт позицию output
+    wlr_output_layout_add_auto(server->output_layout, output->wlr_output);
 
-    // Init workspaces and add scene;
-    workspace_t *current_ws;
-    wl_list_for_each(current_ws, &server->workspaces, server_link) {
-        if (current_ws->output == NULL) {
-            fde_log(FDE_INFO, "Assigning new output workspace %s", current_ws->name);
-            workspace_assign_to_output(current_ws, output);
-            break;
-        }
+    // Первый свободный workspace в порядке конфига
+    workspace_t *ws = workspace_next_unassigned(server);
+    if (ws) {
+        fde_log(FDE_INFO, "Assigning new output workspace %s", ws->name);
+        workspace_assign_to_output(ws, output);
     }
+}
 
-    wlr_output_layout_add_auto(server->output_layout, output->wlr_output);
+const char *scanout_fallback_name(scanout_fallback_t reason) {
+    switch (reason) {
+        case SCANOUT_FALLBACK_SOFTWARE_CURSOR: return "software-cursor";
+        case SCANOUT_FALLBACK_GEOMETRY: return "geometry";
+        case SCANOUT_FALLBACK_TRANSFORM: return "transform";
+        case SCANOUT_FALLBACK_NOT_DMABUF: return "not-dmabuf";
+        case SCANOUT_FALLBACK_REJECTED: return "rejected";
+        case SCANOUT_FALLBACK_COUNT: break;
+    }
+    return "unknown";
+}
+
+// Why the fullscreen buffer would be composited; REJECTED when the scene can try and only the backend
+// can say no. false: nothing to show yet
+static bool scanout_fallback_reason(fde_output_t *output, fde_container_t *container, scanout_fallback_t *reason) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    struct wlr_scene_buffer *buffer = container->scene_surface ? container->scene_surface->buffer : NULL;
+    if (!buffer || !buffer->buffer) {
+        return false;
+    }
+
+    struct wlr_box box;
+    wlr_output_layout_get_box(output->server->output_layout, wlr_output, &box);
+    int lx, ly;
+    wlr_scene_node_coords(&buffer->node, &lx, &ly);
+    int dst_width = buffer->dst_width ? buffer->dst_width : buffer->buffer->width;
+    int dst_height = buffer->dst_height ? buffer->dst_height : buffer->buffer->height;
+    bool rotated = wlr_output->transform & WL_OUTPUT_TRANSFORM_90;
+    int width = rotated ? buffer->buffer->height : buffer->buffer->width;
+    int height = rotated ? buffer->buffer->width : buffer->buffer->height;
+    struct wlr_dmabuf_attributes dmabuf;
+
+    if (wlr_output->software_cursor_locks > 0) {
+        *reason = SCANOUT_FALLBACK_SOFTWARE_CURSOR;
+    } else if (lx != box.x || ly != box.y || dst_width != box.width || dst_height != box.height ||
+            width != wlr_output->width || height != wlr_output->height) {
+        *reason = SCANOUT_FALLBACK_GEOMETRY;
+    } else if (buffer->transform != wlr_output->transform) {
+        *reason = SCANOUT_FALLBACK_TRANSFORM;
+    } else if (!wlr_buffer_get_dmabuf(buffer->buffer, &dmabuf)) {
+        *reason = SCANOUT_FALLBACK_NOT_DMABUF;
+    } else {
+        *reason = SCANOUT_FALLBACK_REJECTED;
+    }
+    return true;
+}
+
+static void count_scanout(fde_output_t *output, scanout_fallback_t reason) {
+    output_scanout_stats_t *stats = &output->scanout_stats;
+    int state = output->scanout_direct ? -1 : (int)reason;
+    if (output->scanout_direct) {
+        stats->direct++;
+    } else {
+        stats->fallback[reason]++;
+    }
+    if (state != output->scanout_last) {
+        output->scanout_last = state;
+        fde_log(FDE_DEBUG, "Output %s: %s%s", output->wlr_output->name,
+            output->scanout_direct ? "direct scanout" : "composited fullscreen, ",
+            output->scanout_direct ? "" : scanout_fallback_name(reason));
+    }
 }
 
 void frame(fde_output_t *output, void *data) {
+    FDE_TRACE_SCOPE("output.frame");
     struct wlr_scene_output *scene_output = output->scene_output;
     if (!scene_output) {
-        fde_log(FDE_ERROR, "No scene_output for output %s", output->wlr_output->name);
+        fde_log_ratelimited(FDE_ERROR, "No scene_output for output %s", output->wlr_output->name);
         return;
     }
 
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint32_t seq = output->wlr_output->commit_seq;
+    // Причина решается до коммита; успешный scanout отмечает буфер контейнера во время коммита
+    fde_container_t *fullscreen = output->active_ws ? output->active_ws->fullscreen_container : NULL;
+    scanout_fallback_t reason;
+    bool scanout_candidate = fullscreen && scanout_fallback_reason(output, fullscreen, &reason);
+    output->scanout_direct = false;
+    FDE_TRACE_BEGIN("wlr_scene_output_commit");
     wlr_scene_output_commit(scene_output, NULL);
+    FDE_TRACE_END("wlr_scene_output_commit");
+    // Сцена коммитит только при повреждениях
+    if (output->wlr_output->commit_seq != seq) {
+        output->commit_pending = true;
+        output->commit_seq = output->wlr_output->commit_seq;
+        output->commit_time = start;
+        if (scanout_candidate) {
+            count_scanout(output, reason);
+        }
+        fde_startup_mark(FDE_STARTUP_FIRST_FRAME);
+        comp_first_frame(output->server);
+    }
 
+    // frame_done only tells clients to draw the next frame; when it reached the screen they learn
+    // from presentation-time feedback, sent by the scene on the output present event
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
     wlr_scene_output_send_frame_done(scene_output, &now);
 }
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+void present(fde_output_t *output, void *data) {
+    const struct wlr_output_event_present *event = data;
+    // Коммиты вне frame() (modeset, request_state) не считаем
+    if (!output->commit_pending || event->commit_seq != output->commit_seq) {
+        return;
+    }
+    output->commit_pending = false;
+
+    output_present_stats_t *stats = &output->present_stats;
+    if (!event->presented) {
+        stats->discarded++;
+        return;
+    }
+    // The presentation clock is CLOCK_MONOTONIC, like commit_time
+    uint64_t when = timespec_ns(&event->when), committed = timespec_ns(&output->commit_time);
+    uint64_t latency = when > committed ? when - committed : 0;
+    stats->latency_last_ns = latency;
+    stats->latency_sum_ns += latency;
+    if (latency > stats->latency_max_ns) {
+        stats->latency_max_ns = latency;
+    }
+    stats->refresh_ns = event->refresh > 0 ? (uint32_t)event->refresh : 0;
+    // Промах - кадр ждал дольше одного обновления; простой между коммитами промахом не считается
+    if (stats->refresh_ns && latency > stats->refresh_ns) {
+        stats->missed_vblanks += latency / stats->refresh_ns;
+    }
+    stats->presented++;
+}
 void request_state(fde_output_t *output, void *data) {
     const struct wlr_output_event_request_state *event = data;
 	wlr_output_commit_state(output->wlr_output, event->state);
 }
 void destroy(fde_output_t *output, void *data) {
+    workspace_park_output(output->server, output);
     wl_list_remove(&output->frame.link);
+    wl_list_remove(&output->present.link);
 	wl_list_remove(&output->request_state.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
-	free(output);
+    output->wlr_output->data = NULL;
+	output_pool_free(output);
 }
 
 HANDLE_OUTPUT_EVENT(output_frame, frame, frame);
+HANDLE_OUTPUT_EVENT(output_present, present, present);
 HANDLE_OUTPUT_EVENT(output_request_state, request_state, request_state);
 HANDLE_OUTPUT_EVENT(output_destroy, destroy, destroy)
 
+// Scale commits (also from output_apply_config), modesets and layout moves end up here
+void server_output_layout_change(struct wl_listener *listener, void *data) {
+    compositor_t *server = wl_container_of(listener, server, output_layout_change);
+    fde_output_t *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        workspace_output_changed(output);
+    }
+}
+
 void server_new_output(struct wl_listener *listener, void *data) {
     compositor_t *server = wl_container_of(listener, server, new_output);
     struct wlr_output *wlr_output = data;
@@ -82,6 +249,13 @@ void server_new_output(struct wl_listener *listener, void *data) {
         wlr_output->model,
         wlr_output->serial
     );
+
+    // Без fde_output_t вывод не включаем: им никто не будет управлять
+    fde_output_t *output = output_pool_alloc();
+    if (!output) {
+        fde_log(FDE_ERROR, "Failed to allocate output %s", wlr_output->name);
+        return;
+    }
     
     wlr_output_init_render(wlr_output, server->allocator, server->renderer);
     
@@ -94,14 +268,18 @@ void server_new_output(struct wl_listener *listener, void *data) {
     wlr_output_commit_state(wlr_output, &state);
     wlr_output_state_finish(&state);
 
-    fde_output_t *output = calloc(1, sizeof(fde_output_t));
     output->wlr_output = wlr_output;
     output->server = server;
+    output->scanout_last = SCANOUT_FALLBACK_COUNT;  // Nothing logged yet
+    wlr_output->data = output;
     
     /* Sets up a listener for the frame event. */
 	output->frame.notify = output_frame;
 	wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+    output->present.notify = output_present;
+    wl_signal_add(&wlr_output->events.present, &output->present);
+
 	/* Sets up a listener for the state request event. */
 	output->request_state.notify = output_request_state;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
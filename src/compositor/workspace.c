@@ -1,118 +1,323 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_OUTPUT
+
 #include <fde/comp/compositor.h>
 #include <fde/comp/output.h>
 #include <fde/comp/container.h>
 #include <fde/comp/workspace.h>
+#include <fde/config.h>
+#include <fde/utils/intern.h>
 #include <fde/utils/log.h>
+#include <fde/utils/pool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-util.h>
 
 #include <wlr/render/wlr_renderer.h>  // Для цветов (ARGB)
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_scene.h>     // Для scene API
+#include <wlr/util/box.h>
 
-#define CALLOC_AND_CHECK(ptr, type, logmsg) \
-    ptr = calloc(1, sizeof(type)); \
-    if (!ptr) { \
-      fde_log(FDE_ERROR, logmsg); \
-      return; \
-    };
+FDE_POOL(workspace_pool, workspace_t)
 
+// Binds the workspace to an output; it is shown only if the output has nothing active yet
 void workspace_assign_to_output(workspace_t *ws, fde_output_t *output) {
+    if (ws->output == output) {
+        return;
+    }
     if (ws->output != NULL) {
-        // Switch workspaces between outputs
-        // if (output->active_ws == NULL) {
-            
-        // }
-        // else {
-        //     workspace_t prev_ws = ws->output->active_ws; 
-
-        //     ws->output->active_ws = output->active_ws;
-        //     output->active_ws = prev_ws;
-
-        //     prev_ws = NULL;
-        // }
         fde_log(FDE_ERROR, "Changed the output of a workspace that already has an output");
+        workspace_hide(ws);
+    } else {
+        wl_list_remove(&ws->unassigned_link);
+        wl_list_init(&ws->unassigned_link);
     }
+    ws->output = output;
+
+    if (!output->active_ws) {
+        workspace_activate(ws);
+    }
+}
 
+bool workspace_activate(workspace_t *ws) {
+    fde_output_t *output = ws->output;
+    if (!output) {
+        fde_log(FDE_ERROR, "Cannot activate workspace %s: it has no output", ws->name);
+        return false;
+    }
+    if (output->active_ws == ws && ws->scene_tree && ws->scene_tree->node.enabled) {
+        return true;
+    }
+    // Scene создаётся только при первом показе
+    if (!workspace_init_scene(ws)) {
+        return false;
+    }
+    if (output->active_ws && output->active_ws != ws) {
+        workspace_hide(output->active_ws);
+    }
     output->active_ws = ws;
-    ws->output = output;
 
-    // Создаём scene_tree для workspace и привязываем к output scene
-    ws->scene_tree = wlr_scene_tree_create(&output->scene_output->scene->tree);
-    if (!ws->scene_tree) {
-        fde_log(FDE_ERROR, "Failed to create scene_tree for workspace %s", ws->name);
-        return;
+    // Workspace рисуется в координатах своего output в layout; перемещение обходит всё поддерево
+    struct wlr_box box;
+    wlr_output_layout_get_box(ws->server->output_layout, output->wlr_output, &box);
+    if (ws->scene_tree->node.x != box.x || ws->scene_tree->node.y != box.y) {
+        wlr_scene_node_set_position(&ws->scene_tree->node, box.x, box.y);
     }
-    // Инициализируем background и container внутри workspace
-    workspace_init_scene(ws);
+    wlr_scene_node_set_enabled(&ws->scene_tree->node, true);
+    fde_log(FDE_DEBUG, "Activated workspace %s on output %s", ws->name, output->wlr_output->name);
+    return true;
 }
 
-void init_workspaces(
-    struct wl_list *ws_list,
-    char ws_names[MAX_NUM_WORKSPACES][MAX_WORKSPACE_NAME_LEN],
-    compositor_t *server
-) {
-    fde_log(FDE_INFO, "Creating workspaces");
+// The tree stays, disabled: scene walk, damage and hit-testing skip it
+void workspace_hide(workspace_t *ws) {
+    if (ws->scene_tree) {
+        wlr_scene_node_set_enabled(&ws->scene_tree->node, false);
+    }
+    if (ws->output && ws->output->active_ws == ws) {
+        ws->output->active_ws = NULL;
+    }
+}
 
-    wl_list_init(ws_list);
+// Keeps the list in index order, so outputs take workspaces in config order
+static void unassigned_insert(compositor_t *server, workspace_t *ws) {
+    struct wl_list *pos = &server->unassigned_workspaces;
+    workspace_t *other;
+    wl_list_for_each(other, &server->unassigned_workspaces, unassigned_link) {
+        if (other->index > ws->index) {
+            pos = &other->unassigned_link;
+            break;
+        }
+    }
+    // Вставка перед pos
+    wl_list_insert(pos->prev, &ws->unassigned_link);
+}
 
-    char *name;
+void workspace_park_output(compositor_t *server, fde_output_t *output) {
     workspace_t *ws;
-    for (size_t i = 0; i < MAX_NUM_WORKSPACES; i++) {
-        name = ws_names[i];
-        if (!strlen(name)) {
-            fde_log(FDE_DEBUG, "No more workspace names found");
-            break;
+    wl_list_for_each(ws, &server->workspaces, server_link) {
+        if (ws->output == output) {
+            workspace_hide(ws);
+            ws->output = NULL;
+            unassigned_insert(server, ws);
+            fde_log(FDE_DEBUG, "Parked workspace %s: output %s is gone", ws->name, output->wlr_output->name);
+        }
+    }
+    output->active_ws = NULL;
+}
+
+workspace_t *workspace_find_by_name(compositor_t *server, const char *name) {
+    return name ? fde_hashmap_get_str(&server->workspaces_by_name, name) : NULL;
+}
+
+workspace_t *workspace_from_index(compositor_t *server, size_t index) {
+    return index < server->num_workspaces ? server->workspace_index[index] : NULL;
+}
+
+workspace_t *workspace_next_unassigned(compositor_t *server) {
+    if (wl_list_empty(&server->unassigned_workspaces)) {
+        return NULL;
+    }
+    workspace_t *ws = wl_container_of(server->unassigned_workspaces.next, ws, unassigned_link);
+    return ws;
+}
+
+bool workspace_switch(fde_output_t *output, workspace_t *ws) {
+    workspace_t *current = output->active_ws;
+    if (current == ws) {
+        return true;
+    }
+
+    fde_output_t *other = ws->output;
+    if (other && other != output) {
+        // Показанный на другом output меняется местами с текущим; скрытый просто переезжает
+        bool shown = other->active_ws == ws;
+        workspace_hide(ws);
+        ws->output = output;
+        if (shown && current) {
+            workspace_hide(current);
+            current->output = other;
+            workspace_activate(current);
         }
+    } else if (!other) {
+        workspace_assign_to_output(ws, output);
+    }
+    return workspace_activate(ws);
+}
 
-        CALLOC_AND_CHECK(ws, workspace_t, "Failed to create workspace instance");
-        memcpy(ws->name, name, sizeof(char) * MAX_WORKSPACE_NAME_LEN);
-        wl_list_insert(ws_list->prev, &ws->server_link);
+void init_workspaces(struct wl_list *ws_list, const struct workspaces *names, compositor_t *server) {
+    fde_log(FDE_INFO, "Creating workspaces");
 
-        ws->server=server;
-        
-        ws->scene_tree = NULL;
-        ws->background_node = NULL;
-        ws->container_tree = NULL;
+    wl_list_init(ws_list);
+    wl_list_init(&server->unassigned_workspaces);
+    fde_hashmap_init(&server->workspaces_by_name, true);
 
-        fde_log(FDE_DEBUG, "Initialized workspace %s", ws->name);
+    size_t count = config_workspace_count(names);
+    for (size_t i = 0; i < count; i++) {
+        if (!workspace_create(ws_list, names->names[i], server)) {
+            return;
+        }
     }
 }
 
-// Новая функция: Инициализация background и container в scene_tree workspace
-void workspace_init_scene(workspace_t *ws) {
-    if (!ws->scene_tree || !ws->output) {
-        fde_log(FDE_ERROR, "Cannot init scene: no scene_tree or output for workspace %s", ws->name);
-        return;
+void finish_workspaces(compositor_t *server) {
+    if (!server->workspaces.next) return;  // init_workspaces() was never reached
+    workspace_t *ws, *tmp;
+    wl_list_for_each_safe(ws, tmp, &server->workspaces, server_link) {
+        wl_list_remove(&ws->server_link);
+        workspace_pool_free(ws);
+    }
+    FREE_AND_NULL(server->workspace_index);
+    server->num_workspaces = server->workspace_index_cap = 0;
+    fde_hashmap_finish(&server->workspaces_by_name);
+}
+
+workspace_t *workspace_create(struct wl_list *ws_list, const char *name, compositor_t *server) {
+    fde_istr_t interned = fde_intern(name);
+    workspace_t *ws = interned ? workspace_pool_alloc() : NULL;
+    if (!ws) {
+        fde_log(FDE_ERROR, "Failed to create workspace instance");
+        return NULL;
     }
+    if (server->num_workspaces == server->workspace_index_cap) {
+        size_t cap = server->workspace_index_cap ? server->workspace_index_cap * 2 : 16;
+        workspace_t **index = realloc(server->workspace_index, cap * sizeof(workspace_t *));
+        if (!index) {
+            fde_log(FDE_ERROR, "Failed to grow the workspace index");
+            workspace_pool_free(ws);
+            return NULL;
+        }
+        server->workspace_index = index;
+        server->workspace_index_cap = cap;
+    }
+    ws->name = interned;
+    wl_list_init(&ws->containers);
+    wl_list_insert(ws_list->prev, &ws->server_link);
+
+    ws->index = server->num_workspaces++;
+    server->workspace_index[ws->index] = ws;
+    // Ключ — ws->name, интернированная строка живёт до конца работы
+    fde_hashmap_set_str(&server->workspaces_by_name, ws->name, ws);
+    wl_list_insert(server->unassigned_workspaces.prev, &ws->unassigned_link);
+
+    ws->server=server;
+
+    // Scene создаётся лениво, при первой активации или первом окне
+    ws->scene_tree = NULL;
+    ws->background_node = NULL;
+    ws->container_tree = NULL;
+
+    fde_log(FDE_DEBUG, "Initialized workspace %s", ws->name);
+    return ws;
+}
 
-    // Background: простой прямоугольник (leaf node, без детей). Размер — весь output (или workspace area)
-    struct wlr_output *wlr_out = ws->output->wlr_output;
-    int width = wlr_out->width;  // Или logical width с scale
-    int height = wlr_out->height;
-    float bg_color[4] = {255, 255, 255, 1};  // Чёрный (ARGB), настройте по умолчанию
-    ws->background_node = wlr_scene_rect_create(ws->scene_tree, width, height,bg_color);
-    if (!ws->background_node) {
-        fde_log(FDE_ERROR, "Failed to create background_node for workspace %s", ws->name);
+// Имя меняется на месте: scene tree и контейнеры не трогаем
+void workspace_rename(workspace_t *ws, const char *name) {
+    fde_istr_t interned = fde_intern(name);
+    if (!interned) {
         return;
     }
-    // Позиция background: (0,0) относительно workspace
-    wlr_scene_node_set_position(&ws->background_node->node, 0, 0);
+    fde_log(FDE_INFO, "Renaming workspace %s to %s", ws->name, name);
+    compositor_t *server = ws->server;
+    if (fde_hashmap_get_str(&server->workspaces_by_name, ws->name) == ws) {
+        fde_hashmap_remove_str(&server->workspaces_by_name, ws->name);
+    }
+    ws->name = interned;
+    fde_hashmap_set_str(&server->workspaces_by_name, ws->name, ws);
+}
+
+bool workspace_destroy(workspace_t *ws) {
+    if (ws->output || !wl_list_empty(&ws->containers)) {
+        return false;
+    }
+    if (ws->scene_tree) {
+        wlr_scene_node_destroy(&ws->scene_tree->node);
+    }
+    compositor_t *server = ws->server;
+    if (fde_hashmap_get_str(&server->workspaces_by_name, ws->name) == ws) {
+        fde_hashmap_remove_str(&server->workspaces_by_name, ws->name);
+    }
+    // Индекс остаётся плотным: следующие сдвигаются
+    for (size_t i = ws->index + 1; i < server->num_workspaces; i++) {
+        server->workspace_index[i - 1] = server->workspace_index[i];
+        server->workspace_index[i - 1]->index = i - 1;
+    }
+    server->num_workspaces--;
+    wl_list_remove(&ws->unassigned_link);
+    wl_list_remove(&ws->server_link);
+    fde_log(FDE_DEBUG, "Destroyed workspace %s", ws->name);
+    workspace_pool_free(ws);
+    return true;
+}
+
+// Creates the workspace tree (disabled until activated) and the container tree; the background is
+// added once the workspace has an output and follows its size. Safe to call again
+bool workspace_init_scene(workspace_t *ws) {
+    if (!ws->scene_tree) {
+        ws->scene_tree = wlr_scene_tree_create(&ws->server->scene->tree);
+        if (!ws->scene_tree) {
+            fde_log(FDE_ERROR, "Failed to create scene_tree for workspace %s", ws->name);
+            return false;
+        }
+        wlr_scene_node_set_enabled(&ws->scene_tree->node, false);
+    }
 
-    // Container: subtree для окон (добавляется как ребёнок workspace_tree)
-    ws->container_tree = wlr_scene_tree_create(ws->scene_tree);
+    // Background: простой прямоугольник (leaf node, без детей). Размер — весь output в логических
+    // координатах сцены (с учётом scale и transform)
+    if (ws->output) {
+        int width, height;
+        wlr_output_effective_resolution(ws->output->wlr_output, &width, &height);
+        if (!ws->background_node) {
+            float bg_color[4] = {255, 255, 255, 1};  // Чёрный (ARGB), настройте по умолчанию
+            ws->background_node = wlr_scene_rect_create(ws->scene_tree, width, height, bg_color);
+            if (!ws->background_node) {
+                fde_log(FDE_ERROR, "Failed to create background_node for workspace %s", ws->name);
+                return false;
+            }
+            // Фон всегда под окнами
+            wlr_scene_node_lower_to_bottom(&ws->background_node->node);
+        } else if (ws->background_node->width != width || ws->background_node->height != height) {
+            wlr_scene_rect_set_size(ws->background_node, width, height);
+        }
+    }
+
+    // Container: subtree для окон, выше background по z-order
     if (!ws->container_tree) {
-        fde_log(FDE_ERROR, "Failed to create container_tree for workspace %s", ws->name);
-        return;
+        ws->container_tree = wlr_scene_tree_create(ws->scene_tree);
+        if (!ws->container_tree) {
+            fde_log(FDE_ERROR, "Failed to create container_tree for workspace %s", ws->name);
+            return false;
+        }
+        fde_log(FDE_DEBUG, "Scene initialized for workspace %s", ws->name);
     }
-    // Позиция container: (0,0), но он будет выше background по z-order (добавлен позже)
+    return true;
+}
 
-    fde_log(FDE_INFO, "Scene initialized for workspace %s: background + container", ws->name);
+// Sampled on an output: scanned out directly or composited
+static void handle_container_output_sample(struct wl_listener *listener, void *data) {
+    const struct wlr_scene_output_sample_event *event = data;
+    fde_output_t *output = event->output->output->data;
+    if (output && event->direct_scanout) {
+        output->scanout_direct = true;
+    }
+}
+
+// Обычный кадр того же размера и с тем же opaque region на перекрытие не влияет
+static void handle_container_surface_commit(struct wl_listener *listener, void *data) {
+    fde_container_t *container = wl_container_of(listener, container, surface_commit);
+    struct wlr_surface *surface = container->surface;
+    if (surface->current.width == container->surface_width && surface->current.height == container->surface_height &&
+            pixman_region32_equal(&surface->opaque_region, &container->opaque)) {
+        return;
+    }
+    workspace_update_occlusion(container->workspace);
 }
 
 // Новая функция: Добавление контейнера (окна/shell) в scene
 void workspace_add_container(workspace_t *ws, fde_container_t *container) {
-    if (!ws->container_tree || !container) {
+    // Окно на ещё не показанном workspace: дерево создаётся сейчас, но остаётся скрытым
+    if (!container || !workspace_init_scene(ws)) {
         fde_log(FDE_ERROR, "Cannot add container: no container_tree or invalid container");
         return;
     }
@@ -126,6 +331,18 @@ void workspace_add_container(workspace_t *ws, fde_container_t *container) {
         return;
     }
 
+    container->scene_surface = surface_node;
+    container->scene_node = &surface_node->buffer->node;
+    container->scene_node->data = container;
+    container->output_sample.notify = handle_container_output_sample;
+    wl_signal_add(&surface_node->buffer->events.output_sample, &container->output_sample);
+
+    container->workspace = ws;
+    container->occluded = false;
+    pixman_region32_init(&container->opaque);
+    container->surface_commit.notify = handle_container_surface_commit;
+    wl_signal_add(&container->surface->events.commit, &container->surface_commit);
+
     // Добавляем в wl_list containers
     wl_list_insert(&ws->containers, &container->link);  // Предполагаем, что в fde_container_t есть struct wl_list link;
 
@@ -146,8 +363,12 @@ void workspace_add_container(workspace_t *ws, fde_container_t *container) {
 void workspace_remove_container(workspace_t *ws, fde_container_t *container) {
     // Найдите node контейнера (нужно хранить ссылку в fde_container_t, e.g., struct wlr_scene_node *scene_node;)
     if (container->scene_node) {  // Добавьте поле в fde_container_t
+        wl_list_remove(&container->output_sample.link);
+        wl_list_remove(&container->surface_commit.link);
+        pixman_region32_fini(&container->opaque);
         wlr_scene_node_destroy(container->scene_node);
         container->scene_node = NULL;
+        container->scene_surface = NULL;
     }
 
     wl_list_remove(&container->link);
@@ -177,21 +398,103 @@ void workspace_remove_container(workspace_t *ws, fde_container_t *container) {
 void workspace_update_layout(workspace_t *ws) {
     if (!ws->container_tree) return;
 
+    // Fullscreen: только его узел остаётся включённым, фон и остальные окна выключены
+    fde_container_t *fullscreen = ws->fullscreen_container;
+    if (ws->background_node) {
+        wlr_scene_node_set_enabled(&ws->background_node->node, !fullscreen);
+    }
+
     // Итерация по containers и установка позиций (ваш tiling/floating logic)
     fde_container_t *cont;
     int x = 0, y = 0;  // Пример: stack layout
     wl_list_for_each(cont, &ws->containers, link) {
-        if (cont->scene_node) {  // Поле в fde_container_t
+        if (!cont->scene_node) {  // Поле в fde_container_t
+            continue;
+        }
+        if (cont == fullscreen) {
+            // Workspace tree стоит в позиции output: (0, 0) совпадает с его углом
+            wlr_scene_node_set_position(cont->scene_node, 0, 0);
+            wlr_scene_node_raise_to_top(cont->scene_node);
+        } else {
             wlr_scene_node_set_position(cont->scene_node, x, y);
             x += cont->width;  // Адаптируйте под реальные размеры
         }
     }
-
-    // Для fullscreen: wlr_scene_node_set_position(fullscreen->scene_node, 0, 0); и raise_to_top
-    if (ws->fullscreen_container && ws->fullscreen_container->scene_node) {
-        wlr_scene_node_raise_to_top(ws->fullscreen_container->scene_node);
-    }
+    workspace_update_occlusion(ws);
 
     // Damage: wlroots автоматически отслеживает, но можно явно wlr_scene_node_schedule_redraw(&ws->scene_tree->node);
     fde_log(FDE_DEBUG, "Updated layout for workspace %s", ws->name);
 }
+
+void workspace_update_occlusion(workspace_t *ws) {
+    if (!ws->container_tree) return;
+
+    pixman_region32_t covered;  // Opaque area of the visible containers above, workspace coordinates
+    pixman_region32_init(&covered);
+    size_t occluded = 0;
+    struct wlr_scene_node *node;
+    wl_list_for_each_reverse(node, &ws->container_tree->children, link) {
+        fde_container_t *container = node->data;
+        if (!container) continue;
+
+        struct wlr_surface *surface = container->surface;
+        int width = surface->current.width, height = surface->current.height;
+        container->surface_width = width;
+        container->surface_height = height;
+        pixman_region32_copy(&container->opaque, &surface->opaque_region);
+
+        bool shown = !ws->fullscreen_container || container == ws->fullscreen_container;
+        pixman_box32_t box = { node->x, node->y, node->x + width, node->y + height };
+        container->occluded = shown && width > 0 && height > 0 &&
+            pixman_region32_contains_rectangle(&covered, &box) == PIXMAN_REGION_IN;
+        wlr_scene_node_set_enabled(node, shown && !container->occluded);
+        if (container->occluded) {
+            occluded++;
+        } else if (shown && pixman_region32_not_empty(&container->opaque)) {
+            pixman_region32_t opaque;
+            pixman_region32_init(&opaque);
+            pixman_region32_intersect_rect(&opaque, &container->opaque, 0, 0, (unsigned)width, (unsigned)height);
+            pixman_region32_translate(&opaque, node->x, node->y);
+            pixman_region32_union(&covered, &covered, &opaque);
+            pixman_region32_fini(&opaque);
+        }
+    }
+    pixman_region32_fini(&covered);
+
+    if (occluded != ws->occluded_containers) {
+        ws->occluded_containers = occluded;
+        fde_log(FDE_DEBUG, "Workspace %s: %zu container(s) fully occluded", ws->name, occluded);
+    }
+}
+
+void workspace_set_fullscreen(workspace_t *ws, fde_container_t *container) {
+    if (ws->fullscreen_container == container) {
+        return;
+    }
+    ws->fullscreen_container = container;
+    if (container && ws->output) {
+        // Логический размер output: его shell отправит клиенту в configure
+        wlr_output_effective_resolution(ws->output->wlr_output, &container->width, &container->height);
+    }
+    fde_log(FDE_DEBUG, "Workspace %s %s fullscreen", ws->name, container ? "entered" : "left");
+    workspace_update_layout(ws);
+}
+
+void workspace_output_changed(fde_output_t *output) {
+    struct wlr_box box;
+    wlr_output_layout_get_box(output->server->output_layout, output->wlr_output, &box);
+    workspace_t *ws;
+    wl_list_for_each(ws, &output->server->workspaces, server_link) {
+        if (ws->output != output || !ws->scene_tree) continue;
+        // Фон подгоняется под новый логический размер
+        workspace_init_scene(ws);
+        if (ws->scene_tree->node.x != box.x || ws->scene_tree->node.y != box.y) {
+            wlr_scene_node_set_position(&ws->scene_tree->node, box.x, box.y);
+        }
+        if (ws->fullscreen_container) {
+            wlr_output_effective_resolution(output->wlr_output, &ws->fullscreen_container->width,
+                &ws->fullscreen_container->height);
+        }
+        workspace_update_layout(ws);
+    }
+}
@@ -0,0 +1,306 @@
+#define _DEFAULT_SOURCE
+#define FDE_LOG_SUBSYSTEM FDE_LOG_CONFIG
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fde/config-cache.h>
+#include <fde/utils/hashmap.h>
+#include <fde/utils/log.h>
+
+#define CONFIG_CACHE_MAGIC 0x43454446  // "FDEC"
+#define CONFIG_CACHE_VERSION 1
+
+// Native byte order: the cache never leaves the machine. Entries are padded to 8 bytes.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t layout_hash;
+    uint32_t num_deps;
+    uint32_t num_records;
+    uint64_t deps_size;
+    uint64_t records_size;
+} cache_header_t;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+    uint32_t path_len;
+    uint32_t pad;
+} cache_dep_t;  // + path
+
+typedef struct {
+    uint16_t section;
+    uint16_t key_len;
+    uint32_t value_len;
+    uint32_t line;
+    uint32_t pad;
+} cache_record_t;  // + key + value
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} byte_buf_t;
+
+struct config_cache_builder {
+    byte_buf_t deps;
+    byte_buf_t records;
+    uint32_t num_deps;
+    uint32_t num_records;
+    bool failed;
+};
+
+static inline size_t pad8(size_t len) {
+    return (len + 7) & ~(size_t)7;
+}
+
+static void *buf_reserve(config_cache_builder_t *builder, byte_buf_t *buf, size_t len) {
+    len = pad8(len);
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 1024;
+        while (cap < buf->len + len) cap *= 2;
+        char *data = realloc(buf->data, cap);
+        if (!data) {
+            builder->failed = true;
+            return NULL;
+        }
+        buf->data = data;
+        buf->cap = cap;
+    }
+    void *ptr = buf->data + buf->len;
+    memset(ptr, 0, len);
+    buf->len += len;
+    return ptr;
+}
+
+config_cache_builder_t *config_cache_builder_create(void) {
+    return calloc(1, sizeof(config_cache_builder_t));
+}
+
+void config_cache_builder_destroy(config_cache_builder_t *builder) {
+    if (!builder) return;
+    free(builder->deps.data);
+    free(builder->records.data);
+    free(builder);
+}
+
+static void fill_dep(cache_dep_t *dep, const struct stat *sb) {
+    dep->dev = (uint64_t)sb->st_dev;
+    dep->ino = (uint64_t)sb->st_ino;
+    dep->mtime_sec = (int64_t)sb->st_mtim.tv_sec;
+    dep->mtime_nsec = (int64_t)sb->st_mtim.tv_nsec;
+    dep->size = (int64_t)sb->st_size;
+}
+
+void config_cache_add_dep(config_cache_builder_t *builder, const char *path, const struct stat *sb) {
+    size_t path_len = strlen(path);
+    char *entry = buf_reserve(builder, &builder->deps, sizeof(cache_dep_t) + path_len);
+    if (!entry) return;
+    cache_dep_t *dep = (cache_dep_t *)entry;
+    fill_dep(dep, sb);
+    dep->path_len = (uint32_t)path_len;
+    memcpy(entry + sizeof(cache_dep_t), path, path_len);
+    builder->num_deps++;
+}
+
+void config_cache_add_record(config_cache_builder_t *builder, uint16_t section, config_span_t key, config_span_t value, int line_num) {
+    if (key.len > UINT16_MAX || value.len > UINT32_MAX) {
+        builder->failed = true;
+        return;
+    }
+    char *entry = buf_reserve(builder, &builder->records, sizeof(cache_record_t) + key.len + value.len);
+    if (!entry) return;
+    cache_record_t *record = (cache_record_t *)entry;
+    record->section = section;
+    record->key_len = (uint16_t)key.len;
+    record->value_len = (uint32_t)value.len;
+    record->line = (uint32_t)line_num;
+    memcpy(entry + sizeof(cache_record_t), key.ptr, key.len);
+    memcpy(entry + sizeof(cache_record_t) + key.len, value.ptr, value.len);
+    builder->num_records++;
+}
+
+static bool cache_path(const char *root_path, char *out, size_t size, bool create_dir) {
+    char dir[PATH_MAX];
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    if (cache_home && cache_home[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s/fde", cache_home);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home) {
+            struct passwd *pw = getpwuid(getuid());
+            if (!pw) return false;
+            home = pw->pw_dir;
+        }
+        snprintf(dir, sizeof(dir), "%s/.cache/fde", home);
+    }
+
+    if (create_dir) {
+        // $XDG_CACHE_HOME может ещё не существовать
+        char *slash = dir;
+        while ((slash = strchr(slash + 1, '/'))) {
+            *slash = '\0';
+            mkdir(dir, 0700);
+            *slash = '/';
+        }
+        if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+
+    char real[PATH_MAX];
+    const char *key = realpath(root_path, real) ? real : root_path;
+    int len = snprintf(out, size, "%s/config-%016llx.cache", dir, (unsigned long long)fde_hash_string(key));
+    return len > 0 && (size_t)len < size;
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool config_cache_store(config_cache_builder_t *builder, const char *root_path) {
+    if (builder->failed) {
+        return false;
+    }
+
+    char path[PATH_MAX], tmp_path[PATH_MAX + 16];
+    if (!cache_path(root_path, path, sizeof(path), true)) {
+        return false;
+    }
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fde_log(FDE_DEBUG, "Cannot write config cache %s: %s", tmp_path, strerror(errno));
+        return false;
+    }
+
+    cache_header_t header = {
+        .magic = CONFIG_CACHE_MAGIC,
+        .version = CONFIG_CACHE_VERSION,
+        .layout_hash = config_layout_hash(),
+        .num_deps = builder->num_deps,
+        .num_records = builder->num_records,
+        .deps_size = builder->deps.len,
+        .records_size = builder->records.len,
+    };
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+        write_all(fd, builder->deps.data, builder->deps.len) &&
+        write_all(fd, builder->records.data, builder->records.len);
+    close(fd);
+
+    // rename() атомарен: параллельный запуск видит старый или новый кэш целиком
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    fde_log(FDE_DEBUG, "Stored config cache %s (%u files, %u values)", path, builder->num_deps, builder->num_records);
+    return true;
+}
+
+static bool deps_unchanged(const char *data, size_t size, uint32_t count, const char *root_path) {
+    size_t off = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (size - off < sizeof(cache_dep_t)) return false;
+        cache_dep_t dep;
+        memcpy(&dep, data + off, sizeof(dep));
+        if (size - off - sizeof(cache_dep_t) < dep.path_len || dep.path_len >= PATH_MAX) return false;
+
+        char path[PATH_MAX];
+        memcpy(path, data + off + sizeof(cache_dep_t), dep.path_len);
+        path[dep.path_len] = '\0';
+        off += pad8(sizeof(cache_dep_t) + dep.path_len);
+
+        // Первая зависимость — корневой файл
+        if (i == 0 && strcmp(path, root_path) != 0) return false;
+
+        struct stat sb;
+        cache_dep_t now = {0};
+        if (stat(path, &sb) != 0) return false;
+        fill_dep(&now, &sb);
+        if (now.dev != dep.dev || now.ino != dep.ino || now.mtime_sec != dep.mtime_sec ||
+            now.mtime_nsec != dep.mtime_nsec || now.size != dep.size) {
+            fde_log(FDE_DEBUG, "Config cache is stale: %s changed", path);
+            return false;
+        }
+    }
+    return count > 0 && off == size;
+}
+
+static bool replay_records(const char *data, size_t size, uint32_t count, struct fde_config *config) {
+    size_t off = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (size - off < sizeof(cache_record_t)) return false;
+        cache_record_t record;
+        memcpy(&record, data + off, sizeof(record));
+        size_t payload = (size_t)record.key_len + record.value_len;
+        if (size - off - sizeof(cache_record_t) < payload) return false;
+
+        const char *key = data + off + sizeof(cache_record_t);
+        config_span_t key_span = { key, record.key_len };
+        config_span_t value_span = { key + record.key_len, record.value_len };
+        if (!config_apply_value(config, record.section, key_span, value_span, (int)record.line)) {
+            return false;
+        }
+        off += pad8(sizeof(cache_record_t) + payload);
+    }
+    return off == size;
+}
+
+bool config_cache_load(const char *root_path, struct fde_config *config) {
+    char path[PATH_MAX];
+    if (!cache_path(root_path, path, sizeof(path), false)) {
+        return false;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(cache_header_t)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)sb.st_size;
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    bool ok = false;
+    cache_header_t header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic == CONFIG_CACHE_MAGIC && header.version == CONFIG_CACHE_VERSION &&
+        header.layout_hash == config_layout_hash() &&
+        header.deps_size <= size - sizeof(header) &&
+        header.records_size == size - sizeof(header) - header.deps_size) {
+        const char *deps = data + sizeof(header);
+        ok = deps_unchanged(deps, header.deps_size, header.num_deps, root_path) &&
+            replay_records(deps + header.deps_size, header.records_size, header.num_records, config);
+    }
+
+    munmap((void *)data, size);
+    return ok;
+}
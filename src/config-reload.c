@@ -0,0 +1,175 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_CONFIG
+
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fde/comp/compositor.h>
+#include <fde/comp/output.h>
+#include <fde/comp/workspace.h>
+#include <fde/config.h>
+#include <fde/config-reload.h>
+#include <fde/dbus.h>
+#include <fde/plugin-resources.h>
+#include <fde/plugin-system.h>
+#include <fde/utils/log.h>
+#include <fde/utils/trace.h>
+
+typedef struct reload_changes {
+    char **keys;  // "section.key"
+    size_t count, capacity;
+
+    bool plugins_dir;
+    bool compositor_cpu_weight;
+    bool workspaces;
+    bool outputs;
+} reload_changes_t;
+
+static void add_change(reload_changes_t *changes, const char *section, const char *key) {
+    if (changes->count == changes->capacity) {
+        size_t capacity = changes->capacity ? changes->capacity * 2 : 8;
+        char **keys = realloc(changes->keys, capacity * sizeof(char *));
+        if (!keys) return;
+        changes->keys = keys;
+        changes->capacity = capacity;
+    }
+    size_t len = strlen(section) + (key ? strlen(key) + 1 : 0) + 1;
+    char *name = malloc(len);
+    if (!name) return;
+    if (key) {
+        snprintf(name, len, "%s.%s", section, key);
+    } else {
+        snprintf(name, len, "%s", section);
+    }
+    changes->keys[changes->count++] = name;
+}
+
+static void collect_change(const config_section_desc_t *section, const config_key_desc_t *key, void *data) {
+    reload_changes_t *changes = data;
+    add_change(changes, section->section_name, key ? key->key_name : NULL);
+
+    if (strcmp(section->section_name, "workspaces") == 0) {
+        changes->workspaces = true;
+    } else if (strcmp(section->section_name, "outputs") == 0) {
+        changes->outputs = true;
+    } else if (key && strcmp(section->section_name, "plugins") == 0) {
+        if (strcmp(key->key_name, "dir") == 0) changes->plugins_dir = true;
+        else if (strcmp(key->key_name, "compositor_cpu_weight") == 0) changes->compositor_cpu_weight = true;
+        // call_budget_ms, demote_after, kill_after and [hotreload] are read on use
+        // [autostart] only runs once per session
+        // [capture] max_fps is read on every output frame, screencopy and workers only at startup
+    }
+}
+
+// Переименовываем на месте, добавляем новые в конец; лишние удаляем, только если они не заняты
+static void apply_workspaces(compositor_t *server, const struct fde_config *new) {
+    workspace_t *ws, *tmp;
+    size_t count = config_workspace_count(&new->workspaces);
+    size_t i = 0;
+    wl_list_for_each_safe(ws, tmp, &server->workspaces, server_link) {
+        if (i >= count) {
+            if (!workspace_destroy(ws)) {
+                fde_log(FDE_INFO, "Workspace %s is in use, keeping it after reload", ws->name);
+            }
+        } else if (ws->name != new->workspaces.names[i]) {
+            workspace_rename(ws, new->workspaces.names[i]);
+        }
+        i++;
+    }
+    for (; i < count; i++) {
+        workspace_create(&server->workspaces, new->workspaces.names[i], server);
+    }
+}
+
+static void stop_all_plugins(compositor_t *server) {
+    plugin_instance_t *plugin, *tmp;
+    wl_list_for_each_safe(plugin, tmp, &server->plugins, link) {
+        if (plugin->pid > 0) {
+            kill(plugin->pid, SIGTERM);
+            plugin_list_set_pid(server, plugin, 0);
+        }
+        plugin_unregister(server, plugin, "plugins dir changed");
+    }
+}
+
+// "<plugin>.conf" is the plugin's own settings: cgroup limits are updated live, rlimits need a restart
+static void reload_plugin_settings(compositor_t *server, reload_changes_t *changes) {
+    plugin_instance_t *plugin, *tmp;
+    wl_list_for_each_safe(plugin, tmp, &server->plugins, link) {
+        if (!plugin->exec_path) continue;
+
+        plugin_resources_t resources;
+        plugin_resources_defaults(&resources);
+        char conf_path[PATH_MAX + 8];
+        snprintf(conf_path, sizeof(conf_path), "%s.conf", plugin->exec_path);
+        plugin_resources_load_conf(&resources, conf_path);
+        if (plugin_resources_equal(&resources, &plugin->resources)) continue;
+
+        add_change(changes, "resources", plugin->name);
+        if (plugin_resources_update(&plugin->resources, &resources)) {
+            fde_log(FDE_INFO, "Updated resource limits of plugin %s", plugin->name);
+        } else {
+            fde_log(FDE_INFO, "Restarting plugin %s to apply new resource limits", plugin->name);
+            plugin_restart(server, plugin);
+        }
+    }
+}
+
+bool config_reload(compositor_t *server) {
+    FDE_TRACE_SCOPE("config.reload");
+    if (!config || !config->path) {
+        fde_log(FDE_ERROR, "Cannot reload config: no config file loaded");
+        return false;
+    }
+
+    struct fde_config fresh = {0};
+    if (!parse_config_file(config->path, &fresh)) {
+        fde_log(FDE_ERROR, "Config %s has errors, keeping the active config", config->path);
+        free_config(&fresh);
+        return false;
+    }
+
+    reload_changes_t changes = {0};
+    config_diff(config, &fresh, collect_change, &changes);
+
+    if (changes.workspaces) {
+        apply_workspaces(server, &fresh);
+    }
+
+    struct fde_config old = *config;
+    *config = fresh;
+    free_config(&old);
+
+    if (changes.outputs) {
+        fde_output_t *output;
+        wl_list_for_each(output, &server->outputs, link) {
+            output_apply_config(output);
+        }
+    }
+    if (changes.compositor_cpu_weight) {
+        plugin_resources_set_compositor_weight(config->plugins.compositor_cpu_weight);
+    }
+    if (changes.plugins_dir) {
+        stop_all_plugins(server);
+        load_plugins_from_dir(server, config);
+    } else {
+        reload_plugin_settings(server, &changes);
+    }
+
+    fde_log(FDE_INFO, "Config reloaded: %zu change(s)", changes.count);
+    if (changes.count) {
+        send_dbus_signal(
+            server,
+            "org.fde.Compositor.Config",
+            "ConfigChanged",
+            DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, changes.keys, (int)changes.count,
+            DBUS_TYPE_INVALID
+        );
+    }
+
+    for (size_t i = 0; i < changes.count; i++) free(changes.keys[i]);
+    free(changes.keys);
+    return true;
+}
@@ -0,0 +1,193 @@
+#define _DEFAULT_SOURCE
+#define FDE_LOG_SUBSYSTEM FDE_LOG_CONFIG
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <fde/config.h>
+#include <fde/config-validate.h>
+#include <fde/utils/log.h>
+#include <fde/utils/workqueue.h>
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} out_buf_t;
+
+typedef struct validate_job {
+    char *path;
+    bool ok;
+    out_buf_t out;  // JSON lines of this config, written at once
+} validate_job_t;
+
+typedef struct {
+    validate_job_t *items;
+    size_t count, cap;
+} job_list_t;
+
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void out_append(out_buf_t *buf, const char *data, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char *grown = realloc(buf->data, cap);
+        if (!grown) return;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+static void out_str(out_buf_t *buf, const char *str) {
+    out_append(buf, str, strlen(str));
+}
+
+static void out_json_string(out_buf_t *buf, const char *str, size_t len) {
+    out_append(buf, "\"", 1);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        char esc[8];
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)c;
+            out_append(buf, esc, 2);
+        } else if (c < 0x20) {
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out_append(buf, esc, 6);
+        } else {
+            out_append(buf, (const char *)&str[i], 1);
+        }
+    }
+    out_append(buf, "\"", 1);
+}
+
+static void collect_diagnostic(const config_diagnostic_t *diag, void *data) {
+    validate_job_t *job = data;
+    const char *file = diag->file ?: job->path;
+    char line[32];
+    snprintf(line, sizeof(line), "%d", diag->line);
+
+    out_str(&job->out, "{\"file\":");
+    out_json_string(&job->out, file, strlen(file));
+    out_str(&job->out, ",\"line\":");
+    out_str(&job->out, line);
+    out_str(&job->out, ",\"key\":");
+    if (diag->key.len) {
+        out_json_string(&job->out, diag->key.ptr, diag->key.len);
+    } else {
+        out_str(&job->out, "null");
+    }
+    out_str(&job->out, ",\"code\":\"");
+    out_str(&job->out, config_error_code_name(diag->code));
+    out_str(&job->out, "\",\"message\":");
+    out_json_string(&job->out, diag->message, strlen(diag->message));
+    out_str(&job->out, "}\n");
+}
+
+static void validate_one(void *data) {
+    validate_job_t *job = data;
+    struct fde_config config = {0};
+    config.diag = collect_diagnostic;
+    config.diag_data = job;
+    job->ok = validate_config_file(job->path, &config);
+    free_config(&config);
+
+    if (job->out.len) {
+        pthread_mutex_lock(&output_lock);
+        fwrite(job->out.data, 1, job->out.len, stdout);
+        pthread_mutex_unlock(&output_lock);
+    }
+}
+
+static bool add_job(job_list_t *jobs, const char *path) {
+    if (jobs->count == jobs->cap) {
+        size_t cap = jobs->cap ? jobs->cap * 2 : 64;
+        validate_job_t *items = realloc(jobs->items, cap * sizeof(validate_job_t));
+        if (!items) return false;
+        jobs->items = items;
+        jobs->cap = cap;
+    }
+    validate_job_t *job = &jobs->items[jobs->count];
+    memset(job, 0, sizeof(*job));
+    job->path = strdup(path);
+    if (!job->path) return false;
+    jobs->count++;
+    return true;
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name), suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+static void add_directory(job_list_t *jobs, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        fde_log(FDE_ERROR, "Cannot open %s: %s", dir_path, strerror(errno));
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || !has_suffix(entry->d_name, ".ini")) continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        struct stat sb;
+        if (entry->d_type == DT_REG || (entry->d_type == DT_UNKNOWN && stat(path, &sb) == 0 && S_ISREG(sb.st_mode))) {
+            add_job(jobs, path);
+        }
+    }
+    closedir(dir);
+}
+
+int config_validate_paths(char *const *paths, int num_paths, int num_threads) {
+    job_list_t jobs = {0};
+    for (int i = 0; i < num_paths; i++) {
+        struct stat sb;
+        if (stat(paths[i], &sb) == 0 && S_ISDIR(sb.st_mode)) {
+            add_directory(&jobs, paths[i]);
+        } else {
+            add_job(&jobs, paths[i]);  // Missing files are reported as diagnostics
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    fde_workqueue_t *wq = jobs.count > 1 ? fde_workqueue_create(num_threads) : NULL;
+    for (size_t i = 0; i < jobs.count; i++) {
+        if (!wq || !fde_workqueue_push(wq, validate_one, &jobs.items[i])) {
+            validate_one(&jobs.items[i]);
+        }
+    }
+    int threads = wq ? fde_workqueue_threads(wq) : 1;
+    if (wq) {
+        fde_workqueue_wait(wq);
+        fde_workqueue_destroy(wq);
+    }
+    fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    int invalid = 0;
+    for (size_t i = 0; i < jobs.count; i++) {
+        if (!jobs.items[i].ok) invalid++;
+        free(jobs.items[i].path);
+        free(jobs.items[i].out.data);
+    }
+    free(jobs.items);
+
+    fprintf(stderr, "Validated %zu config(s), %d invalid, in %.1f ms on %d thread(s): %.0f configs/sec\n",
+        jobs.count, invalid, seconds * 1000.0, threads, seconds > 0 ? (double)jobs.count / seconds : 0.0);
+    return invalid;
+}
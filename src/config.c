@@ -1,35 +1,145 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_CONFIG
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-// #include <ctype.h>    // isspace для trim
 #include <unistd.h>   // getuid для ~
 #include <pwd.h>      // getpwuid
+#include <sys/mman.h>
 #include <sys/stat.h> // Для load_config
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
 
 #include <fde/utils/log.h>
+#include <fde/utils/trace.h>
 #include <fde/utils/config_helpers.h>
+#include <fde/utils/hashmap.h>
 #include <fde/config.h>
+#include <fde/config-cache.h>
+#include <fde/comp/autostart.h>
+#include <fde/comp/capture.h>
+#include <fde/plugin-resources.h>
+#include <fde/plugin-watchdog.h>
 
 
 // TODO: Переделать создание конфига если файл не найден в load_config. Что-то придумать с гитом или файлами
-// TODO: Сделать поддержку вложенных плагинов: основной config.ini, в котором могут быть include(path). Например отдельные конфиги для каждого плагина, отдельный для input, keybinds, windows, etc.
+
+static char *default_autostart_argv[] = { "kitty", NULL };
+static autostart_command_t default_autostart[] = {
+    { .argv = default_autostart_argv, .group = 0, .wait = false },
+};
+
+// Interned by init_config_defaults()
+static fde_istr_t default_workspaces[] = { "main" };
 
 struct fde_config default_conf = {
     .plugins = {
-        .dir = "~/.config/fde/plugins/"
+        .dir = "~/.config/fde/plugins/",
+        .compositor_cpu_weight = COMPOSITOR_DEFAULT_CPU_WEIGHT,
+        .call_budget_ms = PLUGIN_DEFAULT_CALL_BUDGET_MS,
+        .demote_after = PLUGIN_DEFAULT_DEMOTE_AFTER,
+        .kill_after = PLUGIN_DEFAULT_KILL_AFTER
     },
     .hr = {
         .enabled = true,
         .scan_interval = 0
     },
     .workspaces = {
-        .list = { "main", 2, 3, 4, 5, 6, 7, 8, 9 }
+        .names = default_workspaces,
+        .count = sizeof(default_workspaces) / sizeof(default_workspaces[0])
+    },
+    .autostart = {
+        .commands = default_autostart,
+        .count = sizeof(default_autostart) / sizeof(default_autostart[0]),
+        .groups = 1,
+        .ready_timeout_ms = AUTOSTART_DEFAULT_READY_TIMEOUT_MS
+    },
+    .capture = {
+        .max_fps = CAPTURE_DEFAULT_MAX_FPS,
+        .screencopy = true,
+        .workers = CAPTURE_DEFAULT_WORKERS
     }
 };
 
+static void free_autostart(struct autostart *autostart) {
+    for (size_t i = 0; i < autostart->count; i++) {
+        char **argv = autostart->commands[i].argv;
+        for (size_t j = 0; argv && argv[j]; j++) free(argv[j]);
+        free(argv);
+    }
+    free(autostart->commands);
+    for (int i = 0; i < autostart->groups; i++) free(autostart->group_names[i]);
+    free(autostart->group_names);
+    *autostart = (struct autostart){0};
+}
+
+static bool autostart_add_group(struct autostart *autostart, char *name) {
+    char **names = realloc(autostart->group_names, (size_t)(autostart->groups + 1) * sizeof(char *));
+    if (!names) return false;
+    names[autostart->groups++] = name;
+    autostart->group_names = names;
+    return true;
+}
+
+// Takes ownership of argv
+static bool autostart_add_command(struct autostart *autostart, char **argv, bool wait) {
+    if (autostart->count == autostart->capacity) {
+        size_t capacity = autostart->capacity ? autostart->capacity * 2 : 8;
+        autostart_command_t *commands = realloc(autostart->commands, capacity * sizeof(autostart_command_t));
+        if (!commands) return false;
+        autostart->commands = commands;
+        autostart->capacity = capacity;
+    }
+    autostart->commands[autostart->count++] = (autostart_command_t){
+        .argv = argv,
+        .group = autostart->groups - 1,
+        .wait = wait,
+    };
+    return true;
+}
+
+size_t config_workspace_count(const struct workspaces *workspaces) {
+    size_t count = 0;
+    while (count < workspaces->count && workspaces->names[count]) count++;
+    return count;
+}
+
+// Slots skipped by wsN keys stay NULL
+static bool workspaces_set(struct workspaces *workspaces, size_t idx, fde_istr_t name) {
+    if (idx >= workspaces->capacity) {
+        size_t capacity = workspaces->capacity ? workspaces->capacity * 2 : 8;
+        if (capacity <= idx) capacity = idx + 1;
+        fde_istr_t *names = realloc(workspaces->names, capacity * sizeof(fde_istr_t));
+        if (!names) return false;
+        memset(names + workspaces->capacity, 0, (capacity - workspaces->capacity) * sizeof(fde_istr_t));
+        workspaces->names = names;
+        workspaces->capacity = capacity;
+    }
+    workspaces->names[idx] = name;
+    if (idx >= workspaces->count) workspaces->count = idx + 1;
+    return true;
+}
+
+static void init_autostart_defaults(struct autostart *autostart) {
+    *autostart = (struct autostart){ .ready_timeout_ms = default_conf.autostart.ready_timeout_ms };
+    autostart_add_group(autostart, NULL);
+    for (size_t i = 0; i < default_conf.autostart.count; i++) {
+        const autostart_command_t *cmd = &default_conf.autostart.commands[i];
+        size_t argc = 0;
+        while (cmd->argv[argc]) argc++;
+        char **argv = calloc(argc + 1, sizeof(char *));
+        for (size_t j = 0; argv && j < argc; j++) argv[j] = strdup(cmd->argv[j]);
+        if (!argv || !autostart_add_command(autostart, argv, cmd->wait)) {
+            free(argv);
+            break;
+        }
+    }
+}
+
 // Initialize config with defaults
 static void init_config_defaults(struct fde_config *config) {
     config->active = false;
@@ -37,126 +147,920 @@ static void init_config_defaults(struct fde_config *config) {
 
 
     config->plugins.dir = strdup(default_conf.plugins.dir ? default_conf.plugins.dir : "~/.config/fde/plugins/");
+    config->plugins.compositor_cpu_weight = default_conf.plugins.compositor_cpu_weight;
+    config->plugins.call_budget_ms = default_conf.plugins.call_budget_ms;
+    config->plugins.demote_after = default_conf.plugins.demote_after;
+    config->plugins.kill_after = default_conf.plugins.kill_after;
     config->hr.enabled = default_conf.hr.enabled;
     config->hr.scan_interval = default_conf.hr.scan_interval;
+    config->capture = default_conf.capture;
 
     // Initialize workspaces list with default names
-    for (int i = 0; i < MAX_NUM_WORKSPACES; i++) {
-        config->workspaces.list[i][0] = '\0';
+    config->workspaces = (struct workspaces){0};
+    for (size_t i = 0; i < default_conf.workspaces.count; i++) {
+        workspaces_set(&config->workspaces, i, fde_intern(default_conf.workspaces.names[i]));
+    }
+
+    init_autostart_defaults(&config->autostart);
+    config->outputs = (struct outputs){0};
+}
+
+static const config_span_t no_key = { "", 0 };
+
+const char *config_error_code_name(config_error_code_t code) {
+    switch (code) {
+        case CONFIG_ERR_SYNTAX: return "syntax";
+        case CONFIG_ERR_UNKNOWN_SECTION: return "unknown-section";
+        case CONFIG_ERR_UNKNOWN_KEY: return "unknown-key";
+        case CONFIG_ERR_INVALID_VALUE: return "invalid-value";
+        case CONFIG_ERR_INCLUDE: return "include";
+        case CONFIG_ERR_IO: return "io";
+    }
+    return "unknown";
+}
+
+static void config_error(const struct fde_config *config, int line_num, config_error_code_t code,
+        config_span_t key, const char *fmt, ...) ATTRIB_PRINTF(5, 6);
+static void config_error(const struct fde_config *config, int line_num, config_error_code_t code,
+        config_span_t key, const char *fmt, ...) {
+    if (!config->validating) return;
+    va_list args;
+    va_start(args, fmt);
+    if (config->diag) {
+        char message[512];
+        vsnprintf(message, sizeof(message), fmt, args);
+        config_diagnostic_t diag = {
+            .file = config->current_file,
+            .line = line_num,
+            .code = code,
+            .key = key,
+            .message = message,
+        };
+        config->diag(&diag, config->diag_data);
+        va_end(args);
+        return;
+    }
+    if (config->current_file) {
+        fprintf(stderr, "%s:%d: ", config->current_file, line_num);
+    } else {
+        fprintf(stderr, "Line %d: ", line_num);
+    }
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+static inline bool span_eq(config_span_t span, const char *str) {
+    size_t len = strlen(str);
+    return span.len == len && memcmp(span.ptr, str, len) == 0;
+}
+
+static config_span_t span_trim(const char *start, const char *end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    return (config_span_t){ start, (size_t)(end - start) };
+}
+
+static void span_copy(char *dst, size_t dst_size, config_span_t span) {
+    size_t len = span.len < dst_size - 1 ? span.len : dst_size - 1;
+    memcpy(dst, span.ptr, len);
+    dst[len] = '\0';
+}
+
+/*
+ * Perfect hash over section names and (section, key) pairs.
+ * Built once from the descriptor tables in config_helpers.h by searching for a collision-free seed,
+ * so every lookup is one hash, one slot and one memcmp.
+ */
+#define HASH_EMPTY_SLOT UINT16_MAX
+#define HASH_SECTION_PREFIX UINT16_MAX
+
+typedef struct {
+    uint16_t section;
+    uint16_t key;
+} config_hash_slot_t;
+
+static struct {
+    uint64_t seed;
+    size_t section_mask;
+    size_t key_mask;
+    uint16_t *section_slots;
+    config_hash_slot_t *key_slots;
+} config_hash;
+static pthread_once_t config_hash_once = PTHREAD_ONCE_INIT;
+
+static uint64_t span_hash(uint64_t seed, uint16_t prefix, const char *ptr, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    hash = (hash ^ (prefix & 0xff)) * 0x100000001b3ULL;
+    hash = (hash ^ (prefix >> 8)) * 0x100000001b3ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)ptr[i]) * 0x100000001b3ULL;
+    }
+    return fde_hash_int(hash);
+}
+
+static bool try_hash_seed(uint64_t seed) {
+    for (size_t i = 0; i <= config_hash.section_mask; i++) config_hash.section_slots[i] = HASH_EMPTY_SLOT;
+    for (size_t i = 0; i <= config_hash.key_mask; i++) config_hash.key_slots[i].section = HASH_EMPTY_SLOT;
+
+    for (uint16_t s = 0; s < NUM_SECTIONS; s++) {
+        const char *name = sections[s].section_name;
+        size_t slot = span_hash(seed, HASH_SECTION_PREFIX, name, strlen(name)) & config_hash.section_mask;
+        if (config_hash.section_slots[slot] != HASH_EMPTY_SLOT) return false;
+        config_hash.section_slots[slot] = s;
+
+        for (uint16_t k = 0; k < sections[s].num_keys; k++) {
+            const char *key = sections[s].keys[k].key_name;
+            slot = span_hash(seed, s, key, strlen(key)) & config_hash.key_mask;
+            if (config_hash.key_slots[slot].section != HASH_EMPTY_SLOT) return false;
+            config_hash.key_slots[slot] = (config_hash_slot_t){ s, k };
+        }
+    }
+    config_hash.seed = seed;
+    return true;
+}
+
+static size_t table_size(size_t entries) {
+    size_t size = 8;
+    while (size < entries * 2) size *= 2;
+    return size;
+}
+
+static void build_config_hash(void) {
+    size_t num_keys = 0;
+    for (size_t s = 0; s < NUM_SECTIONS; s++) num_keys += sections[s].num_keys;
+
+    size_t section_size = table_size(NUM_SECTIONS);
+    size_t key_size = table_size(num_keys);
+    for (;;) {
+        config_hash.section_slots = calloc(section_size, sizeof(*config_hash.section_slots));
+        config_hash.key_slots = calloc(key_size, sizeof(*config_hash.key_slots));
+        if (!config_hash.section_slots || !config_hash.key_slots) {
+            fde_abort("Failed to allocate config hash tables");
+            return;
+        }
+        config_hash.section_mask = section_size - 1;
+        config_hash.key_mask = key_size - 1;
+
+        for (uint64_t seed = 1; seed <= 4096; seed++) {
+            if (try_hash_seed(seed)) {
+                fde_log(FDE_DEBUG, "Config perfect hash: seed %llu, %zu section / %zu key slots",
+                    (unsigned long long)seed, section_size, key_size);
+                return;
+            }
+        }
+        // Too dense for a quick seed search: grow the tables
+        free(config_hash.section_slots);
+        free(config_hash.key_slots);
+        section_size *= 2;
+        key_size *= 2;
+    }
+}
+
+static const config_section_desc_t *lookup_section(config_span_t name, uint16_t *index) {
+    size_t slot = span_hash(config_hash.seed, HASH_SECTION_PREFIX, name.ptr, name.len) & config_hash.section_mask;
+    uint16_t s = config_hash.section_slots[slot];
+    if (s == HASH_EMPTY_SLOT || !span_eq(name, sections[s].section_name)) {
+        return NULL;
     }
-    strncpy(config->workspaces.list[0], "main", MAX_WORKSPACE_NAME_LEN - 1);
-    config->workspaces.list[0][MAX_WORKSPACE_NAME_LEN - 1] = '\0';
+    *index = s;
+    return &sections[s];
+}
+
+static const config_key_desc_t *lookup_key(uint16_t section, config_span_t key) {
+    size_t slot = span_hash(config_hash.seed, section, key.ptr, key.len) & config_hash.key_mask;
+    config_hash_slot_t entry = config_hash.key_slots[slot];
+    if (entry.section != section || !span_eq(key, sections[section].keys[entry.key].key_name)) {
+        return NULL;
+    }
+    return &sections[section].keys[entry.key];
+}
+
+static bool parse_value_string(config_span_t value, void *target) {
+    char **str_target = (char **)target;
+    char *copy = malloc(value.len + 1);
+    if (!copy) return false;
+    span_copy(copy, value.len + 1, value);
+    free(*str_target);
+    *str_target = copy;
+    return true;
+}
+
+static bool parse_value_bool(config_span_t value, void *target) {
+    bool *bool_target = (bool *)target;
+    if (span_eq(value, "true") || span_eq(value, "1") ||
+        span_eq(value, "yes") || span_eq(value, "on")) {
+        *bool_target = true;
+    } else if (span_eq(value, "false") || span_eq(value, "0") ||
+               span_eq(value, "no") || span_eq(value, "off")) {
+        *bool_target = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_value_int(config_span_t value, void *target) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < value.len && (value.ptr[i] == '-' || value.ptr[i] == '+')) {
+        negative = value.ptr[i] == '-';
+        i++;
+    }
+    if (i == value.len) return false;
+
+    long long val = 0;
+    for (; i < value.len; i++) {
+        if (!isdigit((unsigned char)value.ptr[i])) return false;
+        val = val * 10 + (value.ptr[i] - '0');
+        if (val > (long long)INT_MAX + 1) return false;
+    }
+    if (negative) val = -val;
+    if (val > INT_MAX || val < INT_MIN) return false;
+    *(int *)target = (int)val;
+    return true;
+}
+
+static bool parse_key_value(const config_key_desc_t *key, config_span_t value, struct fde_config *config, int line_num) {
+    void *target = (void *)((char *)config + key->offset);
+    bool success = false;
+    switch (key->type) {
+        case TYPE_STRING:
+            success = parse_value_string(value, target);
+            break;
+        case TYPE_BOOL:
+            success = parse_value_bool(value, target);
+            break;
+        case TYPE_INT:
+            success = parse_value_int(value, target);
+            break;
+        case TYPE_ARRAY:
+            // Not supported here
+            success = false;
+            break;
+        default:
+            success = false;
+    }
+    if (!success) {
+        config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, (config_span_t){ key->key_name, strlen(key->key_name) }, "Invalid value for key '%s': %.*s", key->key_name, (int)value.len, value.ptr);
+    }
+    return success;
 }
 
 // Parse workspaces section (special case)
-static void parse_workspaces_section(const char *key, const char *value, struct fde_config *config, bool validating, int line_num) {
+static bool parse_workspaces_section(config_span_t key, config_span_t value, struct fde_config *config, int line_num) {
     // For example, keys like ws1, ws2, ... or just "list" with comma separated values
     // Here we support keys ws1..wsN for simplicity
-    if (strncmp(key, "ws", 2) == 0) {
-        int idx = atoi(key + 2) - 1;  // ws1 -> index 0
-        if (idx >= 0 && idx < MAX_NUM_WORKSPACES) {
-            strncpy(config->workspaces.list[idx], value, MAX_WORKSPACE_NAME_LEN - 1);
-            config->workspaces.list[idx][MAX_WORKSPACE_NAME_LEN - 1] = '\0';
-        } else if (validating) {
-            fprintf(stderr, "Line %d: Workspace index out of range: %s\n", line_num, key);
-        }
-    } else if (strcmp(key, "list") == 0) {
-        // Parse comma separated list
-        char *copy = strdup(value);
-        if (!copy) return;
-        char *token = strtok(copy, ",");
+    if (key.len > 2 && memcmp(key.ptr, "ws", 2) == 0) {
         int idx = 0;
-        while (token && idx < MAX_NUM_WORKSPACES) {
-            char *trimmed = trim(token);
-            strncpy(config->workspaces.list[idx], trimmed, MAX_WORKSPACE_NAME_LEN - 1);
-            config->workspaces.list[idx][MAX_WORKSPACE_NAME_LEN - 1] = '\0';
-            token = strtok(NULL, ",");
-            idx++;
+        config_span_t num = { key.ptr + 2, key.len - 2 };
+        if (!parse_value_int(num, &idx)) idx = 0;
+        idx--;  // ws1 -> index 0
+        if (idx < 0) {
+            config_error(config, line_num, CONFIG_ERR_UNKNOWN_KEY, key, "Workspace index out of range: %.*s", (int)key.len, key.ptr);
+            return false;
+        }
+        // Дыры ограничены, иначе ws2000000000 выделит гигабайты
+        if ((size_t)idx > config->workspaces.count + CONFIG_MAX_WORKSPACE_GAP) {
+            config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Workspace index too far past ws%zu: %.*s",
+                config->workspaces.count, (int)key.len, key.ptr);
+            return false;
         }
-        free(copy);
-    } else if (validating) {
-        fprintf(stderr, "Line %d: Unknown key in [workspaces]: %s\n", line_num, key);
+        fde_istr_t name = fde_intern_len(value.ptr, value.len);
+        if (!name || !workspaces_set(&config->workspaces, (size_t)idx, name)) {
+            config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Cannot store workspace %.*s", (int)key.len, key.ptr);
+            return false;
+        }
+        return true;
+    } else if (span_eq(key, "list")) {
+        // Parse comma separated list
+        const char *p = value.ptr, *end = value.ptr + value.len;
+        size_t idx = 0;
+        while (p <= end) {
+            const char *comma = memchr(p, ',', (size_t)(end - p));
+            if (!comma) comma = end;
+            config_span_t name = span_trim(p, comma);
+            if (name.len) {
+                fde_istr_t interned = fde_intern_len(name.ptr, name.len);
+                if (!interned || !workspaces_set(&config->workspaces, idx++, interned)) {
+                    config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Cannot store workspace %.*s",
+                        (int)name.len, name.ptr);
+                    return false;
+                }
+            }
+            p = comma + 1;
+        }
+        return true;
     }
+    config_error(config, line_num, CONFIG_ERR_UNKNOWN_KEY, key, "Unknown key in [workspaces]: %.*s", (int)key.len, key.ptr);
+    return false;
 }
 
-bool read_config(FILE *file, struct fde_config *config) {
-    if (!file || !config) {
-        fprintf(stderr, "Invalid arguments to read_config\n");
+// Interned: equal names are the same pointer
+static bool workspaces_equal(const struct fde_config *a, const struct fde_config *b) {
+    size_t count = config_workspace_count(&a->workspaces);
+    if (count != config_workspace_count(&b->workspaces)) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (a->workspaces.names[i] != b->workspaces.names[i]) return false;
+    }
+    return true;
+}
+
+#define OUTPUT_SCALE_STEP 120.0f  // wp_fractional_scale_v1 sends scale * 120
+#define OUTPUT_SCALE_MAX 10.0f
+
+// "1.5": digits with an optional fraction. Parsed by hand, strtof depends on the locale
+static bool parse_value_scale(config_span_t value, float *target) {
+    double scale = 0, unit = 1;
+    bool digits = false, fraction = false;
+    for (size_t i = 0; i < value.len; i++) {
+        char c = value.ptr[i];
+        if (c == '.' && !fraction) {
+            fraction = true;
+        } else if (isdigit((unsigned char)c)) {
+            digits = true;
+            if (fraction) {
+                unit /= 10;
+                scale += (c - '0') * unit;
+            } else {
+                scale = scale * 10 + (c - '0');
+            }
+        } else {
+            return false;
+        }
+        if (scale > OUTPUT_SCALE_MAX) return false;
+    }
+    float rounded = (float)(long)(scale * OUTPUT_SCALE_STEP + 0.5) / OUTPUT_SCALE_STEP;
+    if (!digits || rounded <= 0) return false;
+    *target = rounded;
+    return true;
+}
+
+float config_output_scale(const struct outputs *outputs, const char *name) {
+    for (size_t i = 0; i < outputs->count; i++) {
+        if (strcmp(outputs->items[i].name, name) == 0) return outputs->items[i].scale;
+    }
+    return outputs->default_scale;
+}
+
+static bool outputs_set_scale(struct outputs *outputs, fde_istr_t name, float scale) {
+    for (size_t i = 0; i < outputs->count; i++) {
+        if (outputs->items[i].name == name) {
+            outputs->items[i].scale = scale;
+            return true;
+        }
+    }
+    if (outputs->count == outputs->capacity) {
+        size_t capacity = outputs->capacity ? outputs->capacity * 2 : 4;
+        output_config_t *items = realloc(outputs->items, capacity * sizeof(output_config_t));
+        if (!items) return false;
+        outputs->items = items;
+        outputs->capacity = capacity;
+    }
+    outputs->items[outputs->count++] = (output_config_t){ .name = name, .scale = scale };
+    return true;
+}
+
+static bool parse_outputs_section(config_span_t key, config_span_t value, struct fde_config *config, int line_num) {
+    bool is_default = span_eq(key, "scale");
+    if (!is_default && !(key.len > 6 && memcmp(key.ptr, "scale.", 6) == 0)) {
+        config_error(config, line_num, CONFIG_ERR_UNKNOWN_KEY, key, "Unknown key in [outputs]: %.*s", (int)key.len, key.ptr);
         return false;
     }
+    float scale;
+    if (!parse_value_scale(value, &scale)) {
+        config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Invalid scale for %.*s: %.*s", (int)key.len, key.ptr, (int)value.len, value.ptr);
+        return false;
+    }
+    if (is_default) {
+        config->outputs.default_scale = scale;
+        return true;
+    }
+    fde_istr_t name = fde_intern_len(key.ptr + 6, key.len - 6);
+    if (!name || !outputs_set_scale(&config->outputs, name, scale)) {
+        config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Cannot store output %.*s", (int)key.len, key.ptr);
+        return false;
+    }
+    return true;
+}
 
-    init_config_defaults(config);
+static bool outputs_equal(const struct fde_config *a, const struct fde_config *b) {
+    if (a->outputs.default_scale != b->outputs.default_scale || a->outputs.count != b->outputs.count) return false;
+    for (size_t i = 0; i < a->outputs.count; i++) {
+        if (a->outputs.items[i].name != b->outputs.items[i].name || a->outputs.items[i].scale != b->outputs.items[i].scale) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits a command line like sh would for plain words and quotes: "..." (with \\ escapes), '...' and \\x.
+// No variables, globs or operators: the command is started without a shell
+static char **split_command(config_span_t value) {
+    size_t argc = 0, capacity = 4;
+    char **argv = calloc(capacity + 1, sizeof(char *));
+    char *word = malloc(value.len + 1);
+    if (!argv || !word) goto fail;
+
+    const char *p = value.ptr, *end = value.ptr + value.len;
+    while (p < end) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p == end) break;
+
+        size_t len = 0;
+        while (p < end && !isspace((unsigned char)*p)) {
+            if (*p == '\'') {
+                const char *close = memchr(p + 1, '\'', (size_t)(end - p - 1));
+                if (!close) goto fail;
+                memcpy(word + len, p + 1, (size_t)(close - p - 1));
+                len += (size_t)(close - p - 1);
+                p = close + 1;
+            } else if (*p == '"') {
+                for (p++; p < end && *p != '"'; p++) {
+                    if (*p == '\\' && p + 1 < end && strchr("\"\\$`", p[1])) p++;
+                    word[len++] = *p;
+                }
+                if (p == end) goto fail;
+                p++;
+            } else {
+                if (*p == '\\' && p + 1 < end) p++;
+                word[len++] = *p++;
+            }
+        }
+
+        if (argc == capacity) {
+            char **grown = realloc(argv, (capacity * 2 + 1) * sizeof(char *));
+            if (!grown) goto fail;
+            argv = grown;
+            capacity *= 2;
+        }
+        if (!(argv[argc] = strndup(word, len))) goto fail;
+        argv[++argc] = NULL;
+    }
+    free(word);
+    if (argc == 0) {
+        free(argv);
+        return NULL;
+    }
+    return argv;
+
+fail:
+    for (size_t i = 0; argv && i < argc; i++) free(argv[i]);
+    free(argv);
+    free(word);
+    return NULL;
+}
+
+// До первой команды из файла все команды - по умолчанию, в безымянной группе 0. Группы, объявленные
+// строками group до нее, остаются
+static void drop_default_commands(struct autostart *autostart) {
+    for (size_t i = 0; i < autostart->count; i++) {
+        char **argv = autostart->commands[i].argv;
+        for (size_t j = 0; argv && argv[j]; j++) free(argv[j]);
+        free(argv);
+    }
+    autostart->count = 0;
+    if (autostart->groups > 1 && !autostart->group_names[0]) {
+        memmove(autostart->group_names, autostart->group_names + 1, (size_t)(autostart->groups - 1) * sizeof(char *));
+        autostart->groups--;
+    }
+    autostart->from_file = true;
+}
+
+static bool parse_autostart_section(config_span_t key, config_span_t value, struct fde_config *config, int line_num) {
+    struct autostart *autostart = &config->autostart;
+    if (autostart->groups == 0 && !autostart_add_group(autostart, NULL)) return false;
+
+    if (span_eq(key, "exec") || span_eq(key, "exec_wait")) {
+        char **argv = split_command(value);
+        if (!argv) {
+            config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Invalid command: %.*s", (int)value.len, value.ptr);
+            return false;
+        }
+        // Первая команда из файла заменяет команды по умолчанию; ready_timeout_ms или group сами по себе - нет
+        if (!autostart->from_file) {
+            drop_default_commands(autostart);
+        }
+        if (!autostart_add_command(autostart, argv, span_eq(key, "exec_wait"))) {
+            for (size_t i = 0; argv[i]; i++) free(argv[i]);
+            free(argv);
+            return false;
+        }
+        return true;
+    } else if (span_eq(key, "group")) {
+        char *name = value.len ? strndup(value.ptr, value.len) : NULL;
+        // Пустая текущая группа просто получает имя
+        bool empty = autostart->count == 0 || autostart->commands[autostart->count - 1].group != autostart->groups - 1;
+        if (empty) {
+            free(autostart->group_names[autostart->groups - 1]);
+            autostart->group_names[autostart->groups - 1] = name;
+            return true;
+        }
+        if (!autostart_add_group(autostart, name)) {
+            free(name);
+            return false;
+        }
+        return true;
+    } else if (span_eq(key, "ready_timeout_ms")) {
+        if (!parse_value_int(value, &autostart->ready_timeout_ms) || autostart->ready_timeout_ms < 0) {
+            config_error(config, line_num, CONFIG_ERR_INVALID_VALUE, key, "Invalid value for key 'ready_timeout_ms': %.*s", (int)value.len, value.ptr);
+            return false;
+        }
+        return true;
+    }
+    config_error(config, line_num, CONFIG_ERR_UNKNOWN_KEY, key, "Unknown key in [autostart]: %.*s", (int)key.len, key.ptr);
+    return false;
+}
+
+static bool autostart_equal(const struct fde_config *a, const struct fde_config *b) {
+    const struct autostart *x = &a->autostart, *y = &b->autostart;
+    if (x->count != y->count || x->groups != y->groups || x->ready_timeout_ms != y->ready_timeout_ms) return false;
+    for (size_t i = 0; i < x->count; i++) {
+        const autostart_command_t *cx = &x->commands[i], *cy = &y->commands[i];
+        if (cx->group != cy->group || cx->wait != cy->wait) return false;
+        size_t j = 0;
+        for (; cx->argv[j] && cy->argv[j]; j++) {
+            if (strcmp(cx->argv[j], cy->argv[j]) != 0) return false;
+        }
+        if (cx->argv[j] || cy->argv[j]) return false;
+    }
+    for (int i = 0; i < x->groups; i++) {
+        const char *nx = x->group_names[i], *ny = y->group_names[i];
+        if (nx != ny && (!nx || !ny || strcmp(nx, ny) != 0)) return false;
+    }
+    return true;
+}
+
+typedef struct config_parse_ctx {
+    struct fde_config *config;
+    config_cache_builder_t *cache;          // Records every applied value, NULL when not caching
+    const struct config_parse_ctx *parent;  // Including file
+    const char *path;                       // NULL for anonymous buffers
+    dev_t dev;
+    ino_t ino;
+    int depth;
+} config_parse_ctx_t;
+
+static bool parse_buffer(const config_parse_ctx_t *ctx, const char *data, size_t len);
+
+bool config_apply_value(struct fde_config *config, uint16_t section_index, config_span_t key, config_span_t value, int line_num) {
+    pthread_once(&config_hash_once, build_config_hash);
+    if (section_index >= NUM_SECTIONS) {
+        return false;
+    }
+    const config_section_desc_t *section = &sections[section_index];
+    if (section->handler) {
+        return section->handler(key, value, config, line_num);
+    }
+
+    const config_key_desc_t *desc = lookup_key(section_index, key);
+    if (!desc) {
+        config_error(config, line_num, CONFIG_ERR_UNKNOWN_KEY, key, "Unknown key: %.*s", (int)key.len, key.ptr);
+        return false;
+    }
+    return parse_key_value(desc, value, config, line_num);
+}
+
+// Names, types and offsets of all keys: a cache written by another build is not replayed
+uint64_t config_layout_hash(void) {
+    uint64_t hash = fde_hash_int(sizeof(struct fde_config));
+    for (size_t s = 0; s < NUM_SECTIONS; s++) {
+        hash = fde_hash_int(hash ^ fde_hash_string(sections[s].section_name));
+        for (size_t k = 0; k < sections[s].num_keys; k++) {
+            const config_key_desc_t *key = &sections[s].keys[k];
+            hash = fde_hash_int(hash ^ fde_hash_string(key->key_name));
+            hash = fde_hash_int(hash ^ ((uint64_t)key->type << 32 | key->offset));
+        }
+    }
+    return hash;
+}
+
+static bool parse_fd(const config_parse_ctx_t *ctx, int fd, const struct stat *sb) {
+    if (S_ISREG(sb->st_mode)) {
+        if (sb->st_size == 0) {
+            return parse_buffer(ctx, "", 0);
+        }
+        void *data = mmap(NULL, (size_t)sb->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            bool ok = parse_buffer(ctx, data, (size_t)sb->st_size);
+            munmap(data, (size_t)sb->st_size);
+            return ok;
+        }
+    }
+
+    // Pipes and other unmappable files: read everything first
+    size_t size = 0, cap = 4096;
+    char *buf = malloc(cap);
+    ssize_t n;
+    while (buf && (n = read(fd, buf + size, cap - size)) > 0) {
+        size += (size_t)n;
+        if (size == cap) {
+            char *grown = realloc(buf, cap *= 2);
+            if (!grown) free(buf);
+            buf = grown;
+        }
+    }
+    if (!buf) {
+        return false;
+    }
+    bool ok = parse_buffer(ctx, buf, size);
+    free(buf);
+    return ok;
+}
+
+static bool parse_file(struct fde_config *config, config_cache_builder_t *cache,
+        const config_parse_ctx_t *parent, int fd, const char *path, const struct stat *sb) {
+    config_parse_ctx_t ctx = {
+        .config = config,
+        .cache = cache,
+        .parent = parent,
+        .path = path,
+        .dev = sb->st_dev,
+        .ino = sb->st_ino,
+        .depth = parent ? parent->depth + 1 : 0,
+    };
+    if (cache) {
+        config_cache_add_dep(cache, path, sb);
+    }
+
+    const char *prev_file = config->current_file;
+    config->current_file = path;
+    bool ok = parse_fd(&ctx, fd, sb);
+    config->current_file = prev_file;
+    return ok;
+}
+
+// "~/..." is relative to $HOME, other relative paths to the directory of the including file
+static bool resolve_include(const char *parent_path, config_span_t inc, char *out, size_t size) {
+    int len;
+    if (inc.len >= 2 && inc.ptr[0] == '~' && inc.ptr[1] == '/') {
+        const char *home = getenv("HOME");
+        if (!home) {
+            struct passwd *pw = getpwuid(getuid());
+            home = pw ? pw->pw_dir : "";
+        }
+        len = snprintf(out, size, "%s%.*s", home, (int)inc.len - 1, inc.ptr + 1);
+    } else if (inc.ptr[0] == '/' || !parent_path || !strchr(parent_path, '/')) {
+        len = snprintf(out, size, "%.*s", (int)inc.len, inc.ptr);
+    } else {
+        int dir_len = (int)(strrchr(parent_path, '/') - parent_path);
+        len = snprintf(out, size, "%.*s/%.*s", dir_len, parent_path, (int)inc.len, inc.ptr);
+    }
+    return len > 0 && (size_t)len < size;
+}
+
+static bool parse_include(const config_parse_ctx_t *ctx, config_span_t inc, int line_num) {
+    struct fde_config *config = ctx->config;
+    char path[PATH_MAX];
+    if (inc.len == 0 || !resolve_include(ctx->path, inc, path, sizeof(path))) {
+        config_error(config, line_num, CONFIG_ERR_INCLUDE, no_key, "Invalid include path: %.*s", (int)inc.len, inc.ptr);
+        return false;
+    }
+    if (ctx->depth + 1 > CONFIG_MAX_INCLUDE_DEPTH) {
+        config_error(config, line_num, CONFIG_ERR_INCLUDE, no_key, "Includes nested deeper than %d: %s", CONFIG_MAX_INCLUDE_DEPTH, path);
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        config_error(config, line_num, CONFIG_ERR_INCLUDE, no_key, "Cannot include %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        config_error(config, line_num, CONFIG_ERR_INCLUDE, no_key, "Cannot include %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    for (const config_parse_ctx_t *p = ctx; p; p = p->parent) {
+        if (p->path && p->dev == sb.st_dev && p->ino == sb.st_ino) {
+            config_error(config, line_num, CONFIG_ERR_INCLUDE, no_key, "Include cycle: %s", path);
+            close(fd);
+            return false;
+        }
+    }
+
+    bool ok = parse_file(config, ctx->cache, ctx, fd, path, &sb);
+    close(fd);
+    return ok;
+}
+
+// Single pass over the buffer: no copies, no line length limit
+static bool parse_buffer(const config_parse_ctx_t *ctx, const char *data, size_t len) {
+    pthread_once(&config_hash_once, build_config_hash);
 
-    char line[512];
-    char current_section[128] = {0};
+    struct fde_config *config = ctx->config;
+    const char *p = data, *end = data + len;
+    const config_section_desc_t *section = NULL;
+    uint16_t section_index = 0;
+    bool in_section = false;
     int line_num = 0;
+    bool ok = true;
 
-    while (fgets(line, sizeof(line), file)) {
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
         line_num++;
-        char *l = trim(line);
+        config_span_t line = span_trim(p, eol);
+        p = eol + 1;
 
-        if (*l == '\0' || *l == '#') continue;
+        if (line.len == 0 || line.ptr[0] == '#') continue;
 
-        if (*l == '[') {
-            char *end = strchr(l, ']');
-            if (end) {
-                *end = '\0';
-                strncpy(current_section, l + 1, sizeof(current_section) - 1);
-                current_section[sizeof(current_section) - 1] = '\0';
-                trim(current_section);
-                continue;
-            } else {
-                if (config->validating) {
-                    fprintf(stderr, "Line %d: Invalid section header: %s\n", line_num, l);
-                }
+        // include(path): the included file has its own sections, ours continues after it
+        if (line.len > 9 && memcmp(line.ptr, "include(", 8) == 0 && line.ptr[line.len - 1] == ')') {
+            ok &= parse_include(ctx, span_trim(line.ptr + 8, line.ptr + line.len - 1), line_num);
+            continue;
+        }
+
+        if (line.ptr[0] == '[') {
+            const char *close = memchr(line.ptr, ']', line.len);
+            if (!close) {
+                config_error(config, line_num, CONFIG_ERR_SYNTAX, no_key, "Invalid section header: %.*s", (int)line.len, line.ptr);
+                ok = false;
                 continue;
             }
+            config_span_t name = span_trim(line.ptr + 1, close);
+            in_section = true;
+            section = lookup_section(name, &section_index);
+            if (!section) {
+                config_error(config, line_num, CONFIG_ERR_UNKNOWN_SECTION, no_key, "Unknown section: [%.*s]", (int)name.len, name.ptr);
+                ok = false;
+            }
+            continue;
         }
 
-        char *eq = strchr(l, '=');
+        const char *eq = memchr(line.ptr, '=', line.len);
         if (!eq) {
-            if (config->validating) {
-                fprintf(stderr, "Line %d: Invalid key=value line: %s\n", line_num, l);
+            config_error(config, line_num, CONFIG_ERR_SYNTAX, no_key, "Invalid key=value line: %.*s", (int)line.len, line.ptr);
+            ok = false;
+            continue;
+        }
+        // Keys of unknown sections were already reported with the section header
+        if (!section) {
+            if (!in_section) {
+                config_error(config, line_num, CONFIG_ERR_SYNTAX, no_key, "Key outside of a section: %.*s", (int)line.len, line.ptr);
+                ok = false;
             }
             continue;
         }
 
-        *eq = '\0';
-        char *key = trim(l);
-        char *value = trim(eq + 1);
+        config_span_t key = span_trim(line.ptr, eq);
+        config_span_t value = span_trim(eq + 1, line.ptr + line.len);
 
-        bool section_found = false;
-        for (size_t i = 0; i < sizeof(sections)/sizeof(sections[0]); i++) {
-            if (strcmp(current_section, sections[i].section_name) == 0) {
-                section_found = true;
-                parse_key_value(key, value, sections[i].keys, sections[i].num_keys, config, config->validating, line_num);
-                break;
-            }
+        if (!config_apply_value(config, section_index, key, value, line_num)) {
+            ok = false;
+        } else if (ctx->cache) {
+            config_cache_add_record(ctx->cache, section_index, key, value, line_num);
         }
+    }
 
-        // Add special read handlers for special types
-        if (!section_found) {
-            if (strcmp(current_section, "workspaces") == 0) {
-                parse_workspaces_section(key, value, config, config->validating, line_num);
-            } else if (config->validating && strlen(current_section) > 0) {
-                fprintf(stderr, "Line %d: Unknown section: [%s]\n", line_num, current_section);
-            }
-        }
+    return ok;
+}
+
+bool parse_config_buffer(const char *data, size_t len, struct fde_config *config) {
+    config_parse_ctx_t ctx = { .config = config };
+    return parse_buffer(&ctx, data, len);
+}
+
+bool read_config(FILE *file, struct fde_config *config) {
+    if (!file || !config) {
+        fprintf(stderr, "Invalid arguments to read_config\n");
+        return false;
     }
 
+    init_config_defaults(config);
+    config_parse_ctx_t ctx = { .config = config };
+    struct stat sb;
+    int fd = fileno(file);
+    bool ok = fd >= 0 && fstat(fd, &sb) == 0 && parse_fd(&ctx, fd, &sb);
+
     config->active = true;
     config->validating = false;
 
-    return true;
+    return ok;
 }
 
 void free_config(struct fde_config *config) {
     if (!config) return;
     free(config->plugins.dir);
-    free(config->plugins.dir);
+    config->plugins.dir = NULL;
+    free_autostart(&config->autostart);
+    free(config->workspaces.names);
+    config->workspaces = (struct workspaces){0};
+    free(config->outputs.items);
+    config->outputs = (struct outputs){0};
+    free(config->path);
+    config->path = NULL;
+}
+
+static bool key_equal(const config_key_desc_t *key, const struct fde_config *a, const struct fde_config *b) {
+    const void *va = (const char *)a + key->offset;
+    const void *vb = (const char *)b + key->offset;
+    switch (key->type) {
+        case TYPE_STRING: {
+            const char *sa = *(char *const *)va, *sb = *(char *const *)vb;
+            return sa == sb || (sa && sb && strcmp(sa, sb) == 0);
+        }
+        case TYPE_BOOL:
+            return *(const bool *)va == *(const bool *)vb;
+        case TYPE_INT:
+            return *(const int *)va == *(const int *)vb;
+        default:
+            return true;
+    }
+}
+
+size_t config_diff(const struct fde_config *old, const struct fde_config *new, config_diff_iter_t iter, void *data) {
+    size_t changed = 0;
+    for (size_t s = 0; s < NUM_SECTIONS; s++) {
+        const config_section_desc_t *section = &sections[s];
+        if (section->equal) {
+            if (!section->equal(old, new)) {
+                if (iter) iter(section, NULL, data);
+                changed++;
+            }
+            continue;
+        }
+        for (size_t k = 0; k < section->num_keys; k++) {
+            if (!key_equal(&section->keys[k], old, new)) {
+                if (iter) iter(section, &section->keys[k], data);
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+static void reset_config(struct fde_config *config) {
+    char *path = config->path;
+    config->path = NULL;
+    free_config(config);
+    init_config_defaults(config);
+    config->path = path;
+}
+
+// Root of the include tree: replay the compiled cache when none of the files changed
+static bool parse_config_path_fd(int fd, const char *path, struct fde_config *config) {
+    init_config_defaults(config);
+    config->path = strdup(path);
+
+    bool ok = false;
+    if (config_cache_load(path, config)) {
+        fde_log(FDE_DEBUG, "Config %s loaded from cache", path);
+        ok = true;
+    } else {
+        reset_config(config);
+        struct stat sb;
+        config_cache_builder_t *cache = config_cache_builder_create();
+        if (fstat(fd, &sb) == 0) {
+            ok = parse_file(config, cache, NULL, fd, path, &sb);
+        }
+        // Only clean trees are cached, so errors are reported again on the next start
+        if (ok && cache) {
+            config_cache_store(cache, path);
+        }
+        config_cache_builder_destroy(cache);
+    }
+
+    config->active = true;
+    config->validating = false;
+    return ok;
+}
+
+bool validate_config_file(const char *path, struct fde_config *config) {
+    init_config_defaults(config);
+    config->path = strdup(path);
+
+    bool ok = false;
+    struct stat sb;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+        config_error(config, 0, CONFIG_ERR_IO, no_key, "Cannot open %s: %s", path, strerror(errno));
+    } else if (S_ISDIR(sb.st_mode)) {
+        config_error(config, 0, CONFIG_ERR_IO, no_key, "%s is a directory not a config file", path);
+    } else {
+        ok = parse_file(config, NULL, NULL, fd, path, &sb);
+    }
+    if (fd >= 0) close(fd);
+
+    config->active = true;
+    config->validating = false;
+    return ok;
+}
+
+bool parse_config_file(const char *path, struct fde_config *config) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fde_log(FDE_ERROR, "Unable to open config file %s: %s", path, strerror(errno));
+        return false;
+    }
+    bool ok = parse_config_path_fd(fd, path, config);
+    close(fd);
+    return ok;
 }
 
 bool load_config(const char *path, struct fde_config *config) {
+    FDE_TRACE_SCOPE("config.load");
     if (!path || !config) {
         fprintf(stderr, "Invalid arguments to load_config\n");
         return false;
@@ -170,8 +1074,8 @@ bool load_config(const char *path, struct fde_config *config) {
         return false;
     }
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         // TODO: Create config file from template
         // Auto-create default config.ini from template.
         // fde_log(FDE_INFO, "Config %s not found; creating default", path);
@@ -196,8 +1100,8 @@ bool load_config(const char *path, struct fde_config *config) {
         // fclose(default_f);
 
         // // Retry opening the created file.
-        // f = fopen(path, "r");
-        // if (!f) {
+        // fd = open(path, O_RDONLY | O_CLOEXEC);
+        // if (fd < 0) {
         //     fde_log(FDE_ERROR, "Unable to open newly created %s", path);
         //     return false;
         // }
@@ -205,8 +1109,8 @@ bool load_config(const char *path, struct fde_config *config) {
         return false;
     }
 
-    bool config_load_success = read_config(f, config);
-    fclose(f);
+    bool config_load_success = parse_config_path_fd(fd, path, config);
+    close(fd);
 
     if (!config_load_success) {
         fde_log(FDE_ERROR, "Error(s) loading config!");
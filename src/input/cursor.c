@@ -1,5 +1,9 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_INPUT
+
 #include <fde/comp/compositor.h>
 #include <fde/input/cursor.h>
+#include <fde/plugin-system.h>
+#include <fde/utils/trace.h>
 
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_xcursor_manager.h>
@@ -16,7 +20,9 @@ static void process_cursor_motion(fde_seat_t *seat, uint32_t time) {
 	// }
 
 	/* Otherwise, find the toplevel under the pointer and send the event along. */
-	wlr_cursor_set_xcursor(seat->cursor, seat->cursor_mgr, "default");
+	if (seat->cursor_theme_ready) {
+		wlr_cursor_set_xcursor(seat->cursor, seat->cursor_mgr, "default");
+	}
 	
 	// if (surface) {
 	// 	/*
@@ -40,6 +46,7 @@ static void process_cursor_motion(fde_seat_t *seat, uint32_t time) {
 }
 
 void cursor_axis_handler(struct wl_listener *listener, void *data) {
+	FDE_TRACE_SCOPE("cursor.axis");
     fde_seat_t *seat = wl_container_of(listener, seat, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
 	/* Notify the client with pointer focus of the axis event. */
@@ -48,17 +55,23 @@ void cursor_axis_handler(struct wl_listener *listener, void *data) {
 			event->delta_discrete, event->source, event->relative_direction);
 };
 void cursor_frame_handler(struct wl_listener *listener, void *data) {
+	FDE_TRACE_SCOPE("cursor.frame");
 	fde_seat_t *seat = wl_container_of(listener, seat, cursor_frame);
 	wlr_seat_pointer_notify_frame(seat->wlr_seat);
 };
 void cursor_button_handler(struct wl_listener *listener, void *data) {
+	FDE_TRACE_SCOPE("cursor.button");
     struct wlr_pointer_button_event *event = data;
+	if (plugins_filter_button(server, event->time_msec, event->button, event->state)) {
+		return;
+	}
     /* Notify the client with pointer focus that a button press has occurred */
 	wlr_seat_pointer_notify_button(server->default_seat->wlr_seat,
 			event->time_msec, event->button, event->state);
 
 };
 void cursor_motion_handler(struct wl_listener *listener, void *data) {
+	FDE_TRACE_SCOPE("cursor.motion");
     fde_seat_t *seat = wl_container_of(listener, seat, cursor_frame);
 	struct wlr_pointer_motion_event *event = data;
 	/* The cursor doesn't move unless we tell it to. The cursor automatically
@@ -71,6 +84,7 @@ void cursor_motion_handler(struct wl_listener *listener, void *data) {
 	process_cursor_motion(seat, event->time_msec);
 };
 void cursor_motion_absolute_handler(struct wl_listener *listener, void *data) {
+	FDE_TRACE_SCOPE("cursor.motion_absolute");
 	fde_seat_t *seat = wl_container_of(listener, seat, cursor_frame);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	wlr_cursor_warp_absolute(seat->cursor, &event->pointer->base, event->x,
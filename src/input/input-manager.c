@@ -1,3 +1,5 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_INPUT
+
 #include <fde/utils/log.h>
 #include <fde/comp/compositor.h>
 #include <fde/input/input-manager.h>
@@ -11,7 +13,10 @@
 // static void configure_input_device(struct wlr_input_device *device, struct ) {}
 
 static void server_new_pointer(compositor_t *server, struct wlr_input_device *device) {
-    wlr_cursor_set_xcursor(server->default_seat->cursor, server->default_seat->cursor_mgr, "default");
+    // До загрузки темы курсор выставит task_cursor_apply
+    if (server->default_seat->cursor_theme_ready) {
+        wlr_cursor_set_xcursor(server->default_seat->cursor, server->default_seat->cursor_mgr, "default");
+    }
 }
 
 void server_new_input(struct wl_listener *listener, void *data) {
@@ -27,7 +32,7 @@ void server_new_input(struct wl_listener *listener, void *data) {
 		server_new_pointer(server, device);
 		break;
 	default:
-        fde_log(FDE_ERROR, "Received an unrecognised/unhandled new input, type %d", device->type);
+        fde_log_ratelimited(FDE_ERROR, "Received an unrecognised/unhandled new input, type %d", device->type);
 		break;
 	}
 
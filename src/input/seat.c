@@ -1,4 +1,7 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_INPUT
+
 #include <fde/utils/log.h>
+#include <fde/utils/pool.h>
 #include <fde/input/seat.h>
 
 #include <stdlib.h>
@@ -6,8 +9,10 @@
 #include <wayland-util.h>
 #include <wlr/types/wlr_seat.h>
 
+FDE_POOL(seat_pool, fde_seat_t)
+
 fde_seat_t *create_seat(compositor_t *server, char *name) {
-    fde_seat_t *seat = calloc(1, sizeof(fde_seat_t));
+    fde_seat_t *seat = seat_pool_alloc();
     if (!seat) {
         fde_log(FDE_ERROR, "Unable to create fde seat.");
         return NULL;
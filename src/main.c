@@ -8,9 +8,14 @@
 #include <stdlib.h>
 
 #include <fde/utils/log.h>
+#include <fde/utils/intern.h>
+#include <fde/utils/pool.h>
+#include <fde/utils/startup.h>
+#include <fde/utils/trace.h>
 #include <fde/comp/compositor.h>
 #include <fde/plugin-system.h>
 #include <fde/config.h>
+#include <fde/config-validate.h>
 #include <fde/dbus.h>
 
 #include <wayland-server-core.h>
@@ -43,6 +48,7 @@ void terminate(int exit_code) {
 
 int main(int argc, char *argv[]) {
     struct cli_args parsed_args = parse_cli_args(argc, argv);
+    fde_startup_init(parsed_args.startup_report);
 
     if (parsed_args.debug) {
 		fde_log_init(FDE_DEBUG, terminate);
@@ -60,60 +66,33 @@ int main(int argc, char *argv[]) {
     fde_log(FDE_INFO, "FDE VERSION: " FDE_VERSION);
     fde_log(FDE_INFO, "WLROOTS VERSION: " WLR_VERSION_STR);
 
+    if (parsed_args.validate) {
+        if (parsed_args.num_validate_paths) {
+            return config_validate_paths(parsed_args.validate_paths, parsed_args.num_validate_paths, parsed_args.jobs)
+                ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+        MINIMIZE_CHECK(!parsed_args.config_path, fprintf(stderr, "No config to validate.\n"); return EXIT_FAILURE;);
+        return config_validate_paths(&parsed_args.config_path, 1, 1) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
     // Config
     CALLOC_AND_CHECK(config, struct fde_config, free(parsed_args.config_path), "Failed to allocate config.", true);
     bool config_loaded = load_config(parsed_args.config_path, config);
-    if (parsed_args.validate) {
-        return config_loaded ? EXIT_SUCCESS : EXIT_FAILURE;
-    }
     MINIMIZE_CHECK(!config_loaded, fde_log(FDE_ERROR, "Failed to load config."); terminate(EXIT_FAILURE); goto shutdown;);
+    fde_startup_mark(FDE_STARTUP_CONFIG);
 
-    // Compositor
+    // Compositor: startup graph (socket, backend, D-Bus and plugins), see comp_init
     CALLOC_AND_CHECK(server, compositor_t, terminate(EXIT_FAILURE); goto shutdown, "Failed to create compositor server", false);
-    MINIMIZE_CHECK(!comp_init(server), return 1;);
-    MINIMIZE_CHECK(!comp_start(server), terminate(EXIT_FAILURE);goto shutdown;);
-
-    server->socket = wl_display_add_socket_auto(server->wl_display);
-	if (!server->socket) {
-		wlr_backend_destroy(server->backend);
-		return 1;
-	}
+    MINIMIZE_CHECK(!comp_init(server), terminate(EXIT_FAILURE); goto shutdown;);
 
-    // Set the WAYLAND_DISPLAY environment variable, so that clients know how to connect
-    // to our server
-	setenv("WAYLAND_DISPLAY", server->socket, true);
-
-    // Set up env vars to encourage applications to use wayland if possible
-    setenv("QT_QPA_PLATFORM", "wayland", true);
-    setenv("MOZ_ENABLE_WAYLAND", "1", true);
-
-    // DBus
-    MINIMIZE_CHECK(!init_dbus(server), fde_log(FDE_ERROR, "Failed to init D-Bus");terminate(EXIT_FAILURE);goto shutdown;);
-
-    int dbus_fd = -1;
-    dbus_bool_t fd_result = dbus_connection_get_unix_fd(server->dbus_conn, &dbus_fd);
-    MINIMIZE_CHECK(!fd_result || dbus_fd < 0, fde_log(FDE_ERROR, "Failed to get D-Bus fd: result=%d, fd=%d", fd_result, dbus_fd);goto shutdown;);
-    fde_log(FDE_DEBUG, "D-Bus fd obtained: %d", dbus_fd);
-
-    // Добавление fd в Wayland event loop (full mask)
-    server->dbus_source = wl_event_loop_add_fd(
-        server->wl_event_loop,
-        dbus_fd,
-        WL_EVENT_READABLE | WL_EVENT_WRITABLE | WL_EVENT_HANGUP | WL_EVENT_ERROR,
-        dbus_fd_handler,  // Из dbus.c
-        server
-    );
-    MINIMIZE_CHECK(!server->dbus_source, fde_log(FDE_ERROR, "Failed to add D-Bus fd (%d) to event loop", dbus_fd); goto shutdown;);
-
-    fde_log(FDE_DEBUG, "D-Bus fd (%d) added to Wayland event loop", dbus_fd);
-    
-    // Plugins
-    MINIMIZE_CHECK(!load_plugins_from_dir(server, config), fde_log(FDE_ERROR, "Failed to load plugins."););
-  
     comp_run(server);
+    MINIMIZE_CHECK(server->startup_failed, terminate(EXIT_FAILURE););
 
 shutdown:
     fde_log(FDE_INFO, "Shutting down fde");
     comp_destroy(server, config, parsed_args.config_path);  // Всё в одном вызове!
+    fde_pool_finish_all();
+    fde_intern_finish();
+    fde_trace_finish();
     return exit_value;
 }
\ No newline at end of file
@@ -1,13 +1,30 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_DBUS
+
 #include <fde/dbus.h>
+#include <fde/config-reload.h>
 
 #define CONFIG_INTERFACE "org.fde.Compositor.Config"
 
 static method_entry_t config_entries[] = {
     { CONFIG_INTERFACE, "GetConfigValue", handle_set_property },
     { CONFIG_INTERFACE, "SetConfigValue", handle_set_property },
-    { CONFIG_INTERFACE, "ReloadConfig", handle_set_property },
+    { CONFIG_INTERFACE, "ReloadConfig", handle_reload_config },
+    { NULL, NULL, NULL },
 };
 
 method_entry_t *get_config_method_entries() {
     return config_entries;
-}
\ No newline at end of file
+}
+
+DBusHandlerResult handle_reload_config(compositor_t *server, DBusMessage *msg) {
+    dbus_bool_t success = config_reload(server);
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
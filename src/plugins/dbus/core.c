@@ -1,6 +1,17 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_DBUS
+
+#include <fde/comp/autostart.h>
+#include <fde/comp/capture.h>
+#include <fde/comp/output.h>
+#include <fde/comp/workspace.h>
 #include <fde/dbus.h>
 #include <fde/plugin-system.h>
 #include <fde/utils/log.h> 
+#include <fde/utils/pool.h>
+#include <fde/utils/startup.h>
+#include <fde/utils/trace.h>
+
+#include <wlr/types/wlr_output.h>
 
 #define CORE_INTERFACE "org.fde.Compositor.Core"
 
@@ -8,6 +19,18 @@ static method_entry_t core_entries[] = {
     { "org.fde.Compositor.Core", "GetProperty", handle_get_property },
     { "org.fde.Compositor.Core", "SetProperty", handle_set_property },
     { "org.fde.Compositor.Core", "Introspect", handle_introspect },
+    { "org.fde.Compositor.Core", "SetLogLevel", handle_set_log_level },
+    { "org.fde.Compositor.Core", "GetLogLevels", handle_get_log_levels },
+    { "org.fde.Compositor.Core", "SetTracing", handle_set_tracing },
+    { "org.fde.Compositor.Core", "GetLogDropCounters", handle_get_log_drop_counters },
+    { "org.fde.Compositor.Core", "GetStartupReport", handle_get_startup_report },
+    { "org.fde.Compositor.Core", "GetAutostartReport", handle_get_autostart_report },
+    { "org.fde.Compositor.Core", "SwitchWorkspace", handle_switch_workspace },
+    { "org.fde.Compositor.Core", "GetPoolStats", handle_get_pool_stats },
+    { "org.fde.Compositor.Core", "GetCaptureStats", handle_get_capture_stats },
+    { "org.fde.Compositor.Core", "GetOutputStats", handle_get_output_stats },
+    { "org.fde.Compositor.Core", "GetScanoutStats", handle_get_scanout_stats },
+    { NULL, NULL, NULL },
 };
 
 method_entry_t *get_core_method_entries() {
@@ -317,4 +340,426 @@ DBusHandlerResult handle_set_property(compositor_t *server, DBusMessage *msg) {
     fde_log(FDE_DEBUG, "Set property '%s' to %s", prop_name, success ? "success" : "failed");
     dbus_error_free(&error);
     return DBUS_HANDLER_RESULT_HANDLED;
-}
\ No newline at end of file
+}
+
+// Логирование: уровни по подсистемам
+DBusHandlerResult handle_set_log_level(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
+
+    const char *subsystem = NULL;
+    const char *level = NULL;
+    if (!dbus_message_get_args(msg, &error,
+                               DBUS_TYPE_STRING, &subsystem,
+                               DBUS_TYPE_STRING, &level,
+                               DBUS_TYPE_INVALID)) {
+        DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        if (!reply) {
+            return DBUS_HANDLER_RESULT_NEED_MEMORY;
+        }
+        dbus_connection_send(server->dbus_conn, reply, NULL);
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    dbus_bool_t success = fde_log_set_level(subsystem, level);
+    if (success) {
+        fde_log(FDE_INFO, "Log level of %s set to %s", subsystem, level);
+    }
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+DBusHandlerResult handle_get_log_levels(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, dict;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{ss}", &dict)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    for (int i = 0; i < FDE_LOG_SUBSYSTEM_LAST; i++) {
+        const char *name = fde_log_subsystem_name(i);
+        const char *level = fde_log_importance_name(
+            atomic_load_explicit(&fde_log_levels[i], memory_order_relaxed));
+        DBusMessageIter entry;
+        dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &level);
+        dbus_message_iter_close_container(&dict, &entry);
+    }
+    dbus_message_iter_close_container(&iter, &dict);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+// Трассировка: SetTracing(true) начинает новую запись и возвращает её каталог, SetTracing(false) - ""
+DBusHandlerResult handle_set_tracing(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
+
+    dbus_bool_t enable = FALSE;
+    if (!dbus_message_get_args(msg, &error, DBUS_TYPE_BOOLEAN, &enable, DBUS_TYPE_INVALID)) {
+        DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        if (!reply) {
+            return DBUS_HANDLER_RESULT_NEED_MEMORY;
+        }
+        dbus_connection_send(server->dbus_conn, reply, NULL);
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    const char *dir = "";
+    if (enable) {
+        dir = fde_trace_start();
+        if (!dir) {
+            DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_FAILED, "Failed to start tracing");
+            if (!reply) {
+                return DBUS_HANDLER_RESULT_NEED_MEMORY;
+            }
+            dbus_connection_send(server->dbus_conn, reply, NULL);
+            dbus_message_unref(reply);
+            return DBUS_HANDLER_RESULT_HANDLED;
+        }
+    } else {
+        fde_trace_stop();
+    }
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_STRING, &dir, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void append_log_site(const fde_log_site_t *site, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_int32_t line = site->line;
+    dbus_uint64_t suppressed = site->suppressed_total;
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &site->file);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT32, &line);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &site->format);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &suppressed);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// (t ring_dropped, a(sist) sites): сообщения, потерянные из-за полного кольца, и подавленные по месту вызова
+DBusHandlerResult handle_get_log_drop_counters(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_uint64_t ring_dropped = fde_log_dropped();
+    dbus_message_iter_init_append(reply, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &ring_dropped);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sist)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    fde_log_for_each_site(append_log_site, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void append_startup_phase(const char *phase, uint64_t duration_usec, uint64_t end_usec, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_uint64_t duration = duration_usec, end = end_usec;
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &phase);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &duration);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &end);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// a(stt): фаза, длительность и момент окончания от старта процесса (мкс)
+DBusHandlerResult handle_get_startup_report(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(stt)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    fde_startup_for_each_phase(append_startup_phase, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void append_autostart_command(const char *command, const char *group, pid_t pid,
+        autostart_state_t state, int64_t ready_usec, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_int32_t pid32 = pid;
+    const char *state_name = autostart_state_name(state);
+    dbus_int64_t ready = ready_usec;
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &command);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &group);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT32, &pid32);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &state_name);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT64, &ready);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// a(ssisx): команда, группа, PID, состояние и время от запуска до первого кадра (мкс, -1 если кадра не было)
+DBusHandlerResult handle_get_autostart_report(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(ssisx)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    autostart_for_each(append_autostart_command, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+// (s workspace, s output) -> b. Пустой output: тот, где workspace уже есть, иначе первый
+DBusHandlerResult handle_switch_workspace(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
+
+    const char *name = NULL;
+    const char *output_name = NULL;
+    if (!dbus_message_get_args(msg, &error,
+                               DBUS_TYPE_STRING, &name,
+                               DBUS_TYPE_STRING, &output_name,
+                               DBUS_TYPE_INVALID)) {
+        DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        if (!reply) {
+            return DBUS_HANDLER_RESULT_NEED_MEMORY;
+        }
+        dbus_connection_send(server->dbus_conn, reply, NULL);
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    workspace_t *ws = workspace_find_by_name(server, name);
+    fde_output_t *output = NULL;
+    if (output_name[0]) {
+        fde_output_t *it;
+        wl_list_for_each(it, &server->outputs, link) {
+            if (strcmp(it->wlr_output->name, output_name) == 0) {
+                output = it;
+                break;
+            }
+        }
+    } else if (ws && ws->output) {
+        output = ws->output;
+    } else if (!wl_list_empty(&server->outputs)) {
+        output = wl_container_of(server->outputs.next, output, link);
+    }
+
+    dbus_bool_t success = ws && output && workspace_switch(output, ws);
+    if (!success) {
+        fde_log(FDE_ERROR, "Cannot switch to workspace '%s' on output '%s'", name, output_name);
+    }
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void append_pool_stats(const fde_pool_t *pool, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_uint32_t stride = pool->stride;
+    dbus_uint64_t live = pool->live, peak = pool->peak, allocs = pool->allocs, frees = pool->frees;
+    dbus_uint64_t reserved = fde_pool_reserved_bytes(pool);
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &pool->name);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &stride);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &live);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &peak);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &allocs);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &frees);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &reserved);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// a(suttttt): тип, размер объекта с выравниванием, живые, пик, всего выделено/освобождено, байт в слэбах
+DBusHandlerResult handle_get_pool_stats(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(suttttt)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    fde_pool_for_each(append_pool_stats, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void append_capture_stats(pid_t pid, const char *output, const capture_stats_t *stats, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_int32_t client_pid = pid;
+    dbus_uint64_t frames = stats->frames, bytes = stats->bytes, full_bytes = stats->full_bytes;
+    dbus_uint64_t throttled = stats->throttled, failed = stats->failed;
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT32, &client_pid);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &output);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &frames);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &bytes);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &full_bytes);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &throttled);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &failed);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// a(isttttt): pid клиента, output, кадры, скопировано байт, байт при полных кадрах, отложено max_fps, ошибки
+DBusHandlerResult handle_get_capture_stats(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(isttttt)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    capture_for_each(append_capture_stats, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+// a(stttttu): output, показано кадров, отброшено, пропущено vblank, средняя/максимальная задержка
+// commit -> present в нс, refresh в нс (0 = неизвестен)
+DBusHandlerResult handle_get_output_stats(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(stttttu)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    fde_output_t *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        const output_present_stats_t *stats = &output->present_stats;
+        const char *name = output->wlr_output->name;
+        dbus_uint64_t presented = stats->presented, discarded = stats->discarded, missed = stats->missed_vblanks;
+        dbus_uint64_t avg = stats->presented ? stats->latency_sum_ns / stats->presented : 0, max = stats->latency_max_ns;
+        dbus_uint32_t refresh = stats->refresh_ns;
+        DBusMessageIter entry;
+        dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &presented);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &discarded);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &missed);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &avg);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &max);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &refresh);
+        dbus_message_iter_close_container(&array, &entry);
+    }
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+// a(sta{st}): output, кадры fullscreen со scanout напрямую, причины композиции -> число кадров
+DBusHandlerResult handle_get_scanout_stats(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sta{st})", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    fde_output_t *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        const output_scanout_stats_t *stats = &output->scanout_stats;
+        const char *name = output->wlr_output->name;
+        dbus_uint64_t direct = stats->direct;
+        DBusMessageIter entry, reasons;
+        dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &direct);
+        dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY, "{st}", &reasons);
+        for (int i = 0; i < SCANOUT_FALLBACK_COUNT; i++) {
+            const char *reason = scanout_fallback_name(i);
+            dbus_uint64_t count = stats->fallback[i];
+            DBusMessageIter pair;
+            dbus_message_iter_open_container(&reasons, DBUS_TYPE_DICT_ENTRY, NULL, &pair);
+            dbus_message_iter_append_basic(&pair, DBUS_TYPE_STRING, &reason);
+            dbus_message_iter_append_basic(&pair, DBUS_TYPE_UINT64, &count);
+            dbus_message_iter_close_container(&reasons, &pair);
+        }
+        dbus_message_iter_close_container(&entry, &reasons);
+        dbus_message_iter_close_container(&array, &entry);
+    }
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
@@ -1,7 +1,10 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_DBUS
+
 #include <fde/dbus.h>
 #include <fde/comp/compositor.h>
 #include <fde/plugin-system.h>
 #include <fde/utils/log.h> 
+#include <fde/utils/trace.h>
 #include <dbus/dbus.h>
 #include <wayland-util.h>
 #include <signal.h> 
@@ -42,6 +45,22 @@ DBusHandlerResult dbus_message_filter(DBusConnection *conn, DBusMessage *msg, vo
         return DBUS_HANDLER_RESULT_NEED_MEMORY;
     }
 
+    // Плагин отключился от шины без UnregisterPlugin
+    if (dbus_message_is_signal(msg, DBUS_INTERFACE_DBUS, "NameOwnerChanged")) {
+        const char *name = NULL, *old_owner = NULL, *new_owner = NULL;
+        if (dbus_message_get_args(msg, NULL,
+                                  DBUS_TYPE_STRING, &name,
+                                  DBUS_TYPE_STRING, &old_owner,
+                                  DBUS_TYPE_STRING, &new_owner,
+                                  DBUS_TYPE_INVALID) && *new_owner == '\0') {
+            plugin_instance_t *plugin = plugin_list_find_by_bus_name(server, name);
+            if (plugin) {
+                plugin_unregister(server, plugin, "disconnected from bus");
+            }
+        }
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
     // Проверяем, что это method_call
     if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL) {
         return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;  // Игнорируем signals, replies, errors
@@ -66,6 +85,13 @@ DBusHandlerResult dbus_message_filter(DBusConnection *conn, DBusMessage *msg, vo
     // Ищем обработчик через find_handler
     method_handler_t handler = find_handler(interface, method);
     if (handler) {
+        // Отдельный участок трассы на каждый метод: "dbus.<interface>.<method>"
+        fde_trace_site_t *trace __attribute__((cleanup(fde_trace_scope_end))) = NULL;
+        if (fde_trace_active()) {
+            char site_name[256];
+            snprintf(site_name, sizeof(site_name), "dbus.%s.%s", interface, method);
+            trace = fde_trace_scope_begin(fde_trace_site(site_name));
+        }
         DBusHandlerResult result = handler(server, msg);
         dbus_connection_flush(conn);  // Отправляем ответ сразу
         return result;
@@ -82,50 +108,83 @@ static void dbus_free_server_data(void *data) {
     (void)data;  // No-op
     fde_log(FDE_DEBUG, "Free server dbus data (no-op)");
 }
-bool init_dbus(compositor_t *server) {
-    if (!server) return false;
-
-    wl_list_init(&server->plugins);
+DBusConnection *dbus_connect(const char *service_name) {
+    dbus_threads_init_default();
 
     DBusError error;
     dbus_error_init(&error);
 
     // Подключение к сессионному bus (Wayland)
-    server->dbus_conn = dbus_bus_get(DBUS_BUS_SESSION, &error);
+    DBusConnection *conn = dbus_bus_get(DBUS_BUS_SESSION, &error);
     if (dbus_error_is_set(&error)) {
         fde_log(FDE_ERROR, "D-Bus connection failed: %s", error.message);
         dbus_error_free(&error);
-        return false;
+        return NULL;
     }
-    if (server->dbus_conn == NULL) {
+    if (conn == NULL) {
         fde_log(FDE_ERROR, "D-Bus connection is NULL");
-        return false;
+        return NULL;
     }
 
     const char *match_rule = "type='method_call',interface='org.fde.Compositor.Core'";
-    dbus_bus_add_match(server->dbus_conn, match_rule, &error);
-    dbus_connection_flush(server->dbus_conn);
+    dbus_bus_add_match(conn, match_rule, &error);
+    if (!dbus_error_is_set(&error)) {
+        // Registered plugins dropping off the bus (looked up by unique name in the registry)
+        dbus_bus_add_match(conn,
+            "type='signal',sender='org.freedesktop.DBus',interface='org.freedesktop.DBus',"
+            "member='NameOwnerChanged'", &error);
+    }
+    dbus_connection_flush(conn);
     if (dbus_error_is_set(&error)) {
         fde_log(FDE_ERROR, "Failed to add match rule: %s", error.message);
         dbus_error_free(&error);
-        return false;
+        dbus_connection_unref(conn);
+        return NULL;
     }
 
     // Запрос уникального имени сервиса
-    server->dbus_service_name = strdup("org.fde.Compositor");
     int request_result = dbus_bus_request_name(
-        server->dbus_conn, server->dbus_service_name,
+        conn, service_name,
         DBUS_NAME_FLAG_DO_NOT_QUEUE | DBUS_NAME_FLAG_REPLACE_EXISTING,
         &error
     );
     if (request_result != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
-        fde_log(FDE_ERROR, "Failed to acquire D-Bus name '%s': %s (code %d)", server->dbus_service_name, error.message, request_result);
+        fde_log(FDE_ERROR, "Failed to acquire D-Bus name '%s': %s (code %d)", service_name, error.message, request_result);
         dbus_error_free(&error);
-        return false;
+        dbus_connection_unref(conn);
+        return NULL;
     }
 
+    dbus_error_free(&error);
+    return conn;
+}
+
+static void dbus_drain_queue(void *data) {
+    compositor_t *server = data;
+    server->dbus_dispatch_idle = NULL;
+    if (!server->dbus_conn) return;
+    while (dbus_connection_dispatch(server->dbus_conn) == DBUS_DISPATCH_DATA_REMAINS) {
+    }
+}
+
+// Блокирующий вызов (plugin_call) читает из сокета и чужие сообщения: они лежат в очереди, а fd уже
+// не сработает. libdbus сообщает об этом здесь; dispatch отсюда вызывать нельзя, поэтому через idle
+static void dbus_dispatch_status_changed(DBusConnection *conn, DBusDispatchStatus status, void *data) {
+    compositor_t *server = data;
+    if (status == DBUS_DISPATCH_DATA_REMAINS && !server->dbus_dispatch_idle) {
+        server->dbus_dispatch_idle = wl_event_loop_add_idle(server->wl_event_loop, dbus_drain_queue, server);
+    }
+}
+
+bool dbus_attach(compositor_t *server, DBusConnection *conn) {
+    if (!server || !conn) return false;
+
+    server->dbus_conn = conn;
+    server->dbus_service_name = strdup(FDE_DBUS_SERVICE_NAME);
+
     // Добавление фильтра для входящих сообщений
     dbus_connection_add_filter(server->dbus_conn, dbus_message_filter, server, dbus_free_server_data);
+    dbus_connection_set_dispatch_status_function(server->dbus_conn, dbus_dispatch_status_changed, server, NULL);
     dbus_connection_flush(server->dbus_conn);  // Flush: Активируем filter
 
     // Initial dispatch: Process any queued (helps if early messages)
@@ -133,27 +192,48 @@ bool init_dbus(compositor_t *server) {
     while (dbus_connection_dispatch(server->dbus_conn) == DBUS_DISPATCH_DATA_REMAINS) {
         // Process all pending
     }
-    
+
+    int dbus_fd = -1;
+    dbus_bool_t fd_result = dbus_connection_get_unix_fd(server->dbus_conn, &dbus_fd);
+    if (!fd_result || dbus_fd < 0) {
+        fde_log(FDE_ERROR, "Failed to get D-Bus fd: result=%d, fd=%d", fd_result, dbus_fd);
+        return false;
+    }
+    fde_log(FDE_DEBUG, "D-Bus fd obtained: %d", dbus_fd);
+
+    // Добавление fd в Wayland event loop (full mask)
+    server->dbus_source = wl_event_loop_add_fd(
+        server->wl_event_loop,
+        dbus_fd,
+        WL_EVENT_READABLE | WL_EVENT_WRITABLE | WL_EVENT_HANGUP | WL_EVENT_ERROR,
+        dbus_fd_handler,
+        server
+    );
+    if (!server->dbus_source) {
+        fde_log(FDE_ERROR, "Failed to add D-Bus fd (%d) to event loop", dbus_fd);
+        return false;
+    }
+    fde_log(FDE_DEBUG, "D-Bus fd (%d) added to Wayland event loop", dbus_fd);
+
     fde_log(FDE_INFO, "D-Bus initialized: service '%s' on session bus", server->dbus_service_name);
-    dbus_error_free(&error);
     return true;
 }
+
+bool init_dbus(compositor_t *server) {
+    if (!server) return false;
+    DBusConnection *conn = dbus_connect(FDE_DBUS_SERVICE_NAME);
+    return conn && dbus_attach(server, conn);
+}
 void cleanup_dbus(compositor_t *server) {
     if (!server) return;
     // Удаление фильтра
-    dbus_connection_remove_filter(server->dbus_conn, dbus_message_filter, server);
-    // Убить плагины (безопасная итерация wl_list)
-    plugin_instance_t *p, *tmp;
-    wl_list_for_each_safe(p, tmp, &server->plugins, link) {
-        if (p->pid > 0) {
-            kill(p->pid, SIGTERM);
-            fde_log(FDE_INFO, "Terminated plugin %s (PID %d)", p->name ?: "unknown", p->pid);
-        }
-        wl_list_remove(&p->link);
-        free(p->name);
-        free(p->dbus_path);
-        free(p);
+    if (server->dbus_conn) {
+        dbus_connection_remove_filter(server->dbus_conn, dbus_message_filter, server);
+        dbus_connection_set_dispatch_status_function(server->dbus_conn, NULL, NULL, NULL);
     }
+    DESTROY_AND_NULL(server->dbus_dispatch_idle, wl_event_source_remove);
+    // Убить плагины
+    plugin_system_finish(server);
     // Закрытие соединения
     if (server->dbus_conn) {
         dbus_connection_flush(server->dbus_conn);
@@ -164,12 +244,13 @@ void cleanup_dbus(compositor_t *server) {
     server->dbus_service_name = NULL;
     fde_log(FDE_INFO, "D-Bus cleaned up");
 }
-void send_dbus_signal(compositor_t *server, const char *interface, const char *signal_name, ...) {
+static void send_dbus_signal_va(compositor_t *server, const char *destination, const char *interface, const char *signal_name, va_list args) {
     if (!server || !server->dbus_conn) return;
     DBusMessage *signal_msg = dbus_message_new_signal("/org/fde/Compositor", interface, signal_name);
     if (!signal_msg) return;
-    va_list args;
-    va_start(args, signal_name);
+    if (destination) {
+        dbus_message_set_destination(signal_msg, destination);
+    }
     DBusMessageIter iter;
     dbus_message_iter_init_append(signal_msg, &iter);
     int arg_type;
@@ -190,18 +271,119 @@ void send_dbus_signal(compositor_t *server, const char *interface, const char *s
                 dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &val);
                 break;
             }
+            case DBUS_TYPE_ARRAY: {
+                // DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, const char **items, int count
+                int element_type = va_arg(args, int);
+                const char **items = va_arg(args, const char **);
+                int count = va_arg(args, int);
+                if (element_type != DBUS_TYPE_STRING) {
+                    fde_log(FDE_INFO, "Unsupported array element type %d", element_type);
+                    break;
+                }
+                DBusMessageIter array;
+                dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &array);
+                for (int i = 0; i < count; i++) {
+                    dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &items[i]);
+                }
+                dbus_message_iter_close_container(&iter, &array);
+                break;
+            }
             default:
                 fde_log(FDE_INFO, "Unsupported arg type %d", arg_type);
                 break;
         }
     }
-    va_end(args);
     dbus_connection_send(server->dbus_conn, signal_msg, NULL);
     dbus_connection_flush(server->dbus_conn);
     dbus_message_unref(signal_msg);
-    fde_log(FDE_DEBUG, "Sent signal %s.%s", interface, signal_name);
+    fde_log(FDE_DEBUG, "Sent signal %s.%s to %s", interface, signal_name, destination ?: "all");
+}
+void send_dbus_signal(compositor_t *server, const char *interface, const char *signal_name, ...) {
+    va_list args;
+    va_start(args, signal_name);
+    send_dbus_signal_va(server, NULL, interface, signal_name, args);
+    va_end(args);
+}
+void send_plugin_signal(compositor_t *server, const char *plugin_name, const char *interface, const char *signal_name, ...) {
+    plugin_instance_t *plugin = plugin_list_find_by_name(server, plugin_name);
+    if (!plugin || !plugin->bus_name) {
+        fde_log(FDE_DEBUG, "Signal %s.%s dropped: plugin %s is not registered", interface, signal_name, plugin_name);
+        return;
+    }
+    va_list args;
+    va_start(args, signal_name);
+    send_dbus_signal_va(server, plugin->bus_name, interface, signal_name, args);
+    va_end(args);
+}
+typedef struct pid_query {
+    compositor_t *server;
+    char *bus_name;
+    dbus_pid_reply_t done;
+    void *data;
+    DBusFreeFunction free_data;
+} pid_query_t;
+
+static void pid_query_free(void *user_data) {
+    pid_query_t *query = user_data;
+    if (query->free_data) query->free_data(query->data);
+    free(query->bus_name);
+    free(query);
+}
+
+static void pid_query_notify(DBusPendingCall *pending, void *user_data) {
+    pid_query_t *query = user_data;
+    DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+    DBusError error;
+    dbus_error_init(&error);
+    dbus_uint32_t pid_val = 0;
+    bool ok = reply && !dbus_set_error_from_message(&error, reply) &&
+        dbus_message_get_args(reply, &error, DBUS_TYPE_UINT32, &pid_val, DBUS_TYPE_INVALID);
+    if (!ok) {
+        fde_log(FDE_ERROR, "GetConnectionUnixProcessID(%s) failed: %s", query->bus_name, error.message ?: "no reply");
+    }
+    if (reply) dbus_message_unref(reply);
+    dbus_error_free(&error);
+
+    query->done(query->server, ok ? (pid_t)pid_val : 0, query->data);
+}
+
+bool dbus_get_connection_pid(compositor_t *server, const char *bus_name, dbus_pid_reply_t done, void *data,
+        DBusFreeFunction free_data) {
+    if (!server->dbus_conn || !bus_name) return false;
+
+    pid_query_t *query = calloc(1, sizeof(pid_query_t));
+    if (!query || !(query->bus_name = strdup(bus_name))) {
+        free(query);
+        return false;
+    }
+    query->server = server;
+    query->done = done;
+
+    DBusMessage *call = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+        "GetConnectionUnixProcessID");
+    DBusPendingCall *pending = NULL;
+    bool sent = call && dbus_message_append_args(call, DBUS_TYPE_STRING, &bus_name, DBUS_TYPE_INVALID) &&
+        dbus_connection_send_with_reply(server->dbus_conn, call, &pending, DBUS_PID_QUERY_TIMEOUT_MS) && pending;
+    if (call) dbus_message_unref(call);
+    if (!sent || !dbus_pending_call_set_notify(pending, pid_query_notify, query, pid_query_free)) {
+        if (pending) {
+            dbus_pending_call_cancel(pending);
+            dbus_pending_call_unref(pending);
+        }
+        pid_query_free(query);
+        return false;
+    }
+    // Владение data переходит к запросу только после успешной установки notify
+    query->data = data;
+    query->free_data = free_data;
+    // Ссылку держит соединение до ответа
+    dbus_pending_call_unref(pending);
+    dbus_connection_flush(server->dbus_conn);
+    return true;
 }
 int dbus_fd_handler(int fd, uint32_t mask, void *data) {
+    FDE_TRACE_SCOPE("dbus.fd_handler");
     compositor_t *server = (compositor_t *)data;
     if (!server || !server->dbus_conn) {
         fde_log(FDE_DEBUG, "D-Bus handler: invalid server or conn (fd=%d)", fd);
@@ -1,21 +1,144 @@
+#define FDE_LOG_SUBSYSTEM FDE_LOG_DBUS
+
 #include <stdlib.h>
+#include <string.h>
 
 #include <fde/dbus.h>
 #include <fde/utils/log.h>
 #include <fde/comp/compositor.h>
 #include <fde/plugin-system.h>
+#include <fde/plugin-watchdog.h>
 
 #define PLUGINS_INTERFACE "org.fde.Compositor.Plugins"
 
 static method_entry_t plugins_entries[] = {
     { "org.fde.Compositor.Plugins", "RegisterPlugin", handle_register_plugin },
-    // { "org.fde.Compositor.Plugins", "UnregisterPlugin", handle_unregister_plugin },
+    { "org.fde.Compositor.Plugins", "UnregisterPlugin", handle_unregister_plugin },
+    { "org.fde.Compositor.Plugins", "GetPluginResources", handle_get_plugin_resources },
+    { "org.fde.Compositor.Plugins", "GetPluginStatus", handle_get_plugin_status },
+    { "org.fde.Compositor.Plugins", "GetCallLatency", handle_get_call_latency },
+    { NULL, NULL, NULL },
 };
 
 method_entry_t *get_plugins_method_entries() {
     return plugins_entries;
 }
 
+static DBusHandlerResult reply_error(compositor_t *server, DBusMessage *msg, const char *name, const char *text) {
+    DBusMessage *reply = dbus_message_new_error(msg, name, text);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void set_handler_type(plugin_instance_t *plugin, const char *handler_type) {
+    if (strcmp(handler_type, "input") == 0) plugin->supports_input = true;
+    else if (strcmp(handler_type, "rendering") == 0) plugin->supports_rendering = true;
+    else if (strcmp(handler_type, "protocols") == 0) plugin->supports_protocols = true;
+    else fde_log(FDE_INFO, "Unknown handler_type '%s' for %s", handler_type, plugin->name);
+}
+
+// RegisterPlugin waits for the bus to report the sender's PID; the call stays referenced until then
+typedef struct register_request {
+    DBusMessage *msg;
+    const char *plugin_name;   // Point into msg
+    const char *handler_type;
+    dbus_int32_t pid_arg;
+} register_request_t;
+
+static void register_request_free(void *data) {
+    register_request_t *request = data;
+    dbus_message_unref(request->msg);
+    free(request);
+}
+
+static void finish_register_plugin(compositor_t *server, pid_t sender_pid, void *data) {
+    register_request_t *request = data;
+    DBusMessage *msg = request->msg;
+    const char *plugin_name = request->plugin_name;
+    const char *handler_type = request->handler_type;
+    dbus_int32_t pid_arg = request->pid_arg;
+    const char *sender = dbus_message_get_sender(msg);
+
+    if (sender_pid == 0) {
+        reply_error(server, msg, DBUS_ERROR_ACCESS_DENIED, "Cannot verify sender pid");
+        return;
+    }
+    if (pid_arg != 0 && (pid_t)pid_arg != sender_pid) {
+        fde_log(FDE_ERROR, "RegisterPlugin %s: claimed PID %d, sender %s is PID %d", plugin_name, pid_arg, sender, sender_pid);
+        reply_error(server, msg, DBUS_ERROR_ACCESS_DENIED, "pid does not match the calling connection");
+        return;
+    }
+
+    // Запущенный нами плагин находится по pid, повторная регистрация - по bus name
+    plugin_instance_t *plugin = plugin_list_find_by_pid(server, sender_pid);
+    if (!plugin) {
+        plugin = plugin_list_find_by_bus_name(server, sender);
+    }
+    plugin_instance_t *same_name = plugin_list_find_by_name(server, plugin_name);
+    if (same_name && same_name != plugin) {
+        reply_error(server, msg, DBUS_ERROR_ACCESS_DENIED, "Plugin name is already registered");
+        return;
+    }
+
+    bool is_new = plugin == NULL;
+    if (is_new) {
+        plugin = plugin_instance_create();
+        if (!plugin) {
+            reply_error(server, msg, DBUS_ERROR_NO_MEMORY, "Out of memory");
+            return;
+        }
+        plugin_resources_defaults(&plugin->resources);
+        wl_list_init(&plugin->link);
+    } else {
+        plugin_list_remove(server, plugin);
+    }
+
+    free(plugin->bus_name);
+    plugin->name = fde_intern(plugin_name);
+    plugin->bus_name = strdup(sender);
+    plugin->pid = sender_pid;
+    free(plugin->dbus_path);
+    plugin->dbus_path = malloc(64);
+    if (plugin->dbus_path) {
+        snprintf(plugin->dbus_path, 64, "/org/fde/plugin/%s", plugin_name);
+    } else {
+        fde_log(FDE_ERROR, "Failed to allocate dbus_path for plugin %s", plugin_name);
+    }
+    if (!plugin->name || !plugin->bus_name) {
+        plugin_instance_destroy(plugin);
+        reply_error(server, msg, DBUS_ERROR_NO_MEMORY, "Out of memory");
+        return;
+    }
+    set_handler_type(plugin, handler_type);
+    plugin_list_add(server, plugin);
+
+    fde_log(FDE_INFO, "%s plugin %s (%s, PID %d, %s)", is_new ? "Registered new" : "Updated existing",
+        plugin_name, handler_type, plugin->pid, plugin->bus_name);
+
+    // Отправляем ответ с успехом
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    dbus_bool_t success = TRUE;
+    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+
+    // Отправляем сигнал о регистрации плагина
+    dbus_int32_t pid_val = plugin->pid;
+    send_dbus_signal(
+        server,
+        "org.fde.Compositor.Core",
+        "PluginRegistered",
+        DBUS_TYPE_STRING, plugin_name,
+        DBUS_TYPE_STRING, handler_type,
+        DBUS_TYPE_INT32, pid_val,
+        DBUS_TYPE_INVALID
+    );
+}
+
 // Handlers
 DBusHandlerResult handle_register_plugin(compositor_t *server, DBusMessage *msg) {
     DBusError error;
@@ -33,6 +156,64 @@ DBusHandlerResult handle_register_plugin(compositor_t *server, DBusMessage *msg)
                                DBUS_TYPE_INT32, &pid_arg,
                                DBUS_TYPE_INVALID)) {
         fde_log(FDE_ERROR, "Invalid args in RegisterPlugin: %s", error.message);
+        DBusHandlerResult result = reply_error(server, msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        return result;
+    }
+    dbus_error_free(&error);
+
+    // pid из аргументов не доверяем: сверяем с pid соединения по данным шины, ответ придет асинхронно
+    register_request_t *request = calloc(1, sizeof(register_request_t));
+    if (!request) {
+        return reply_error(server, msg, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    }
+    *request = (register_request_t){ dbus_message_ref(msg), plugin_name, handler_type, pid_arg };
+    if (!dbus_get_connection_pid(server, dbus_message_get_sender(msg), finish_register_plugin, request,
+            register_request_free)) {
+        register_request_free(request);
+        return reply_error(server, msg, DBUS_ERROR_ACCESS_DENIED, "Cannot verify sender pid");
+    }
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+DBusHandlerResult handle_unregister_plugin(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
+
+    const char *plugin_name = NULL;
+    if (!dbus_message_get_args(msg, &error, DBUS_TYPE_STRING, &plugin_name, DBUS_TYPE_INVALID)) {
+        DBusHandlerResult result = reply_error(server, msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        return result;
+    }
+    dbus_error_free(&error);
+
+    // Снять регистрацию может только соединение, которое её сделало
+    const char *sender = dbus_message_get_sender(msg);
+    plugin_instance_t *plugin = plugin_list_find_by_name(server, plugin_name);
+    dbus_bool_t success = plugin && plugin == plugin_list_find_by_bus_name(server, sender);
+    if (plugin && !success) {
+        return reply_error(server, msg, DBUS_ERROR_ACCESS_DENIED, "Plugin is registered by another connection");
+    }
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
+
+    if (success) {
+        plugin_unregister(server, plugin, "UnregisterPlugin");
+    }
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+DBusHandlerResult handle_get_plugin_resources(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
+
+    const char *plugin_name = NULL;
+    if (!dbus_message_get_args(msg, &error, DBUS_TYPE_STRING, &plugin_name, DBUS_TYPE_INVALID)) {
         DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, error.message);
         dbus_connection_send(server->dbus_conn, reply, NULL);
         dbus_message_unref(reply);
@@ -40,71 +221,101 @@ DBusHandlerResult handle_register_plugin(compositor_t *server, DBusMessage *msg)
         return DBUS_HANDLER_RESULT_HANDLED;
     }
 
-    plugin_instance_t *existing = plugin_list_find_by_name(server, plugin_name);
-    if (existing) {
-        // Обновляем существующий (временный) плагин
-        free(existing->dbus_path);
-        existing->dbus_path = malloc(64);
-        if (existing->dbus_path) {
-            snprintf(existing->dbus_path, 64, "/org/fde/plugin/%s", plugin_name);
-        } else {
-            fde_log(FDE_ERROR, "Failed to allocate dbus_path for plugin %s", plugin_name);
-        }
-        existing->pid = (pid_t)pid_arg;
-
-        if (strcmp(handler_type, "input") == 0) existing->supports_input = true;
-        else if (strcmp(handler_type, "rendering") == 0) existing->supports_rendering = true;
-        else if (strcmp(handler_type, "protocols") == 0) existing->supports_protocols = true;
-        else fde_log(FDE_INFO, "Unknown handler_type '%s' for %s", handler_type, plugin_name);
+    plugin_instance_t *plugin = plugin_list_find_by_name(server, plugin_name);
+    plugin_usage_t usage;
+    if (!plugin || !plugin_resources_get_usage(&plugin->resources, plugin->pid, &usage)) {
+        DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "Unknown plugin or usage unavailable");
+        dbus_connection_send(server->dbus_conn, reply, NULL);
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
 
-        fde_log(FDE_INFO, "Updated existing plugin %s (%s, PID %d)", plugin_name, handler_type, existing->pid);
-    } else {
-        // Создаём новый плагин, если не найден
-        plugin_instance_t *new_plugin = calloc(1, sizeof(plugin_instance_t));
-        if (!new_plugin) {
-            DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_NO_MEMORY, "Out of memory");
-            dbus_connection_send(server->dbus_conn, reply, NULL);
-            dbus_message_unref(reply);
-            return DBUS_HANDLER_RESULT_HANDLED;
-        }
-        new_plugin->pid = (pid_t)pid_arg;
-        new_plugin->name = strdup(plugin_name);
-        new_plugin->dbus_path = malloc(64);
-        if (new_plugin->dbus_path) {
-            snprintf(new_plugin->dbus_path, 64, "/org/fde/plugin/%s", plugin_name);
-        } else {
-            fde_log(FDE_ERROR, "Failed to allocate dbus_path for new plugin %s", plugin_name);
-        }
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_uint64_t cpu_usec = usage.cpu_usec;
+    dbus_uint64_t memory_current = usage.memory_bytes;
+    dbus_uint64_t memory_max = plugin->resources.memory_max;
+    dbus_int32_t cpu_weight = plugin->resources.cpu_weight;
+    dbus_bool_t in_cgroup = plugin->resources.cgroup_path != NULL;
+    dbus_message_append_args(reply,
+                             DBUS_TYPE_UINT64, &cpu_usec,
+                             DBUS_TYPE_UINT64, &memory_current,
+                             DBUS_TYPE_UINT64, &memory_max,
+                             DBUS_TYPE_INT32, &cpu_weight,
+                             DBUS_TYPE_BOOLEAN, &in_cgroup,
+                             DBUS_TYPE_INVALID);
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
 
-        fde_log(FDE_INFO, "Allocated dbus_path: %s \nfor plugin: %s,", new_plugin->dbus_path, plugin_name);
+    dbus_error_free(&error);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+DBusHandlerResult handle_get_plugin_status(compositor_t *server, DBusMessage *msg) {
+    DBusError error;
+    dbus_error_init(&error);
 
-        if (strcmp(handler_type, "input") == 0) new_plugin->supports_input = true;
-        else if (strcmp(handler_type, "rendering") == 0) new_plugin->supports_rendering = true;
-        else if (strcmp(handler_type, "protocols") == 0) new_plugin->supports_protocols = true;
-        else fde_log(FDE_INFO, "Unknown handler_type '%s' for %s", handler_type, plugin_name);
+    const char *plugin_name = NULL;
+    if (!dbus_message_get_args(msg, &error, DBUS_TYPE_STRING, &plugin_name, DBUS_TYPE_INVALID)) {
+        DBusHandlerResult result = reply_error(server, msg, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+        return result;
+    }
+    dbus_error_free(&error);
 
-        plugin_list_add(server, new_plugin);
-        fde_log(FDE_INFO, "Registered new plugin %s (%s, PID %d)", plugin_name, handler_type, new_plugin->pid);
+    plugin_instance_t *plugin = plugin_list_find_by_name(server, plugin_name);
+    if (!plugin) {
+        return reply_error(server, msg, DBUS_ERROR_INVALID_ARGS, "Unknown plugin");
     }
 
-    // Отправляем ответ с успехом
     DBusMessage *reply = dbus_message_new_method_return(msg);
-    dbus_bool_t success = TRUE;
-    dbus_message_append_args(reply, DBUS_TYPE_BOOLEAN, &success, DBUS_TYPE_INVALID);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    dbus_uint32_t violations = plugin->budget_violations;
+    dbus_bool_t demoted = plugin->demoted;
+    dbus_message_append_args(reply,
+                             DBUS_TYPE_UINT32, &violations,
+                             DBUS_TYPE_BOOLEAN, &demoted,
+                             DBUS_TYPE_INVALID);
     dbus_connection_send(server->dbus_conn, reply, NULL);
     dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
 
-    // Отправляем сигнал о регистрации плагина
-    send_dbus_signal(
-        server,
-        "org.fde.Compositor.Core",
-        "PluginRegistered",
-        DBUS_TYPE_STRING, plugin_name,
-        DBUS_TYPE_STRING, handler_type,
-        DBUS_TYPE_INT32, pid_arg,
-        DBUS_TYPE_INVALID
-    );
+static void append_latency_report(const plugin_latency_report_t *report, void *data) {
+    DBusMessageIter *array = data;
+    DBusMessageIter entry;
+    dbus_uint64_t calls = report->calls, timeouts = report->timeouts;
+    dbus_uint64_t p50 = report->p50_usec, p99 = report->p99_usec;
 
-    dbus_error_free(&error);
+    dbus_message_iter_open_container(array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &report->method);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &calls);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &timeouts);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &p50);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &p99);
+    dbus_message_iter_close_container(array, &entry);
+}
+
+// a(stttt): method, calls, timeouts, p50 and p99 response time in microseconds
+DBusHandlerResult handle_get_call_latency(compositor_t *server, DBusMessage *msg) {
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(stttt)", &array)) {
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+    plugin_watchdog_for_each_method(append_latency_report, &array);
+    dbus_message_iter_close_container(&iter, &array);
+
+    dbus_connection_send(server->dbus_conn, reply, NULL);
+    dbus_message_unref(reply);
     return DBUS_HANDLER_RESULT_HANDLED;
-}
\ No newline at end of file
+}
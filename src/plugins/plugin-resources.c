@@ -0,0 +1,386 @@
+#define _DEFAULT_SOURCE
+#define FDE_LOG_SUBSYSTEM FDE_LOG_PLUGINS
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fde/config.h>
+#include <fde/plugin-resources.h>
+#include <fde/utils/log.h>
+
+#define CGROUP_MOUNT "/sys/fs/cgroup"
+
+static struct {
+    bool available;
+    char root[PATH_MAX];  // Delegated cgroup the compositor was started in
+} cgroups = {0};
+
+static bool write_file(const char *path, const char *value) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = (ssize_t)strlen(value);
+    bool ok = write(fd, value, len) == len;
+    close(fd);
+    return ok;
+}
+
+static ssize_t read_file(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static bool write_cgroup_file(const char *cgroup, const char *file, const char *value) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", cgroup, file);
+    if (!write_file(path, value)) {
+        fde_log(FDE_DEBUG, "Cannot write '%s' to %s: %s", value, path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool make_cgroup(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fde_log(FDE_DEBUG, "Cannot create cgroup %s: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// cgroup.controllers/cgroup.subtree_control are space separated controller names
+static bool has_controllers(const char *cgroup, const char *file) {
+    char path[PATH_MAX], buf[256];
+    snprintf(path, sizeof(path), "%s/%s", cgroup, file);
+    if (read_file(path, buf, sizeof(buf)) < 0) {
+        return false;
+    }
+    bool cpu = false, memory = false;
+    for (char *save, *tok = strtok_r(buf, " \n", &save); tok; tok = strtok_r(NULL, " \n", &save)) {
+        cpu |= strcmp(tok, "cpu") == 0;
+        memory |= strcmp(tok, "memory") == 0;
+    }
+    return cpu && memory;
+}
+
+// "0::/user.slice/..." is the only line on a pure cgroup v2 system
+static bool read_own_cgroup(char *out, size_t size) {
+    char buf[PATH_MAX + 64];
+    if (read_file("/proc/self/cgroup", buf, sizeof(buf)) < 0) {
+        return false;
+    }
+    char *line = strstr(buf, "0::");
+    if (!line) {
+        return false;
+    }
+    line += 3;
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(out, size, "%s%s", CGROUP_MOUNT, strcmp(line, "/") == 0 ? "" : line);
+    return true;
+}
+
+bool plugin_resources_init(int compositor_cpu_weight) {
+    cgroups.available = false;
+
+    if (!read_own_cgroup(cgroups.root, sizeof(cgroups.root))) {
+        fde_log(FDE_INFO, "cgroup v2 is not mounted, plugins will be limited with setrlimit");
+        return false;
+    }
+
+    // Restarted inside our own leaf: reuse the parent subtree
+    size_t root_len = strlen(cgroups.root);
+    const char leaf[] = "/compositor";
+    if (root_len > sizeof(leaf) - 1 && strcmp(cgroups.root + root_len - (sizeof(leaf) - 1), leaf) == 0) {
+        cgroups.root[root_len - (sizeof(leaf) - 1)] = '\0';
+    }
+
+    char compositor_cg[PATH_MAX], plugins_cg[PATH_MAX];
+    snprintf(compositor_cg, sizeof(compositor_cg), "%s/compositor", cgroups.root);
+    snprintf(plugins_cg, sizeof(plugins_cg), "%s/plugins", cgroups.root);
+
+    // cgroup v2 "no internal processes" rule: the compositor has to leave the root before controllers
+    // can be delegated to its children
+    if (!make_cgroup(compositor_cg) || !write_cgroup_file(compositor_cg, "cgroup.procs", "0") ||
+        !make_cgroup(plugins_cg)) {
+        fde_log(FDE_INFO, "cgroup %s is not delegated to us, plugins will be limited with setrlimit", cgroups.root);
+        return false;
+    }
+
+    // Запись может молча не сработать (контроллер не делегирован сверху), поэтому проверяем итог:
+    // plugins должен получить cpu+memory от root и раздать их своим детям
+    bool enabled = write_cgroup_file(cgroups.root, "cgroup.subtree_control", "+cpu +memory") &&
+        write_cgroup_file(plugins_cg, "cgroup.subtree_control", "+cpu +memory");
+    if (!enabled || !has_controllers(plugins_cg, "cgroup.controllers") ||
+        !has_controllers(plugins_cg, "cgroup.subtree_control")) {
+        fde_log(FDE_INFO, "cpu/memory controllers are not available in %s, plugins will be limited with setrlimit",
+            cgroups.root);
+        return false;
+    }
+
+    int weight = compositor_cpu_weight > 0 ? compositor_cpu_weight : COMPOSITOR_DEFAULT_CPU_WEIGHT;
+    char value[32];
+    snprintf(value, sizeof(value), "%d", weight);
+    write_cgroup_file(compositor_cg, "cpu.weight", value);
+    snprintf(value, sizeof(value), "%d", PLUGIN_DEFAULT_CPU_WEIGHT);
+    write_cgroup_file(plugins_cg, "cpu.weight", value);
+
+    cgroups.available = true;
+    fde_log(FDE_INFO, "Plugins are placed under cgroup %s (compositor cpu.weight %d)", plugins_cg, weight);
+    return true;
+}
+
+bool plugin_resources_cgroups_available(void) {
+    return cgroups.available;
+}
+
+void plugin_resources_defaults(plugin_resources_t *res) {
+    res->cpu_weight = PLUGIN_DEFAULT_CPU_WEIGHT;
+    res->memory_max = 0;
+    res->cgroup_path = NULL;
+}
+
+// Accepts plain bytes, K/M/G suffixes and "max"
+static bool parse_memory(const char *value, uint64_t *out) {
+    if (strcmp(value, "max") == 0) {
+        *out = 0;
+        return true;
+    }
+    char *end;
+    unsigned long long val = strtoull(value, &end, 10);
+    if (end == value) return false;
+    switch (toupper((unsigned char)*end)) {
+        case 'G': val <<= 10; /* fallthrough */
+        case 'M': val <<= 10; /* fallthrough */
+        case 'K': val <<= 10; end++; break;
+        case '\0': break;
+        default: return false;
+    }
+    if (*end != '\0') return false;
+    *out = val;
+    return true;
+}
+
+static char *trim_span(char *str) {
+    while (isspace((unsigned char)*str)) str++;
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return str;
+}
+
+bool plugin_resources_load_conf(plugin_resources_t *res, const char *conf_path) {
+    FILE *f = fopen(conf_path, "r");
+    if (!f) {
+        return false;
+    }
+
+    char line[256];
+    bool in_resources = false;
+    int line_num = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_num++;
+        char *l = trim_span(line);
+        if (*l == '\0' || *l == '#') continue;
+
+        if (*l == '[') {
+            in_resources = strcmp(l, "[resources]") == 0;
+            continue;
+        }
+        char *eq = strchr(l, '=');
+        if (!in_resources || !eq) continue;
+
+        *eq = '\0';
+        char *key = trim_span(l);
+        char *value = trim_span(eq + 1);
+
+        if (strcmp(key, "cpu_weight") == 0) {
+            char *end;
+            long weight = strtol(value, &end, 10);
+            if (*end != '\0' || weight < 1 || weight > 10000) {
+                fde_log(FDE_ERROR, "%s:%d: cpu_weight must be in 1..10000", conf_path, line_num);
+                continue;
+            }
+            res->cpu_weight = (int)weight;
+        } else if (strcmp(key, "memory_max") == 0) {
+            if (!parse_memory(value, &res->memory_max)) {
+                fde_log(FDE_ERROR, "%s:%d: invalid memory_max '%s'", conf_path, line_num, value);
+            }
+        } else {
+            fde_log(FDE_DEBUG, "%s:%d: unknown resources key '%s'", conf_path, line_num, key);
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+static bool write_limits(const char *cgroup, const plugin_resources_t *res) {
+    char value[32];
+    snprintf(value, sizeof(value), "%d", res->cpu_weight);
+    bool ok = write_cgroup_file(cgroup, "cpu.weight", value);
+    if (res->memory_max) {
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)res->memory_max);
+    } else {
+        snprintf(value, sizeof(value), "max");
+    }
+    return write_cgroup_file(cgroup, "memory.max", value) && ok;
+}
+
+bool plugin_resources_prepare(plugin_resources_t *res, const char *plugin_name) {
+    if (!cgroups.available) {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/plugins/%s", cgroups.root, plugin_name);
+    if (!make_cgroup(path)) {
+        return false;
+    }
+
+    write_limits(path, res);
+
+    free(res->cgroup_path);
+    res->cgroup_path = strdup(path);
+    return res->cgroup_path != NULL;
+}
+
+bool plugin_resources_equal(const plugin_resources_t *a, const plugin_resources_t *b) {
+    return a->cpu_weight == b->cpu_weight && a->memory_max == b->memory_max;
+}
+
+bool plugin_resources_update(plugin_resources_t *res, const plugin_resources_t *updated) {
+    res->cpu_weight = updated->cpu_weight;
+    res->memory_max = updated->memory_max;
+    // setrlimit/nice are fixed at exec time
+    return res->cgroup_path && write_limits(res->cgroup_path, res);
+}
+
+bool plugin_resources_set_compositor_weight(int weight) {
+    if (!cgroups.available) {
+        return false;
+    }
+    char path[PATH_MAX], value[32];
+    snprintf(path, sizeof(path), "%s/compositor", cgroups.root);
+    snprintf(value, sizeof(value), "%d", weight > 0 ? weight : COMPOSITOR_DEFAULT_CPU_WEIGHT);
+    return write_cgroup_file(path, "cpu.weight", value);
+}
+
+// Approximates cpu.weight with the nice level the kernel would map to it (each step is ~1.25x)
+static int weight_to_nice(int weight) {
+    double w = PLUGIN_DEFAULT_CPU_WEIGHT;
+    int nice = 0;
+    while (nice < 19 && w / 1.25 >= weight) {
+        w /= 1.25;
+        nice++;
+    }
+    while (nice > -20 && w * 1.25 <= weight) {
+        w *= 1.25;
+        nice--;
+    }
+    return nice;
+}
+
+void plugin_resources_apply_child(const plugin_resources_t *res) {
+    if (res->cgroup_path) {
+        char path[PATH_MAX];
+        size_t len = strlen(res->cgroup_path);
+        const char procs[] = "/cgroup.procs";
+        if (len + sizeof(procs) <= sizeof(path)) {
+            memcpy(path, res->cgroup_path, len);
+            memcpy(path + len, procs, sizeof(procs));
+            if (write_file(path, "0")) {
+                return;
+            }
+        }
+    }
+
+    // Fallback: no delegated cgroup
+    if (res->memory_max) {
+        struct rlimit limit = { .rlim_cur = res->memory_max, .rlim_max = res->memory_max };
+        setrlimit(RLIMIT_AS, &limit);
+    }
+    int nice = weight_to_nice(res->cpu_weight);
+    if (nice > 0) {
+        setpriority(PRIO_PROCESS, 0, nice);
+    }
+}
+
+static uint64_t read_stat_value(const char *buf, const char *key) {
+    const char *pos = strstr(buf, key);
+    if (!pos) return 0;
+    return strtoull(pos + strlen(key), NULL, 10);
+}
+
+bool plugin_resources_get_usage(const plugin_resources_t *res, pid_t pid, plugin_usage_t *usage) {
+    char path[PATH_MAX];
+    char buf[1024];
+    usage->cpu_usec = 0;
+    usage->memory_bytes = 0;
+
+    if (res->cgroup_path) {
+        snprintf(path, sizeof(path), "%s/cpu.stat", res->cgroup_path);
+        if (read_file(path, buf, sizeof(buf)) > 0) {
+            usage->cpu_usec = read_stat_value(buf, "usage_usec ");
+            snprintf(path, sizeof(path), "%s/memory.current", res->cgroup_path);
+            if (read_file(path, buf, sizeof(buf)) > 0) {
+                usage->memory_bytes = strtoull(buf, NULL, 10);
+            }
+            return true;
+        }
+    }
+
+    if (pid <= 0) {
+        return false;
+    }
+
+    // Without a cgroup only the plugin process itself is accounted, not its children
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) <= 0) {
+        return false;
+    }
+    // Fields after "(comm)": state is field 3, utime/stime are fields 14/15
+    char *fields = strrchr(buf, ')');
+    if (!fields) return false;
+    unsigned long long utime = 0, stime = 0;
+    if (sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return false;
+    }
+    long ticks = sysconf(_SC_CLK_TCK);
+    usage->cpu_usec = (utime + stime) * 1000000ULL / (ticks > 0 ? (unsigned long long)ticks : 100ULL);
+
+    snprintf(path, sizeof(path), "/proc/%d/statm", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) > 0) {
+        unsigned long long resident = 0;
+        if (sscanf(buf, "%*u %llu", &resident) == 1) {
+            usage->memory_bytes = resident * (uint64_t)sysconf(_SC_PAGESIZE);
+        }
+    }
+    return true;
+}
+
+void plugin_resources_release(plugin_resources_t *res) {
+    if (res->cgroup_path) {
+        // Fails with EBUSY while the plugin is still exiting; the empty cgroup is reused on the next launch
+        rmdir(res->cgroup_path);
+    }
+    free(res->cgroup_path);
+    res->cgroup_path = NULL;
+}
@@ -1,4 +1,5 @@
 #define _DEFAULT_SOURCE
+#define FDE_LOG_SUBSYSTEM FDE_LOG_PLUGINS
 
 #include <features.h>
 #include <linux/limits.h>
@@ -12,30 +13,201 @@
 #include <stdlib.h>
 #include <signal.h>
 
+#include <fde/comp/autostart.h>
 #include <fde/dbus.h>
 #include <fde/utils/log.h>
+#include <fde/utils/pool.h>
+#include <fde/utils/trace.h>
 #include <fde/config.h>
 #include <fde/plugin-system.h>
+#include <fde/plugin-watchdog.h>
 
 // TODO: Добавить поддержку ивентов в плагинах
 // Отправлять dbus сигналы на все подключенные плагины при каких-либо ивентах 
 
+FDE_POOL(plugin_pool, plugin_instance_t)
+
+static int handle_sigchld(int signal_number, void *data) {
+    compositor_t *server = data;
+    int status;
+    pid_t pid;
+    // Reaps every child: plugins and autostarted clients
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        plugin_instance_t *plugin = plugin_list_find_by_pid(server, pid);
+        if (!plugin) {
+            autostart_child_exited(pid, status);
+            continue;
+        }
+
+        if (WIFSIGNALED(status)) {
+            fde_log(FDE_ERROR, "Plugin %s (PID %d) killed by signal %d", plugin->name, pid, WTERMSIG(status));
+        } else {
+            fde_log(FDE_INFO, "Plugin %s (PID %d) exited with status %d", plugin->name, pid, WEXITSTATUS(status));
+        }
+        plugin_list_set_pid(server, plugin, 0);
+        plugin_unregister(server, plugin, "exited");
+    }
+    return 0;
+}
+
+bool plugin_system_init(compositor_t *server) {
+    wl_list_init(&server->plugins);
+    fde_hashmap_init(&server->plugins_by_name, true);
+    fde_hashmap_init(&server->plugins_by_pid, false);
+    fde_hashmap_init(&server->plugins_by_bus_name, true);
+
+    server->sigchld_source = wl_event_loop_add_signal(server->wl_event_loop, SIGCHLD, handle_sigchld, server);
+    if (!server->sigchld_source) {
+        fde_log(FDE_ERROR, "Failed to watch SIGCHLD, plugin exits will go unnoticed");
+    }
+    return true;
+}
+
+void plugin_system_finish(compositor_t *server) {
+    if (!server->plugins.next) return;  // plugin_system_init() was never reached
+    DESTROY_AND_NULL(server->sigchld_source, wl_event_source_remove);
+
+    plugin_instance_t *p, *tmp;
+    wl_list_for_each_safe(p, tmp, &server->plugins, link) {
+        if (p->pid > 0) {
+            kill(p->pid, SIGTERM);
+            fde_log(FDE_INFO, "Terminated plugin %s (PID %d)", p->name ?: "unknown", p->pid);
+        }
+        plugin_list_remove(server, p);
+        plugin_instance_destroy(p);
+    }
+
+    plugin_watchdog_finish();
+    fde_hashmap_finish(&server->plugins_by_name);
+    fde_hashmap_finish(&server->plugins_by_pid);
+    fde_hashmap_finish(&server->plugins_by_bus_name);
+}
+
 void plugin_list_add(compositor_t *server, plugin_instance_t *plugin) {
     wl_list_insert(&server->plugins, &plugin->link);
+    if (plugin->name) fde_hashmap_set_str(&server->plugins_by_name, plugin->name, plugin);
+    if (plugin->pid > 0) fde_hashmap_set_int(&server->plugins_by_pid, (uint64_t)plugin->pid, plugin);
+    if (plugin->bus_name) fde_hashmap_set_str(&server->plugins_by_bus_name, plugin->bus_name, plugin);
 }
 
 void plugin_list_remove(compositor_t *server, plugin_instance_t *plugin) {
     wl_list_remove(&plugin->link);
+    wl_list_init(&plugin->link);
+    if (plugin->name) fde_hashmap_remove_str(&server->plugins_by_name, plugin->name);
+    if (plugin->pid > 0) fde_hashmap_remove_int(&server->plugins_by_pid, (uint64_t)plugin->pid);
+    if (plugin->bus_name) fde_hashmap_remove_str(&server->plugins_by_bus_name, plugin->bus_name);
+}
+
+// Индексы хранят указатели на строки плагина: переиндексируем до освобождения старой строки
+static bool reindex_string(fde_hashmap_t *map, plugin_instance_t *plugin, char **field, const char *value) {
+    char *copy = value ? strdup(value) : NULL;
+    if (value && !copy) {
+        return false;
+    }
+    if (*field) {
+        fde_hashmap_remove_str(map, *field);
+        free(*field);
+    }
+    *field = copy;
+    if (copy && !fde_hashmap_set_str(map, copy, plugin)) {
+        return false;
+    }
+    return true;
+}
+
+bool plugin_list_set_name(compositor_t *server, plugin_instance_t *plugin, const char *name) {
+    fde_istr_t interned = name ? fde_intern(name) : NULL;
+    if (name && !interned) {
+        return false;
+    }
+    if (plugin->name) {
+        fde_hashmap_remove_str(&server->plugins_by_name, plugin->name);
+    }
+    plugin->name = interned;
+    return !interned || fde_hashmap_set_str(&server->plugins_by_name, interned, plugin);
+}
+
+bool plugin_list_set_bus_name(compositor_t *server, plugin_instance_t *plugin, const char *bus_name) {
+    return reindex_string(&server->plugins_by_bus_name, plugin, &plugin->bus_name, bus_name);
+}
+
+bool plugin_list_set_pid(compositor_t *server, plugin_instance_t *plugin, pid_t pid) {
+    if (plugin->pid > 0) {
+        fde_hashmap_remove_int(&server->plugins_by_pid, (uint64_t)plugin->pid);
+    }
+    plugin->pid = pid;
+    return pid <= 0 || fde_hashmap_set_int(&server->plugins_by_pid, (uint64_t)pid, plugin);
 }
 
 plugin_instance_t *plugin_list_find_by_name(compositor_t *server, const char *name) {
-    plugin_instance_t *p;
-    wl_list_for_each(p, &server->plugins, link) {
-        if (strcmp(p->name, name) == 0) {
-            return p;
+    return name ? fde_hashmap_get_str(&server->plugins_by_name, name) : NULL;
+}
+
+plugin_instance_t *plugin_list_find_by_pid(compositor_t *server, pid_t pid) {
+    return pid > 0 ? fde_hashmap_get_int(&server->plugins_by_pid, (uint64_t)pid) : NULL;
+}
+
+plugin_instance_t *plugin_list_find_by_bus_name(compositor_t *server, const char *bus_name) {
+    return bus_name ? fde_hashmap_get_str(&server->plugins_by_bus_name, bus_name) : NULL;
+}
+
+plugin_instance_t *plugin_instance_create(void) {
+    return plugin_pool_alloc();
+}
+
+void plugin_instance_destroy(plugin_instance_t *plugin) {
+    if (!plugin) return;
+    plugin_resources_release(&plugin->resources);
+    free(plugin->dbus_path);
+    free(plugin->bus_name);
+    plugin_pool_free(plugin);
+}
+
+void plugin_unregister(compositor_t *server, plugin_instance_t *plugin, const char *reason) {
+    fde_log(FDE_INFO, "Unregistering plugin %s (%s)", plugin->name ?: "unknown", reason);
+    if (plugin->bus_name) {
+        const char *name = plugin->name ?: "";
+        send_dbus_signal(
+            server,
+            "org.fde.Compositor.Plugins",
+            "PluginUnregistered",
+            DBUS_TYPE_STRING, name,
+            DBUS_TYPE_INVALID
+        );
+    }
+    plugin_list_remove(server, plugin);
+    plugin_instance_destroy(plugin);
+}
+
+bool plugins_filter_button(compositor_t *server, uint32_t time_msec, uint32_t button, uint32_t state) {
+    if (!server->plugins.next) return false;
+
+    plugin_instance_t *plugin;
+    wl_list_for_each(plugin, &server->plugins, link) {
+        // Пониженные плагины тоже идут через plugin_call: он решает, пора ли пробный вызов
+        if (!plugin->supports_input) continue;
+
+        DBusMessage *call = plugin_call_new(plugin, PLUGIN_INPUT_INTERFACE, "FilterButton");
+        if (call && !dbus_message_append_args(call, DBUS_TYPE_UINT32, &time_msec, DBUS_TYPE_UINT32, &button,
+                DBUS_TYPE_UINT32, &state, DBUS_TYPE_INVALID)) {
+            dbus_message_unref(call);
+            continue;
+        }
+        // Без ответа в бюджет - поведение по умолчанию (событие идет клиенту)
+        DBusMessage *reply = plugin_call(server, plugin, call, 0);
+        if (!reply) continue;
+
+        dbus_bool_t consumed = FALSE;
+        if (!dbus_message_get_args(reply, NULL, DBUS_TYPE_BOOLEAN, &consumed, DBUS_TYPE_INVALID)) {
+            consumed = FALSE;
+        }
+        dbus_message_unref(reply);
+        if (consumed) {
+            fde_log(FDE_DEBUG, "Button %u consumed by plugin %s", button, plugin->name);
+            return true;
         }
     }
-    return NULL;
+    return false;
 }
 
 static char *expand_tilde(const char *path) {
@@ -52,22 +224,89 @@ static char *expand_tilde(const char *path) {
     return full;
 }
 
-bool load_plugins_from_dir(compositor_t *server, struct fde_config *config) {
-    if (!server || !config || !config->plugins.dir) {
-        fde_log(FDE_ERROR, "No config or plugins dir set");
-        return false;
+plugin_instance_t *plugin_launch(compositor_t *server, const char *path, const char *name) {
+    FDE_TRACE_SCOPE("plugin.launch");
+    // Лимиты ресурсов из "<plugin>.conf" рядом с исполняемым файлом
+    plugin_resources_t resources;
+    plugin_resources_defaults(&resources);
+    char conf_path[PATH_MAX + 8];
+    snprintf(conf_path, sizeof(conf_path), "%s.conf", path);
+    if (plugin_resources_load_conf(&resources, conf_path)) {
+        fde_log(FDE_DEBUG, "Loaded resources for %s: cpu.weight %d, memory.max %llu", name,
+            resources.cpu_weight, (unsigned long long)resources.memory_max);
+    }
+    plugin_resources_prepare(&resources, name);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fde_log(FDE_ERROR, "Fork failed for %s: %s", name, strerror(errno));
+        plugin_resources_release(&resources);
+        return NULL;
+    } else if (pid == 0) {
+        // Дочерний процесс: cgroup/rlimit, затем exec плагин.
+        // SIGCHLD заблокирован в композиторе (signalfd event loop), маска наследуется через exec
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        plugin_resources_apply_child(&resources);
+        char *argv[] = {(char *)name, NULL};
+        execv(path, argv);
+        fprintf(stderr, "Exec failed for %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    // Родительский процесс: добавляем временный плагин в список
+    plugin_instance_t *temp_plugin = plugin_instance_create();
+    if (!temp_plugin) {
+        fde_log(FDE_ERROR, "Cannot alloc temp plugin for %s", name);
+        kill(pid, SIGTERM);
+        plugin_resources_release(&resources);
+        return NULL;
+    }
+    temp_plugin->pid = pid;
+    temp_plugin->name = fde_intern(name);
+    temp_plugin->exec_path = fde_intern(path);
+    temp_plugin->dbus_path = NULL;
+    temp_plugin->resources = resources;
+    // Флаги по умолчанию: unknown
+    plugin_list_add(server, temp_plugin);
+    fde_log(FDE_INFO, "Launched plugin '%s' (PID %d) | (FOR DEBUG: Check for [src/dbus/dbus.c] Plugin register or update existing)", name, pid);
+    return temp_plugin;
+}
+
+plugin_instance_t *plugin_restart(compositor_t *server, plugin_instance_t *plugin) {
+    // Interned strings outlive the instance
+    fde_istr_t path = plugin->exec_path, name = plugin->name;
+    if (!path || !name) {
+        return NULL;
     }
 
-    char *plugins_path = expand_tilde(config->plugins.dir);
+    if (plugin->pid > 0) {
+        kill(plugin->pid, SIGTERM);
+        // Старый процесс будет собран SIGCHLD без записи в реестре
+        plugin_list_set_pid(server, plugin, 0);
+    }
+    plugin_unregister(server, plugin, "restarting");
+
+    return plugin_launch(server, path, name);
+}
+
+bool plugin_scan_dir(const char *dir_path, plugin_scan_t *scan) {
+    *scan = (plugin_scan_t){0};
+    char *plugins_path = expand_tilde(dir_path);
+    if (!plugins_path) {
+        return false;
+    }
     DIR *dir = opendir(plugins_path);
     if (!dir) {
         fde_log(FDE_ERROR, "Cannot open plugins dir '%s': %s", plugins_path, strerror(errno));
+        free(plugins_path);
         return false;
     }
 
     fde_log(FDE_INFO, "Scanning plugins in '%s'", plugins_path);
     struct dirent *entry;
-    int launched_count = 0;
+    int capacity = 0;
 
     while ((entry = readdir(dir)) != NULL) {
         if (entry->d_name[0] == '.' || strstr(entry->d_name, ".conf") || entry->d_type != DT_REG)
@@ -82,34 +321,61 @@ bool load_plugins_from_dir(compositor_t *server, struct fde_config *config) {
             continue;
         }
 
-        pid_t pid = fork();
-        if (pid < 0) {
-            fde_log(FDE_ERROR, "Fork failed for %s: %s", entry->d_name, strerror(errno));
-            continue;
-        } else if (pid == 0) {
-            // Дочерний процесс: exec плагин
-            char *argv[] = {entry->d_name, NULL};
-            execv(path, argv);
-            fprintf(stderr, "Exec failed for %s: %s\n", path, strerror(errno));
-            exit(1);
+        if (scan->count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            char **paths = realloc(scan->paths, capacity * sizeof(char *));
+            if (paths) scan->paths = paths;
+            char **names = realloc(scan->names, capacity * sizeof(char *));
+            if (names) scan->names = names;
+            if (!paths || !names) break;
         }
-
-        // Родительский процесс: добавляем временный плагин в список
-        plugin_instance_t *temp_plugin = calloc(1, sizeof(plugin_instance_t));
-        if (!temp_plugin) {
-            fde_log(FDE_ERROR, "Cannot alloc temp plugin for %s", entry->d_name);
-            kill(pid, SIGTERM);
-            continue;
+        scan->paths[scan->count] = strdup(path);
+        scan->names[scan->count] = strdup(entry->d_name);
+        if (!scan->paths[scan->count] || !scan->names[scan->count]) {
+            free(scan->paths[scan->count]);
+            free(scan->names[scan->count]);
+            break;
         }
-        temp_plugin->pid = pid;
-        temp_plugin->name = strdup(entry->d_name);
-        temp_plugin->dbus_path = NULL;
-        // Флаги по умолчанию: unknown
-        plugin_list_add(server, temp_plugin);
-        fde_log(FDE_INFO, "Launched plugin '%s' (PID %d) | (FOR DEBUG: Check for [src/dbus/dbus.c] Plugin register or update existing)", entry->d_name, pid);
-        launched_count++;
+        scan->count++;
     }
 
     closedir(dir);
+    free(plugins_path);
+    return true;
+}
+
+int plugin_launch_scanned(compositor_t *server, const plugin_scan_t *scan) {
+    int launched_count = 0;
+    for (int i = 0; i < scan->count; i++) {
+        if (plugin_launch(server, scan->paths[i], scan->names[i])) {
+            launched_count++;
+        }
+    }
+    return launched_count;
+}
+
+void plugin_scan_finish(plugin_scan_t *scan) {
+    for (int i = 0; i < scan->count; i++) {
+        free(scan->paths[i]);
+        free(scan->names[i]);
+    }
+    free(scan->paths);
+    free(scan->names);
+    *scan = (plugin_scan_t){0};
+}
+
+bool load_plugins_from_dir(compositor_t *server, struct fde_config *config) {
+    if (!server || !config || !config->plugins.dir) {
+        fde_log(FDE_ERROR, "No config or plugins dir set");
+        return false;
+    }
+
+    plugin_scan_t scan;
+    if (!plugin_scan_dir(config->plugins.dir, &scan)) {
+        return false;
+    }
+
+    int launched_count = plugin_launch_scanned(server, &scan);
+    plugin_scan_finish(&scan);
     return launched_count > 0;
 }
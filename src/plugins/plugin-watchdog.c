@@ -0,0 +1,239 @@
+#define _DEFAULT_SOURCE
+#define FDE_LOG_SUBSYSTEM FDE_LOG_PLUGINS
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fde/config.h>
+#include <fde/dbus.h>
+#include <fde/plugin-system.h>
+#include <fde/plugin-watchdog.h>
+#include <fde/utils/hashmap.h>
+#include <fde/utils/log.h>
+
+// Log-linear histogram: exact below 16us, then 8 sub-buckets per power of two (~12% error)
+#define LINEAR_BUCKETS 16
+#define SUB_BUCKETS 8
+#define HISTOGRAM_BUCKETS (LINEAR_BUCKETS + (64 - 4) * SUB_BUCKETS)
+
+typedef struct method_stats {
+    char *method;
+    uint64_t calls;
+    uint64_t timeouts;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} method_stats_t;
+
+static fde_hashmap_t method_stats;  // "interface.Member" -> method_stats_t
+static bool method_stats_ready = false;
+
+static unsigned bucket_index(uint64_t usec) {
+    if (usec < LINEAR_BUCKETS) {
+        return (unsigned)usec;
+    }
+    unsigned exp = 63 - (unsigned)__builtin_clzll(usec);  // >= 4
+    unsigned sub = (unsigned)(usec >> (exp - 3)) & (SUB_BUCKETS - 1);
+    return LINEAR_BUCKETS + (exp - 4) * SUB_BUCKETS + sub;
+}
+
+// Upper bound of the bucket, reported as the percentile value
+static uint64_t bucket_value(unsigned index) {
+    if (index < LINEAR_BUCKETS) {
+        return index;
+    }
+    unsigned exp = (index - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+    uint64_t sub = (index - LINEAR_BUCKETS) % SUB_BUCKETS;
+    uint64_t base = (1ULL << exp) | (sub << (exp - 3));
+    return base + (1ULL << (exp - 3)) - 1;
+}
+
+static uint64_t percentile(const method_stats_t *stats, unsigned pct) {
+    uint64_t total = 0;
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) total += stats->buckets[i];
+    if (!total) return 0;
+
+    uint64_t rank = (total * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= rank) return bucket_value(i);
+    }
+    return bucket_value(HISTOGRAM_BUCKETS - 1);
+}
+
+static method_stats_t *get_method_stats(const char *interface, const char *method) {
+    if (!method_stats_ready) {
+        fde_hashmap_init(&method_stats, true);
+        method_stats_ready = true;
+    }
+
+    char key[256];
+    snprintf(key, sizeof(key), "%s.%s", interface ?: "", method ?: "");
+    method_stats_t *stats = fde_hashmap_get_str(&method_stats, key);
+    if (stats) {
+        return stats;
+    }
+
+    stats = calloc(1, sizeof(method_stats_t));
+    if (!stats || !(stats->method = strdup(key)) || !fde_hashmap_set_str(&method_stats, stats->method, stats)) {
+        if (stats) free(stats->method);
+        free(stats);
+        return NULL;
+    }
+    return stats;
+}
+
+static uint64_t elapsed_usec(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t nsec = (int64_t)(now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+    return nsec > 0 ? (uint64_t)nsec / 1000 : 0;
+}
+
+static uint64_t monotonic_msec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// Редкие промахи не копятся до понижения: каждый PLUGIN_VIOLATION_DECAY_MS без новых нарушений
+// списывает одно
+static void decay_violations(plugin_instance_t *plugin, uint64_t now_ms) {
+    if (!plugin->budget_violations) {
+        plugin->violation_decay_ms = now_ms;
+        return;
+    }
+    uint64_t intervals = (now_ms - plugin->violation_decay_ms) / PLUGIN_VIOLATION_DECAY_MS;
+    if (!intervals) return;
+    plugin->budget_violations = intervals >= plugin->budget_violations ? 0 :
+        plugin->budget_violations - (uint32_t)intervals;
+    plugin->violation_decay_ms += intervals * PLUGIN_VIOLATION_DECAY_MS;
+    if (plugin->demoted && plugin->budget_violations == 0) {
+        plugin->demoted = false;
+        fde_log(FDE_INFO, "Plugin %s answers in time again, synchronous calls resumed", plugin->name);
+    }
+}
+
+// Пониженный плагин получает пробный вызов раз в PLUGIN_PROBE_INTERVAL_MS: иначе его счетчик
+// никогда не дойдет до kill_after и не спишется до нуля
+static bool probe_due(plugin_instance_t *plugin) {
+    uint64_t now_ms = monotonic_msec();
+    decay_violations(plugin, now_ms);
+    if (!plugin->demoted) {
+        return true;
+    }
+    if (now_ms - plugin->last_probe_ms < PLUGIN_PROBE_INTERVAL_MS) {
+        return false;
+    }
+    plugin->last_probe_ms = now_ms;
+    return true;
+}
+
+static void record_violation(plugin_instance_t *plugin, const char *method, int budget_ms) {
+    int demote_after = config && config->plugins.demote_after > 0 ? config->plugins.demote_after : PLUGIN_DEFAULT_DEMOTE_AFTER;
+    int kill_after = config && config->plugins.kill_after > 0 ? config->plugins.kill_after : PLUGIN_DEFAULT_KILL_AFTER;
+
+    uint64_t now_ms = monotonic_msec();
+    decay_violations(plugin, now_ms);
+    plugin->budget_violations++;
+    plugin->violation_decay_ms = now_ms;
+    fde_log(FDE_ERROR, "Plugin %s missed its %d ms budget for %s (%u violations)",
+        plugin->name, budget_ms, method, plugin->budget_violations);
+
+    if (!plugin->demoted && plugin->budget_violations >= (uint32_t)demote_after) {
+        plugin->demoted = true;
+        fde_log(FDE_ERROR, "Plugin %s demoted: synchronous calls fall back to defaults", plugin->name);
+    }
+    if (plugin->budget_violations >= (uint32_t)kill_after && plugin->pid > 0) {
+        fde_log(FDE_ERROR, "Killing unresponsive plugin %s (PID %d)", plugin->name, plugin->pid);
+        // SIGCHLD handler unregisters it
+        kill(plugin->pid, SIGKILL);
+    }
+}
+
+DBusMessage *plugin_call_new(plugin_instance_t *plugin, const char *interface, const char *method) {
+    if (!plugin->bus_name) {
+        return NULL;
+    }
+    return dbus_message_new_method_call(plugin->bus_name, plugin->dbus_path ?: "/", interface, method);
+}
+
+DBusMessage *plugin_call(compositor_t *server, plugin_instance_t *plugin, DBusMessage *call, int budget_ms) {
+    if (!call) {
+        return NULL;
+    }
+    if (!server->dbus_conn || !plugin->bus_name || !probe_due(plugin)) {
+        dbus_message_unref(call);
+        return NULL;
+    }
+    if (budget_ms <= 0) {
+        budget_ms = config && config->plugins.call_budget_ms > 0 ? config->plugins.call_budget_ms : PLUGIN_DEFAULT_CALL_BUDGET_MS;
+    }
+
+    method_stats_t *stats = get_method_stats(dbus_message_get_interface(call), dbus_message_get_member(call));
+    const char *method = stats ? stats->method : dbus_message_get_member(call);
+
+    DBusError error;
+    dbus_error_init(&error);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block(server->dbus_conn, call, budget_ms, &error);
+    uint64_t usec = elapsed_usec(&start);
+    dbus_message_unref(call);
+
+    if (stats) {
+        stats->calls++;
+        stats->buckets[bucket_index(usec)]++;
+    }
+
+    if (!reply) {
+        bool timed_out = error.name && (strcmp(error.name, DBUS_ERROR_NO_REPLY) == 0 ||
+            strcmp(error.name, DBUS_ERROR_TIMEOUT) == 0);
+        if (timed_out) {
+            if (stats) stats->timeouts++;
+            record_violation(plugin, method, budget_ms);
+        } else {
+            fde_log(FDE_DEBUG, "Call %s to plugin %s failed: %s", method, plugin->name, error.message ?: "unknown error");
+        }
+        dbus_error_free(&error);
+        return NULL;
+    }
+
+    dbus_error_free(&error);
+    decay_violations(plugin, monotonic_msec());
+    return reply;
+}
+
+void plugin_watchdog_for_each_method(plugin_latency_iter_t iter, void *data) {
+    if (!method_stats_ready) return;
+
+    size_t it = 0;
+    fde_hashmap_entry_t *entry;
+    while ((entry = fde_hashmap_next(&method_stats, &it))) {
+        method_stats_t *stats = entry->value;
+        plugin_latency_report_t report = {
+            .method = stats->method,
+            .calls = stats->calls,
+            .timeouts = stats->timeouts,
+            .p50_usec = percentile(stats, 50),
+            .p99_usec = percentile(stats, 99),
+        };
+        iter(&report, data);
+    }
+}
+
+void plugin_watchdog_finish(void) {
+    if (!method_stats_ready) return;
+
+    size_t it = 0;
+    fde_hashmap_entry_t *entry;
+    while ((entry = fde_hashmap_next(&method_stats, &it))) {
+        method_stats_t *stats = entry->value;
+        free(stats->method);
+        free(stats);
+    }
+    fde_hashmap_finish(&method_stats);
+    method_stats_ready = false;
+}
@@ -0,0 +1,212 @@
+// fde-trace: converts a recording made by fde (see fde/utils/trace.h) to Chrome trace JSON.
+// Usage: fde-trace <trace dir> [output.json]
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fde/utils/trace.h>
+
+typedef struct {
+    char **names;  // Indexed by site id
+    uint32_t count;
+} site_names_t;
+
+static bool load_names(const char *dir, site_names_t *names) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/names", dir);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "fde-trace: cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        char *end;
+        unsigned long id = strtoul(line, &end, 10);
+        if (end == line || *end != ' ' || id == 0 || id > UINT32_MAX) continue;
+        end++;
+        end[strcspn(end, "\n")] = '\0';
+
+        if (id >= names->count) {
+            uint32_t count = (uint32_t)id + 64;
+            char **grown = realloc(names->names, count * sizeof(char *));
+            if (!grown) break;
+            memset(grown + names->count, 0, (count - names->count) * sizeof(char *));
+            names->names = grown;
+            names->count = count;
+        }
+        free(names->names[id]);
+        names->names[id] = strdup(end);
+    }
+    fclose(file);
+    return true;
+}
+
+static void write_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_event_prefix(FILE *out, bool *first, const fde_trace_file_header_t *header,
+        const char *ph, const char *name, uint64_t ts_ns) {
+    fputs(*first ? "\n" : ",\n", out);
+    *first = false;
+    fputs("{\"name\":", out);
+    write_json_string(out, name);
+    fprintf(out, ",\"ph\":\"%s\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d", ph,
+        (unsigned long long)(ts_ns / 1000), (unsigned long long)(ts_ns % 1000),
+        header->pid, header->tid);
+}
+
+static int convert_thread(const char *path, const site_names_t *names, FILE *out, bool *first) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "fde-trace: cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(fde_trace_file_header_t)) {
+        fprintf(stderr, "fde-trace: %s: truncated\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "fde-trace: cannot map %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const fde_trace_file_header_t *header = map;
+    if (memcmp(header->magic, FDE_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != FDE_TRACE_VERSION || header->record_size != sizeof(fde_trace_record_t) ||
+            header->capacity == 0 ||
+            sizeof(*header) + header->capacity * sizeof(fde_trace_record_t) > (size_t)st.st_size) {
+        fprintf(stderr, "fde-trace: %s: not a trace ring of this version\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    char thread_name[sizeof(header->thread_name) + 1] = {0};
+    memcpy(thread_name, header->thread_name, sizeof(header->thread_name));
+    fputs(*first ? "\n" : ",\n", out);
+    *first = false;
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+        header->pid, header->tid);
+    write_json_string(out, thread_name);
+    fputs("}}", out);
+
+    const fde_trace_record_t *records = (const fde_trace_record_t *)(header + 1);
+    uint64_t written = atomic_load_explicit(&((fde_trace_file_header_t *)header)->written, memory_order_acquire);
+    uint64_t count = written < header->capacity ? written : header->capacity;
+    int depth = 0;
+    int converted = 0;
+
+    for (uint64_t i = written - count; i < written; i++) {
+        const fde_trace_record_t *record = &records[i % header->capacity];
+        const char *name = record->site < names->count && names->names[record->site]
+            ? names->names[record->site] : "?";
+
+        switch (record->type) {
+        case FDE_TRACE_BEGIN:
+            depth++;
+            write_event_prefix(out, first, header, "B", name, record->timestamp_ns);
+            fputs("}", out);
+            break;
+        case FDE_TRACE_END:
+            // Начало могло быть перезаписано кольцом
+            if (depth == 0) continue;
+            depth--;
+            write_event_prefix(out, first, header, "E", name, record->timestamp_ns);
+            fputs("}", out);
+            break;
+        case FDE_TRACE_COUNTER:
+            write_event_prefix(out, first, header, "C", name, record->timestamp_ns);
+            fprintf(out, ",\"args\":{\"value\":%lld}}", (long long)record->value);
+            break;
+        default:
+            continue;
+        }
+        converted++;
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return converted;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        fprintf(stderr, "Usage: %s <trace dir> [output.json]\n"
+            "Converts an fde trace recording to Chrome trace JSON (chrome://tracing, ui.perfetto.dev).\n",
+            argv[0]);
+        return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    const char *dir_path = argv[1];
+
+    site_names_t names = {0};
+    if (!load_names(dir_path, &names)) {
+        return EXIT_FAILURE;
+    }
+
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "fde-trace: cannot open %s: %s\n", dir_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "fde-trace: cannot create %s: %s\n", argv[2], strerror(errno));
+        closedir(dir);
+        return EXIT_FAILURE;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+    bool first = true;
+    int threads = 0, events = 0, status = EXIT_SUCCESS;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        size_t len = strlen(entry->d_name);
+        if (strncmp(entry->d_name, "thread-", 7) != 0 || len < 6 || strcmp(entry->d_name + len - 6, ".trace") != 0) {
+            continue;
+        }
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        int converted = convert_thread(path, &names, out, &first);
+        if (converted < 0) {
+            status = EXIT_FAILURE;
+            continue;
+        }
+        threads++;
+        events += converted;
+    }
+    fputs("\n]}\n", out);
+    closedir(dir);
+
+    if (out != stdout) fclose(out);
+    for (uint32_t i = 0; i < names.count; i++) free(names.names[i]);
+    free(names.names);
+
+    fprintf(stderr, "fde-trace: %d events from %d threads\n", events, threads);
+    return status;
+}
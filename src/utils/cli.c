@@ -14,7 +14,10 @@ const struct option long_options[] = {
     {"debug", no_argument, NULL, 'd'},
     {"config", required_argument, NULL, 'c'},
     {"validate", no_argument, NULL, 'C'},
-    {"verbose", no_argument, NULL, 'V'}
+    {"verbose", no_argument, NULL, 'V'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"startup-report", no_argument, NULL, 'R'},
+    {0, 0, 0, 0}
 };
 
 const char usage[] =
@@ -22,8 +25,11 @@ const char usage[] =
 	"\n"
 	"  -h, --help             Show help message and quit.\n"
 	"  -c, --config <config>  Specify a config file.\n"
-	"  -C, --validate         Check the validity of the config file, then exit.\n"
+	"  -C, --validate [path]  Check the validity of the config file (or of the given files and\n"
+	"                         directories of *.ini), print JSON diagnostics, then exit.\n"
+	"  -j, --jobs <n>         Number of validation threads (default: one per CPU).\n"
 	"  -d, --debug            Enables full logging, including debug information.\n"
+	"      --startup-report   Print the time spent in each startup phase after the first frame.\n"
 	"  -v, --version          Show the version number and quit.\n"
 	"  -V, --verbose          Enables more verbose logging.\n"
 	"\n"
@@ -36,11 +42,11 @@ static void handle_set_config_path(struct cli_args *args) {
 struct cli_args parse_cli_args(int argc, char *argv[]) {
     int option_result;
 
-    struct cli_args parsed_args = {0, false, false, false};
+    struct cli_args parsed_args = {0};
 
     while(true) {
         int option_index = 0;
-        option_result = getopt_long(argc, argv, "hCdD:vVc:", long_options, &option_index);
+        option_result = getopt_long(argc, argv, "hCdD:vVc:j:", long_options, &option_index);
         
         if (option_result == ALL_OPTIONS_CONSUMED) {
             break;
@@ -67,6 +73,12 @@ struct cli_args parse_cli_args(int argc, char *argv[]) {
         case 'V': // verbose
 			parsed_args.verbose = true;
 			break;
+        case 'j': // jobs
+			parsed_args.jobs = atoi(optarg);
+			break;
+        case 'R': // startup-report
+			parsed_args.startup_report = true;
+			break;
         case OPTION_PARSE_FAILURE:
             exit(EXIT_FAILURE);
             break;
@@ -76,5 +88,11 @@ struct cli_args parse_cli_args(int argc, char *argv[]) {
         }
     }
 
+    // getopt_long переставляет позиционные аргументы в конец
+    if (parsed_args.validate && optind < argc) {
+        parsed_args.validate_paths = &argv[optind];
+        parsed_args.num_validate_paths = argc - optind;
+    }
+
     return parsed_args;
 };
\ No newline at end of file
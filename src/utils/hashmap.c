@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <fde/utils/hashmap.h>
+
+#define HASH_EMPTY 0
+#define HASH_DELETED 1
+#define MIN_CAPACITY 16
+
+// FNV-1a
+uint64_t fde_hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t fde_hash_string(const char *str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer
+uint64_t fde_hash_int(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+static inline uint64_t slot_hash(uint64_t hash) {
+    return hash < 2 ? hash + 2 : hash;
+}
+
+void fde_hashmap_init(fde_hashmap_t *map, bool str_keys) {
+    memset(map, 0, sizeof(*map));
+    map->str_keys = str_keys;
+}
+
+void fde_hashmap_finish(fde_hashmap_t *map) {
+    free(map->entries);
+    map->entries = NULL;
+    map->capacity = map->count = map->used = 0;
+}
+
+static bool keys_equal(const fde_hashmap_t *map, const fde_hashmap_entry_t *entry, const char *str_key, uint64_t int_key) {
+    return map->str_keys ? strcmp(entry->str_key, str_key) == 0 : entry->int_key == int_key;
+}
+
+static fde_hashmap_entry_t *find_entry(const fde_hashmap_t *map, uint64_t hash, const char *str_key, uint64_t int_key) {
+    if (!map->capacity) {
+        return NULL;
+    }
+    size_t mask = map->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        fde_hashmap_entry_t *entry = &map->entries[i];
+        if (entry->hash == HASH_EMPTY) {
+            return NULL;
+        }
+        if (entry->hash == hash && keys_equal(map, entry, str_key, int_key)) {
+            return entry;
+        }
+    }
+}
+
+static bool resize(fde_hashmap_t *map, size_t capacity) {
+    fde_hashmap_entry_t *entries = calloc(capacity, sizeof(*entries));
+    if (!entries) {
+        return false;
+    }
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < map->capacity; i++) {
+        fde_hashmap_entry_t *old = &map->entries[i];
+        if (old->hash < 2) continue;
+        size_t j = old->hash & mask;
+        while (entries[j].hash != HASH_EMPTY) {
+            j = (j + 1) & mask;
+        }
+        entries[j] = *old;
+    }
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+    map->used = map->count;
+    return true;
+}
+
+static bool insert(fde_hashmap_t *map, uint64_t hash, const char *str_key, uint64_t int_key, void *value) {
+    fde_hashmap_entry_t *existing = find_entry(map, hash, str_key, int_key);
+    if (existing) {
+        existing->value = value;
+        return true;
+    }
+
+    // Keep load (including deleted slots) under 3/4
+    if ((map->used + 1) * 4 > map->capacity * 3) {
+        size_t capacity = map->capacity ? map->capacity : MIN_CAPACITY;
+        while ((map->count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+        if (!resize(map, capacity)) {
+            return false;
+        }
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t i = hash & mask;
+    while (map->entries[i].hash >= 2) {
+        i = (i + 1) & mask;
+    }
+    fde_hashmap_entry_t *entry = &map->entries[i];
+    if (entry->hash == HASH_EMPTY) {
+        map->used++;
+    }
+    entry->hash = hash;
+    if (map->str_keys) {
+        entry->str_key = str_key;
+    } else {
+        entry->int_key = int_key;
+    }
+    entry->value = value;
+    map->count++;
+    return true;
+}
+
+static void *remove_entry(fde_hashmap_t *map, fde_hashmap_entry_t *entry) {
+    if (!entry) {
+        return NULL;
+    }
+    void *value = entry->value;
+    entry->hash = HASH_DELETED;
+    entry->value = NULL;
+    map->count--;
+    return value;
+}
+
+bool fde_hashmap_set_str(fde_hashmap_t *map, const char *key, void *value) {
+    return insert(map, slot_hash(fde_hash_string(key)), key, 0, value);
+}
+
+void *fde_hashmap_get_str(const fde_hashmap_t *map, const char *key) {
+    fde_hashmap_entry_t *entry = find_entry(map, slot_hash(fde_hash_string(key)), key, 0);
+    return entry ? entry->value : NULL;
+}
+
+void *fde_hashmap_remove_str(fde_hashmap_t *map, const char *key) {
+    return remove_entry(map, find_entry(map, slot_hash(fde_hash_string(key)), key, 0));
+}
+
+bool fde_hashmap_set_int(fde_hashmap_t *map, uint64_t key, void *value) {
+    return insert(map, slot_hash(fde_hash_int(key)), NULL, key, value);
+}
+
+void *fde_hashmap_get_int(const fde_hashmap_t *map, uint64_t key) {
+    fde_hashmap_entry_t *entry = find_entry(map, slot_hash(fde_hash_int(key)), NULL, key);
+    return entry ? entry->value : NULL;
+}
+
+void *fde_hashmap_remove_int(fde_hashmap_t *map, uint64_t key) {
+    return remove_entry(map, find_entry(map, slot_hash(fde_hash_int(key)), NULL, key));
+}
+
+fde_hashmap_entry_t *fde_hashmap_next(const fde_hashmap_t *map, size_t *iter) {
+    while (*iter < map->capacity) {
+        fde_hashmap_entry_t *entry = &map->entries[(*iter)++];
+        if (entry->hash >= 2) {
+            return entry;
+        }
+    }
+    return NULL;
+}
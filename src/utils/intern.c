@@ -0,0 +1,108 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fde/utils/hashmap.h>
+#include <fde/utils/intern.h>
+#include <fde/utils/log.h>
+
+#define INTERN_CHUNK_SIZE 4096
+
+typedef struct intern_chunk {
+    struct intern_chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} intern_chunk_t;
+
+// Config parsing can run on a startup worker while the event loop creates workspaces
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static intern_chunk_t *chunks;
+static fde_hashmap_t strings;  // Keys point into the arena
+static size_t arena_bytes;
+
+// A chunk with room for `need` bytes at its tail
+static intern_chunk_t *reserve(size_t need) {
+    if (chunks && chunks->size - chunks->used >= need) {
+        return chunks;
+    }
+    size_t size = need > INTERN_CHUNK_SIZE ? need : INTERN_CHUNK_SIZE;
+    intern_chunk_t *chunk = malloc(sizeof(intern_chunk_t) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = chunks;
+    chunk->size = size;
+    chunk->used = 0;
+    chunks = chunk;
+    arena_bytes += size;
+    return chunk;
+}
+
+fde_istr_t fde_intern_len(const char *str, size_t len) {
+    if (!str || len > UINT32_MAX) {
+        return NULL;
+    }
+    // Prefix aligned to 4 bytes, so fde_istr_len() reads it in place
+    size_t need = sizeof(uint32_t) + len + 1;
+    need = (need + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+
+    pthread_mutex_lock(&intern_lock);
+    fde_istr_t result = NULL;
+    if (!strings.str_keys) {
+        fde_hashmap_init(&strings, true);
+    }
+    // Кандидат пишется в хвост арены; место занимается, только если строки ещё нет
+    intern_chunk_t *chunk = reserve(need);
+    if (!chunk) {
+        goto out;
+    }
+    char *slot = chunk->data + chunk->used;
+    uint32_t len32 = (uint32_t)len;
+    memcpy(slot, &len32, sizeof(len32));
+    char *chars = slot + sizeof(len32);
+    memcpy(chars, str, len);
+    chars[len] = '\0';
+
+    // Embedded NULs would make two strings share a key
+    if (strlen(chars) != len) {
+        goto out;
+    }
+    result = fde_hashmap_get_str(&strings, chars);
+    if (!result && fde_hashmap_set_str(&strings, chars, chars)) {
+        chunk->used += need;
+        result = chars;
+    }
+out:
+    pthread_mutex_unlock(&intern_lock);
+    if (!result) {
+        fde_log(FDE_ERROR, "Failed to intern a string of %zu bytes", len);
+    }
+    return result;
+}
+
+fde_istr_t fde_intern(const char *str) {
+    return str ? fde_intern_len(str, strlen(str)) : NULL;
+}
+
+void fde_intern_stats(size_t *count, size_t *bytes) {
+    pthread_mutex_lock(&intern_lock);
+    if (count) *count = strings.count;
+    if (bytes) *bytes = arena_bytes;
+    pthread_mutex_unlock(&intern_lock);
+}
+
+void fde_intern_finish(void) {
+    pthread_mutex_lock(&intern_lock);
+    if (strings.str_keys) {
+        fde_hashmap_finish(&strings);
+        strings = (fde_hashmap_t){0};
+    }
+    while (chunks) {
+        intern_chunk_t *chunk = chunks;
+        chunks = chunk->next;
+        free(chunk);
+    }
+    arena_bytes = 0;
+    pthread_mutex_unlock(&intern_lock);
+}
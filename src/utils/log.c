@@ -1,13 +1,39 @@
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <fde/utils/log.h>
 
+/*
+ * Asynchronous logger. The calling thread only copies a timestamp, the level, the format literal
+ * (call site id) and the raw arguments into its own single-producer ring; the writer thread walks the
+ * format string again, formats and writes whole batches to stderr. A full ring drops the message
+ * instead of waiting, so a slow stderr never stalls the compositor loop.
+ */
+
+#define LOG_RING_SIZE (64 * 1024)       // Per thread, power of two
+#define LOG_MAX_RECORD 4096
+#define LOG_MAX_STRING 1024
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_IDLE_POLL_MS 100
+#define LOG_FLUSH_TIMEOUT_MS 1000
+#define LOG_NULL_STRING UINT32_MAX
+
 static terminate_callback_t log_terminate = exit;
 
 void _fde_abort(const char *format, ...) {
@@ -15,6 +41,7 @@ void _fde_abort(const char *format, ...) {
 	va_start(args, format);
 	_fde_vlog(FDE_ERROR, format, args);
 	va_end(args);
+	fde_log_flush();
 	log_terminate(EXIT_FAILURE);
 }
 
@@ -29,6 +56,7 @@ bool _fde_assert(bool condition, const char *format, ...) {
 	va_end(args);
 
 #ifndef NDEBUG
+	fde_log_flush();
 	raise(SIGABRT);
 #endif
 
@@ -36,7 +64,35 @@ bool _fde_assert(bool condition, const char *format, ...) {
 }
 
 static bool colored = true;
-static fde_log_importance_t log_importance = FDE_ERROR;
+static bool use_colors = false;  // colored && stderr is a tty, checked once in fde_log_init
+
+_Atomic uint8_t fde_log_levels[FDE_LOG_SUBSYSTEM_LAST] = {
+	[FDE_LOG_CORE] = FDE_ERROR,
+	[FDE_LOG_OUTPUT] = FDE_ERROR,
+	[FDE_LOG_INPUT] = FDE_ERROR,
+	[FDE_LOG_DBUS] = FDE_ERROR,
+	[FDE_LOG_PLUGINS] = FDE_ERROR,
+	[FDE_LOG_CONFIG] = FDE_ERROR,
+	[FDE_LOG_WLR] = FDE_ERROR,
+};
+
+static const char *subsystem_names[] = {
+	[FDE_LOG_CORE] = "core",
+	[FDE_LOG_OUTPUT] = "output",
+	[FDE_LOG_INPUT] = "input",
+	[FDE_LOG_DBUS] = "dbus",
+	[FDE_LOG_PLUGINS] = "plugins",
+	[FDE_LOG_CONFIG] = "config",
+	[FDE_LOG_WLR] = "wlr",
+};
+
+static const char *importance_names[] = {
+	[FDE_SILENT] = "silent",
+	[FDE_ERROR] = "error",
+	[FDE_INFO] = "info",
+	[FDE_DEBUG] = "debug",
+};
+
 static struct timespec start_time = {-1, -1};
 
 static const char *verbosity_colors[] = {
@@ -53,6 +109,11 @@ static const char *verbosity_headers[] = {
 	[FDE_DEBUG] = "[DEBUG]",
 };
 
+static const char *log_prefixes[] = {
+	[LOG_PREFIX_NONE] = "",
+	[LOG_PREFIX_WLR] = "[wlr] ",
+};
+
 static void timespec_sub(struct timespec *r, const struct timespec *a,
 		const struct timespec *b) {
 	const long NSEC_PER_SEC = 1000000000;
@@ -71,13 +132,14 @@ static void init_start_time(void) {
 	clock_gettime(CLOCK_MONOTONIC, &start_time);
 }
 
-static void fde_log_stderr(fde_log_importance_t verbosity, const char *fmt,
-		va_list args) {
-	init_start_time();
+static unsigned clamp_verbosity(fde_log_importance_t verbosity) {
+	return (verbosity < FDE_LOG_IMPORTANCE_LAST) ? verbosity : FDE_LOG_IMPORTANCE_LAST - 1;
+}
 
-	if (verbosity > log_importance) {
-		return;
-	}
+// Synchronous path: before fde_log_init, in forked children and when a ring cannot be allocated
+static void fde_log_stderr(fde_log_importance_t verbosity, log_prefix_t prefix,
+		const char *fmt, va_list args) {
+	init_start_time();
 
 	struct timespec ts = {0};
 	clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -87,42 +149,831 @@ static void fde_log_stderr(fde_log_importance_t verbosity, const char *fmt,
 		(int)(ts.tv_sec / 60 % 60), (int)(ts.tv_sec % 60),
 		ts.tv_nsec / 1000000);
 
-	unsigned c = (verbosity < FDE_LOG_IMPORTANCE_LAST) ? verbosity :
-		FDE_LOG_IMPORTANCE_LAST - 1;
+	unsigned c = clamp_verbosity(verbosity);
 
-	if (colored && isatty(STDERR_FILENO)) {
+	if (use_colors) {
 		fprintf(stderr, "%s", verbosity_colors[c]);
 	} else {
 		fprintf(stderr, "%s ", verbosity_headers[c]);
 	}
 
+	fputs(log_prefixes[prefix], stderr);
 	vfprintf(stderr, fmt, args);
 
-	if (colored && isatty(STDERR_FILENO)) {
+	if (use_colors) {
 		fprintf(stderr, "\x1B[0m");
 	}
 	fprintf(stderr, "\n");
 }
 
+/* Format string walker, shared by the producer (capture) and the writer (format) */
+
+enum arg_kind {
+	ARG_NONE,  // "%%" or an unknown conversion
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR,
+};
+
+struct fmt_spec {
+	const char *start;  // '%'
+	size_t len;
+	bool star_width;
+	bool star_precision;
+	int precision;      // Literal precision, -1 if absent
+	char conv;
+	enum arg_kind kind;
+};
+
+// Finds the next conversion at or after p; returns the position after it, NULL when there is none
+static const char *next_spec(const char *p, struct fmt_spec *spec) {
+	const char *s = strchr(p, '%');
+	if (!s) {
+		return NULL;
+	}
+	const char *c = s + 1;
+	spec->start = s;
+	spec->star_width = spec->star_precision = false;
+	spec->precision = -1;
+
+	while (*c && strchr("-+ #0'", *c)) c++;
+	if (*c == '*') {
+		spec->star_width = true;
+		c++;
+	} else {
+		while (isdigit((unsigned char)*c)) c++;
+	}
+	if (*c == '.') {
+		c++;
+		if (*c == '*') {
+			spec->star_precision = true;
+			c++;
+		} else {
+			spec->precision = 0;
+			while (isdigit((unsigned char)*c)) {
+				spec->precision = spec->precision * 10 + (*c - '0');
+				c++;
+			}
+		}
+	}
+
+	enum arg_kind int_kind = ARG_INT;
+	bool long_double = false;
+	switch (*c) {
+	case 'h':
+		c += c[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		if (c[1] == 'l') {
+			int_kind = ARG_LLONG;
+			c += 2;
+		} else {
+			int_kind = ARG_LONG;
+			c++;
+		}
+		break;
+	case 'q':
+		int_kind = ARG_LLONG;
+		c++;
+		break;
+	case 'L':
+		long_double = true;
+		c++;
+		break;
+	case 'z':
+		int_kind = ARG_SIZE;
+		c++;
+		break;
+	case 'j':
+		int_kind = ARG_INTMAX;
+		c++;
+		break;
+	case 't':
+		int_kind = ARG_PTRDIFF;
+		c++;
+		break;
+	}
+
+	spec->conv = *c;
+	switch (*c) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		spec->kind = int_kind;
+		break;
+	case 'c':
+		spec->kind = ARG_INT;  // wint_t too
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		spec->kind = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		spec->kind = ARG_STR;
+		break;
+	case 'p': case 'n':
+		spec->kind = ARG_PTR;
+		break;
+	default:
+		spec->kind = ARG_NONE;
+		break;
+	}
+	if (*c) c++;
+	spec->len = (size_t)(c - s);
+	return c;
+}
+
+/* Per-thread rings */
+
+typedef struct log_record {
+	uint32_t size;       // Whole record, multiple of 8; 0 marks the unused tail before a wrap
+	uint8_t level;
+	uint8_t prefix;
+	uint8_t truncated;   // Arguments did not fit into LOG_MAX_RECORD
+	uint8_t pad;
+	uint64_t timestamp_ns;
+	const char *fmt;     // Call site: the format literal
+} log_record_t;          // + raw arguments
+
+typedef struct log_ring {
+	_Atomic size_t head;  // Written by the owning thread
+	_Atomic size_t tail;  // Written by the writer thread
+	_Atomic uint64_t dropped;
+	_Atomic bool orphaned;  // Owning thread exited, freed by the writer once drained
+	struct log_ring *next;
+	uint8_t buf[LOG_RING_SIZE];
+} log_ring_t;
+
+static struct {
+	pthread_mutex_t lock;  // Ring list; taken on a thread's first message and by the writer
+	log_ring_t *rings;
+	pthread_key_t ring_key;
+	pthread_t thread;
+	int wake_fd;
+	_Atomic bool running;
+	_Atomic bool idle;
+	_Atomic bool stopping;
+	_Atomic uint64_t dropped_total;
+} writer = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake_fd = -1,
+};
+
+static _Thread_local log_ring_t *thread_ring = NULL;
+static _Thread_local bool thread_ring_failed = false;
+
+static void release_thread_ring(void *data) {
+	log_ring_t *ring = data;
+	atomic_store_explicit(&ring->orphaned, true, memory_order_release);
+}
+
+static log_ring_t *get_thread_ring(void) {
+	if (thread_ring || thread_ring_failed) {
+		return thread_ring;
+	}
+	log_ring_t *ring = calloc(1, sizeof(log_ring_t));
+	if (!ring) {
+		thread_ring_failed = true;
+		return NULL;
+	}
+	pthread_mutex_lock(&writer.lock);
+	ring->next = writer.rings;
+	writer.rings = ring;
+	pthread_mutex_unlock(&writer.lock);
+	pthread_setspecific(writer.ring_key, ring);
+	thread_ring = ring;
+	return ring;
+}
+
+static inline size_t align8(size_t len) {
+	return (len + 7) & ~(size_t)7;
+}
+
+#define PUT(value) do { \
+	__typeof__(value) _v = (value); \
+	if (len + sizeof(_v) > LOG_MAX_RECORD) goto truncated; \
+	memcpy(scratch + len, &_v, sizeof(_v)); \
+	len += sizeof(_v); \
+} while (0)
+
+// Copies the arguments described by fmt; strings are copied since they may not outlive the call
+static size_t capture_args(uint8_t *scratch, size_t len, const char *fmt, va_list args, bool *is_truncated) {
+	struct fmt_spec spec;
+	const char *p = fmt;
+	while ((p = next_spec(p, &spec))) {
+		int precision = spec.precision;
+		if (spec.star_width) {
+			PUT((int64_t)va_arg(args, int));
+		}
+		if (spec.star_precision) {
+			precision = va_arg(args, int);
+			PUT((int64_t)precision);
+		}
+		switch (spec.kind) {
+		case ARG_NONE:
+			break;
+		case ARG_INT:
+			PUT((int64_t)va_arg(args, int));
+			break;
+		case ARG_LONG:
+			PUT((int64_t)va_arg(args, long));
+			break;
+		case ARG_LLONG:
+			PUT((int64_t)va_arg(args, long long));
+			break;
+		case ARG_SIZE:
+			PUT((int64_t)va_arg(args, size_t));
+			break;
+		case ARG_INTMAX:
+			PUT((int64_t)va_arg(args, intmax_t));
+			break;
+		case ARG_PTRDIFF:
+			PUT((int64_t)va_arg(args, ptrdiff_t));
+			break;
+		case ARG_DOUBLE:
+			PUT(va_arg(args, double));
+			break;
+		case ARG_LDOUBLE:
+			PUT(va_arg(args, long double));
+			break;
+		case ARG_PTR:
+			PUT(va_arg(args, void *));
+			break;
+		case ARG_STR: {
+			const char *str = va_arg(args, const char *);
+			if (!str) {
+				PUT((uint32_t)LOG_NULL_STRING);
+				break;
+			}
+			// %.*s is used on non NUL-terminated spans: never read past the precision
+			size_t str_len = precision >= 0 ? strnlen(str, (size_t)precision) : strlen(str);
+			if (str_len > LOG_MAX_STRING) str_len = LOG_MAX_STRING;
+			if (len + sizeof(uint32_t) + str_len > LOG_MAX_RECORD) goto truncated;
+			PUT((uint32_t)str_len);
+			memcpy(scratch + len, str, str_len);
+			len += str_len;
+			break;
+		}
+		}
+	}
+	return len;
+
+truncated:
+	*is_truncated = true;
+	return len;
+}
+
+#undef PUT
+
+static void wake_writer(void) {
+	if (atomic_exchange_explicit(&writer.idle, false, memory_order_acq_rel)) {
+		uint64_t one = 1;
+		ssize_t ret = write(writer.wake_fd, &one, sizeof(one));
+		(void)ret;  // EAGAIN: the writer is being woken up already
+	}
+}
+
+static bool ring_push(log_ring_t *ring, const uint8_t *record, size_t size) {
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t offset = head & (LOG_RING_SIZE - 1);
+	size_t contiguous = LOG_RING_SIZE - offset;
+	size_t needed = contiguous < size ? contiguous + size : size;
+
+	if (head + needed - tail > LOG_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&writer.dropped_total, 1, memory_order_relaxed);
+		return false;
+	}
+	if (contiguous < size) {
+		uint32_t wrap = 0;
+		memcpy(ring->buf + offset, &wrap, sizeof(wrap));
+		head += contiguous;
+	}
+	memcpy(ring->buf + (head & (LOG_RING_SIZE - 1)), record, size);
+	atomic_store_explicit(&ring->head, head + size, memory_order_release);
+	return true;
+}
+
+static void log_async(fde_log_importance_t verbosity, log_prefix_t prefix, const char *fmt, va_list args) {
+	log_ring_t *ring = get_thread_ring();
+	if (!ring) {
+		fde_log_stderr(verbosity, prefix, fmt, args);
+		return;
+	}
+
+	_Alignas(8) uint8_t scratch[LOG_MAX_RECORD];
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	bool truncated = false;
+	size_t len = capture_args(scratch, sizeof(log_record_t), fmt, args, &truncated);
+	log_record_t header = {
+		.size = (uint32_t)align8(len),
+		.level = (uint8_t)verbosity,
+		.prefix = (uint8_t)prefix,
+		.truncated = truncated,
+		.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec,
+		.fmt = fmt,
+	};
+	memcpy(scratch, &header, sizeof(header));
+
+	if (ring_push(ring, scratch, header.size)) {
+		wake_writer();
+	}
+}
+
+/* Writer thread */
+
+static struct {
+	char data[LOG_BATCH_SIZE];
+	size_t len;
+} batch;
+
+static void batch_flush(void) {
+	size_t off = 0;
+	while (off < batch.len) {
+		ssize_t n = write(STDERR_FILENO, batch.data + off, batch.len - off);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			break;  // stderr is gone: drop the batch
+		}
+		off += (size_t)n;
+	}
+	batch.len = 0;
+}
+
+static void batch_append(const char *data, size_t len) {
+	if (batch.len + len > sizeof(batch.data)) {
+		batch_flush();
+		if (len > sizeof(batch.data)) len = sizeof(batch.data);
+	}
+	memcpy(batch.data + batch.len, data, len);
+	batch.len += len;
+}
+
+static void batch_printf(const char *fmt, ...) ATTRIB_PRINTF(1, 2);
+static void batch_printf(const char *fmt, ...) {
+	char buf[LOG_MAX_STRING + 128];
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (n > 0) {
+		batch_append(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+	}
+}
+
+#define GET(type, out) ({ \
+	bool _ok = off + sizeof(type) <= end; \
+	if (_ok) memcpy(&(out), args + off, sizeof(type)); \
+	off += sizeof(type); \
+	_ok; \
+})
+
+// Rebuilds "%*.*d"-style specs with the captured width and precision substituted
+static void build_spec(char *out, size_t size, const struct fmt_spec *spec, int64_t width, int64_t precision) {
+	size_t o = 0;
+	bool first_star = true;
+	for (size_t i = 0; i < spec->len && o + 24 < size; i++) {
+		char c = spec->start[i];
+		if (c == '*') {
+			int64_t value = first_star && spec->star_width ? width : precision;
+			first_star = false;
+			o += (size_t)snprintf(out + o, size - o, "%lld", (long long)value);
+		} else {
+			out[o++] = c;
+		}
+	}
+	out[o] = '\0';
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static void format_record(const log_record_t *record) {
+	const uint8_t *args = (const uint8_t *)record;
+	size_t off = sizeof(log_record_t), end = record->size;
+
+	uint64_t rel_ns = record->timestamp_ns -
+		((uint64_t)start_time.tv_sec * 1000000000ULL + (uint64_t)start_time.tv_nsec);
+	uint64_t sec = rel_ns / 1000000000ULL;
+	batch_printf("%02d:%02d:%02d.%03ld ", (int)(sec / 60 / 60), (int)(sec / 60 % 60), (int)(sec % 60),
+		(long)(rel_ns % 1000000000ULL / 1000000));
+
+	unsigned c = clamp_verbosity(record->level);
+	if (use_colors) {
+		batch_printf("%s", verbosity_colors[c]);
+	} else {
+		batch_printf("%s ", verbosity_headers[c]);
+	}
+	batch_printf("%s", log_prefixes[record->prefix < LOG_PREFIX_LAST ? record->prefix : LOG_PREFIX_NONE]);
+
+	const char *p = record->fmt;
+	struct fmt_spec spec;
+	const char *next;
+	while ((next = next_spec(p, &spec))) {
+		batch_append(p, (size_t)(spec.start - p));
+		p = next;
+
+		int64_t width = 0, precision = -1;
+		if (spec.star_width && !GET(int64_t, width)) goto out_of_args;
+		if (spec.star_precision && !GET(int64_t, precision)) goto out_of_args;
+
+		char fmt[64];
+		build_spec(fmt, sizeof(fmt), &spec, width, precision);
+
+		int64_t i = 0;
+		double d = 0;
+		long double ld = 0;
+		void *ptr = NULL;
+		switch (spec.kind) {
+		case ARG_NONE:
+			if (spec.conv == '%') batch_append("%", 1);
+			break;
+		case ARG_INT:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (int)i);
+			break;
+		case ARG_LONG:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (long)i);
+			break;
+		case ARG_LLONG:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (long long)i);
+			break;
+		case ARG_SIZE:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (size_t)i);
+			break;
+		case ARG_INTMAX:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (intmax_t)i);
+			break;
+		case ARG_PTRDIFF:
+			if (!GET(int64_t, i)) goto out_of_args;
+			batch_printf(fmt, (ptrdiff_t)i);
+			break;
+		case ARG_DOUBLE:
+			if (!GET(double, d)) goto out_of_args;
+			batch_printf(fmt, d);
+			break;
+		case ARG_LDOUBLE:
+			if (!GET(long double, ld)) goto out_of_args;
+			batch_printf(fmt, ld);
+			break;
+		case ARG_PTR:
+			if (!GET(void *, ptr)) goto out_of_args;
+			if (spec.conv == 'p') batch_printf(fmt, ptr);
+			break;
+		case ARG_STR: {
+			uint32_t str_len = 0;
+			if (!GET(uint32_t, str_len)) goto out_of_args;
+			if (str_len == LOG_NULL_STRING) {
+				batch_printf(fmt, (const char *)NULL);
+				break;
+			}
+			if (off + str_len > end) goto out_of_args;
+			char str[LOG_MAX_STRING + 1];
+			memcpy(str, args + off, str_len);
+			str[str_len] = '\0';
+			off += str_len;
+			batch_printf(fmt, str);
+			break;
+		}
+		}
+	}
+	batch_append(p, strlen(p));
+	goto done;
+
+out_of_args:
+	batch_append("...", 3);
+done:
+	if (record->truncated) {
+		batch_append(" [truncated]", 12);
+	}
+	if (use_colors) {
+		batch_append("\x1B[0m", 4);
+	}
+	batch_append("\n", 1);
+}
+#pragma GCC diagnostic pop
+
+#undef GET
+
+// Returns true when any record was consumed
+static bool drain_ring(log_ring_t *ring) {
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	bool consumed = tail != head;
+
+	uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+	if (dropped) {
+		batch_printf("[log] %llu message(s) dropped: ring buffer full\n", (unsigned long long)dropped);
+	}
+
+	while (tail != head) {
+		size_t offset = tail & (LOG_RING_SIZE - 1);
+		log_record_t record;
+		memcpy(&record, ring->buf + offset, sizeof(uint32_t));
+		if (record.size == 0) {
+			tail += LOG_RING_SIZE - offset;
+			continue;
+		}
+		format_record((const log_record_t *)(ring->buf + offset));
+		tail += record.size;
+	}
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	return consumed;
+}
+
+static bool drain_all(void) {
+	bool consumed = false;
+	pthread_mutex_lock(&writer.lock);
+	log_ring_t **link = &writer.rings;
+	while (*link) {
+		log_ring_t *ring = *link;
+		bool orphaned = atomic_load_explicit(&ring->orphaned, memory_order_acquire);
+		consumed |= drain_ring(ring);
+		if (orphaned) {
+			*link = ring->next;
+			free(ring);
+		} else {
+			link = &ring->next;
+		}
+	}
+	pthread_mutex_unlock(&writer.lock);
+	batch_flush();
+	return consumed;
+}
+
+static void flush_quiet_sites(void);
+
+static void *writer_main(void *data) {
+	(void)data;
+	sigset_t mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	for (;;) {
+		flush_quiet_sites();
+		if (drain_all()) {
+			continue;
+		}
+		if (atomic_load(&writer.stopping)) {
+			break;
+		}
+		// Producers only pay for the eventfd write when the writer went idle
+		atomic_store(&writer.idle, true);
+		if (drain_all()) {
+			atomic_store(&writer.idle, false);
+			continue;
+		}
+		struct pollfd pfd = { .fd = writer.wake_fd, .events = POLLIN };
+		if (poll(&pfd, 1, LOG_IDLE_POLL_MS) > 0) {
+			uint64_t count;
+			ssize_t ret = read(writer.wake_fd, &count, sizeof(count));
+			(void)ret;
+		}
+		atomic_store(&writer.idle, false);
+	}
+	return NULL;
+}
+
+static void after_fork_child(void) {
+	// The writer thread does not exist in the child
+	atomic_store(&writer.running, false);
+}
+
+static bool rings_empty(void) {
+	bool empty = true;
+	pthread_mutex_lock(&writer.lock);
+	for (log_ring_t *ring = writer.rings; ring; ring = ring->next) {
+		if (atomic_load(&ring->head) != atomic_load(&ring->tail)) {
+			empty = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&writer.lock);
+	return empty;
+}
+
+void fde_log_flush(void) {
+	if (!atomic_load(&writer.running)) {
+		return;
+	}
+	atomic_store(&writer.idle, true);
+	wake_writer();
+	for (int waited = 0; waited < LOG_FLUSH_TIMEOUT_MS && !rings_empty(); waited++) {
+		struct timespec ms = { 0, 1000000 };
+		nanosleep(&ms, NULL);
+	}
+}
+
+/* Rate-limited call sites */
+
+static pthread_mutex_t sites_lock = PTHREAD_MUTEX_INITIALIZER;
+static fde_log_site_t *sites = NULL;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void log_repeated(const fde_log_site_t *site, uint64_t repeated) {
+	_fde_log(site->verbosity, "[%s:%d] Previous message repeated %llu times (rate limited)",
+		site->file, site->line, (unsigned long long)repeated);
+}
+
+// Under sites_lock
+static void site_refill(fde_log_site_t *site, uint64_t now) {
+	const uint64_t refill_period = 1000000000ULL / FDE_LOG_RATELIMIT_PER_SEC;
+	uint64_t refill = (now - site->refill_ns) / refill_period;
+	if (refill) {
+		site->tokens = site->tokens + refill >= FDE_LOG_RATELIMIT_BURST
+			? FDE_LOG_RATELIMIT_BURST : site->tokens + (uint32_t)refill;
+		site->refill_ns += refill * refill_period;
+	}
+}
+
+bool _fde_log_site_allow(fde_log_site_t *site, fde_log_importance_t verbosity) {
+	uint64_t now = monotonic_ns();
+
+	pthread_mutex_lock(&sites_lock);
+	if (!site->registered) {
+		site->registered = true;
+		site->tokens = FDE_LOG_RATELIMIT_BURST;
+		site->refill_ns = now;
+		site->next = sites;
+		sites = site;
+	}
+	site_refill(site, now);
+
+	uint64_t repeated = 0;
+	bool allow = site->tokens > 0;
+	if (allow) {
+		site->tokens--;
+		repeated = site->suppressed;
+		site->suppressed = 0;
+	} else {
+		site->suppressed++;
+		site->suppressed_total++;
+	}
+	site->verbosity = verbosity;
+	pthread_mutex_unlock(&sites_lock);
+
+	if (repeated) {
+		log_repeated(site, repeated);
+	}
+	return allow;
+}
+
+void fde_log_for_each_site(fde_log_site_iter_t iter, void *data) {
+	pthread_mutex_lock(&sites_lock);
+	for (fde_log_site_t *site = sites; site; site = site->next) {
+		iter(site, data);
+	}
+	pthread_mutex_unlock(&sites_lock);
+}
+
+// Summaries that are still pending when the source went quiet
+static void flush_repeated(void) {
+	pthread_mutex_lock(&sites_lock);
+	for (fde_log_site_t *site = sites; site; site = site->next) {
+		if (site->suppressed) {
+			log_repeated(site, site->suppressed);
+			site->suppressed = 0;
+		}
+	}
+	pthread_mutex_unlock(&sites_lock);
+}
+
+// Writer thread: a site whose bucket refilled has been quiet for a while, its summary would
+// otherwise wait for the next message from that site
+static void flush_quiet_sites(void) {
+	static uint64_t last_check_ns = 0;
+	uint64_t now = monotonic_ns();
+	if (now - last_check_ns < LOG_IDLE_POLL_MS * 1000000ULL) {
+		return;
+	}
+	last_check_ns = now;
+
+	pthread_mutex_lock(&sites_lock);
+	for (fde_log_site_t *site = sites; site; site = site->next) {
+		if (!site->suppressed) {
+			continue;
+		}
+		site_refill(site, now);
+		if (site->tokens == FDE_LOG_RATELIMIT_BURST) {
+			log_repeated(site, site->suppressed);
+			site->suppressed = 0;
+		}
+	}
+	pthread_mutex_unlock(&sites_lock);
+}
+
+void fde_log_finish(void) {
+	flush_repeated();
+	if (!atomic_load(&writer.running)) {
+		return;
+	}
+	atomic_store(&writer.stopping, true);
+	atomic_store(&writer.idle, true);
+	wake_writer();
+	pthread_join(writer.thread, NULL);
+	atomic_store(&writer.running, false);
+}
+
+uint64_t fde_log_dropped(void) {
+	return atomic_load_explicit(&writer.dropped_total, memory_order_relaxed);
+}
+
+static bool start_writer(void) {
+	if (pthread_key_create(&writer.ring_key, release_thread_ring) != 0) {
+		return false;
+	}
+	writer.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (writer.wake_fd < 0) {
+		return false;
+	}
+	if (pthread_create(&writer.thread, NULL, writer_main, NULL) != 0) {
+		close(writer.wake_fd);
+		writer.wake_fd = -1;
+		return false;
+	}
+	pthread_atfork(NULL, NULL, after_fork_child);
+	atomic_store(&writer.running, true);
+	atexit(fde_log_finish);
+	return true;
+}
+
 void fde_log_init(fde_log_importance_t verbosity, terminate_callback_t callback) {
 	init_start_time();
+	use_colors = colored && isatty(STDERR_FILENO);
 
 	if (verbosity < FDE_LOG_IMPORTANCE_LAST) {
-		log_importance = verbosity;
+		for (int i = 0; i < FDE_LOG_SUBSYSTEM_LAST; i++) {
+			atomic_store_explicit(&fde_log_levels[i], (uint8_t)verbosity, memory_order_relaxed);
+		}
 	}
 	if (callback) {
 		log_terminate = callback;
 	}
+	if (!atomic_load(&writer.running) && !start_writer()) {
+		fprintf(stderr, "Failed to start the log writer thread, logging synchronously\n");
+	}
+}
+
+const char *fde_log_subsystem_name(fde_log_subsystem_t subsystem) {
+	return subsystem < FDE_LOG_SUBSYSTEM_LAST ? subsystem_names[subsystem] : "unknown";
+}
+
+const char *fde_log_importance_name(fde_log_importance_t importance) {
+	return importance < FDE_LOG_IMPORTANCE_LAST ? importance_names[importance] : "unknown";
+}
+
+bool fde_log_set_level(const char *subsystem, const char *level) {
+	int importance = -1;
+	for (int i = 0; i < FDE_LOG_IMPORTANCE_LAST; i++) {
+		if (strcmp(level, importance_names[i]) == 0) importance = i;
+	}
+	if (importance < 0) {
+		return false;
+	}
+
+	bool all = strcmp(subsystem, "all") == 0;
+	bool found = all;
+	for (int i = 0; i < FDE_LOG_SUBSYSTEM_LAST; i++) {
+		if (all || strcmp(subsystem, subsystem_names[i]) == 0) {
+			atomic_store_explicit(&fde_log_levels[i], (uint8_t)importance, memory_order_relaxed);
+			found = true;
+		}
+	}
+	return found;
+}
+
+// Level checks happen at the call site (fde_log_enabled)
+static void log_message(fde_log_importance_t verbosity, log_prefix_t prefix, const char *fmt, va_list args) {
+	if (atomic_load_explicit(&writer.running, memory_order_relaxed)) {
+		log_async(verbosity, prefix, fmt, args);
+	} else {
+		fde_log_stderr(verbosity, prefix, fmt, args);
+	}
 }
 
 void _fde_vlog(fde_log_importance_t verbosity, const char *fmt, va_list args) {
-	fde_log_stderr(verbosity, fmt, args);
+	log_message(verbosity, LOG_PREFIX_NONE, fmt, args);
 }
 
 void _fde_log(fde_log_importance_t verbosity, const char *fmt, ...) {
 	va_list args;
 	va_start(args, fmt);
-	fde_log_stderr(verbosity, fmt, args);
+	log_message(verbosity, LOG_PREFIX_NONE, fmt, args);
 	va_end(args);
 }
 
@@ -138,7 +989,9 @@ fde_log_importance_t convert_wlr_log_importance(enum wlr_log_importance importan
 }
 
 void handle_wlr_log(enum wlr_log_importance importance, const char *fmt, va_list args) {
-	static char fde_fmt[1024];
-	snprintf(fde_fmt, sizeof(fde_fmt), "[wlr] %s", fmt);
-	_fde_vlog(convert_wlr_log_importance(importance), fde_fmt, args);
-}
\ No newline at end of file
+	fde_log_importance_t verbosity = convert_wlr_log_importance(importance);
+	if (verbosity > atomic_load_explicit(&fde_log_levels[FDE_LOG_WLR], memory_order_relaxed)) {
+		return;
+	}
+	log_message(verbosity, LOG_PREFIX_WLR, fmt, args);
+}
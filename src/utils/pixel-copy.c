@@ -0,0 +1,76 @@
+#include <drm_fourcc.h>
+#include <string.h>
+
+#include <fde/utils/pixel-copy.h>
+
+// 8 pixels: two SSE registers, one AVX2 register
+typedef uint32_t px8_t __attribute__((vector_size(32)));
+
+#define OPAQUE 0xff000000u
+
+static bool is_known(uint32_t format) {
+    return format == DRM_FORMAT_XRGB8888 || format == DRM_FORMAT_ARGB8888 ||
+        format == DRM_FORMAT_XBGR8888 || format == DRM_FORMAT_ABGR8888;
+}
+
+static bool is_bgr(uint32_t format) {
+    return format == DRM_FORMAT_XBGR8888 || format == DRM_FORMAT_ABGR8888;
+}
+
+static bool has_alpha(uint32_t format) {
+    return format == DRM_FORMAT_ARGB8888 || format == DRM_FORMAT_ABGR8888;
+}
+
+bool fde_pixel_copy_supported(uint32_t dst_format, uint32_t src_format) {
+    return is_known(dst_format) && is_known(src_format);
+}
+
+// Little-endian words: 0xAARRGGBB <-> 0xAABBGGRR
+static inline uint32_t swap_rb(uint32_t pixel) {
+    return (pixel & 0xff00ff00u) | ((pixel >> 16) & 0xffu) | ((pixel & 0xffu) << 16);
+}
+
+static void row_swap_rb(uint32_t *restrict dst, const uint32_t *restrict src, int count, uint32_t alpha) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        px8_t v;
+        memcpy(&v, src + i, sizeof(v));
+        v = (v & 0xff00ff00u) | ((v >> 16) & 0xffu) | ((v & 0xffu) << 16) | alpha;
+        memcpy(dst + i, &v, sizeof(v));
+    }
+    for (; i < count; i++) {
+        dst[i] = swap_rb(src[i]) | alpha;
+    }
+}
+
+static void row_set_alpha(uint32_t *restrict dst, const uint32_t *restrict src, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        px8_t v;
+        memcpy(&v, src + i, sizeof(v));
+        v |= OPAQUE;
+        memcpy(dst + i, &v, sizeof(v));
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i] | OPAQUE;
+    }
+}
+
+void fde_pixel_copy(void *dst, size_t dst_stride, uint32_t dst_format,
+        const void *src, size_t src_stride, uint32_t src_format, int width, int height) {
+    uint32_t alpha = has_alpha(dst_format) && !has_alpha(src_format) ? OPAQUE : 0;
+    bool swap = is_bgr(dst_format) != is_bgr(src_format);
+    size_t row_bytes = (size_t)width * 4;
+
+    char *d = dst;
+    const char *s = src;
+    for (int y = 0; y < height; y++, d += dst_stride, s += src_stride) {
+        if (swap) {
+            row_swap_rb((uint32_t *)d, (const uint32_t *)s, width, alpha);
+        } else if (alpha) {
+            row_set_alpha((uint32_t *)d, (const uint32_t *)s, width);
+        } else {
+            memcpy(d, s, row_bytes);
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <fde/utils/log.h>
+#include <fde/utils/pool.h>
+
+// The header takes the first cache line of a slab, objects follow
+struct fde_pool_slab {
+    fde_pool_slab_t *next;
+};
+
+static fde_pool_t *pools;  // Registry for counters
+
+static inline char *slab_objects(fde_pool_slab_t *slab) {
+    return (char *)slab + FDE_POOL_CACHE_LINE;
+}
+
+static void pool_setup(fde_pool_t *pool) {
+    size_t size = pool->object_size < sizeof(void *) ? sizeof(void *) : pool->object_size;
+    pool->stride = (size + FDE_POOL_CACHE_LINE - 1) & ~(size_t)(FDE_POOL_CACHE_LINE - 1);
+    pool->per_slab = (FDE_POOL_SLAB_SIZE - FDE_POOL_CACHE_LINE) / pool->stride;
+    if (pool->per_slab == 0) {
+        pool->per_slab = 1;
+    }
+    pool->registered = true;
+    pool->next = pools;
+    pools = pool;
+}
+
+// Objects of the new slab go to the free list in address order
+static bool pool_grow(fde_pool_t *pool) {
+    fde_pool_slab_t *slab = aligned_alloc(FDE_POOL_CACHE_LINE, FDE_POOL_CACHE_LINE + pool->per_slab * pool->stride);
+    if (!slab) {
+        fde_log(FDE_ERROR, "Pool %s: out of memory", pool->name);
+        return false;
+    }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->num_slabs++;
+
+    char *objects = slab_objects(slab);
+    for (size_t i = pool->per_slab; i-- > 0;) {
+        void **object = (void **)(objects + i * pool->stride);
+#if FDE_POOL_DEBUG
+        memset(object, FDE_POOL_POISON, pool->stride);
+#endif
+        *object = pool->free_list;
+        pool->free_list = object;
+    }
+    return true;
+}
+
+#if FDE_POOL_DEBUG
+static bool is_poisoned(const fde_pool_t *pool, const void *object, size_t *bad_offset) {
+    const unsigned char *bytes = object;
+    for (size_t i = sizeof(void *); i < pool->stride; i++) {
+        if (bytes[i] != FDE_POOL_POISON) {
+            if (bad_offset) *bad_offset = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool owns(const fde_pool_t *pool, const void *object) {
+    for (fde_pool_slab_t *slab = pool->slabs; slab; slab = slab->next) {
+        const char *objects = slab_objects(slab);
+        if ((const char *)object >= objects && (const char *)object < objects + pool->per_slab * pool->stride) {
+            return ((const char *)object - objects) % pool->stride == 0;
+        }
+    }
+    return false;
+}
+
+static bool in_free_list(const fde_pool_t *pool, const void *object) {
+    for (void *it = pool->free_list; it; it = *(void **)it) {
+        if (it == object) return true;
+    }
+    return false;
+}
+#endif
+
+void *fde_pool_alloc(fde_pool_t *pool) {
+    if (!pool->registered) {
+        pool_setup(pool);
+    }
+    if (!pool->free_list && !pool_grow(pool)) {
+        return NULL;
+    }
+
+    void *object = pool->free_list;
+    pool->free_list = *(void **)object;
+#if FDE_POOL_DEBUG
+    size_t offset;
+    if (!is_poisoned(pool, object, &offset)) {
+        fde_log(FDE_ERROR, "Pool %s: object %p was written after free (byte %zu)", pool->name, object, offset);
+    }
+#endif
+    memset(object, 0, pool->stride);
+
+    pool->allocs++;
+    if (++pool->live > pool->peak) {
+        pool->peak = pool->live;
+    }
+    return object;
+}
+
+void fde_pool_free(fde_pool_t *pool, void *object) {
+    if (!object) {
+        return;
+    }
+#if FDE_POOL_DEBUG
+    if (!owns(pool, object)) {
+        fde_log(FDE_ERROR, "Pool %s: %p was not allocated from this pool", pool->name, object);
+        abort();
+    }
+    if (is_poisoned(pool, object, NULL) && in_free_list(pool, object)) {
+        fde_log(FDE_ERROR, "Pool %s: double free of %p", pool->name, object);
+        abort();
+    }
+    memset(object, FDE_POOL_POISON, pool->stride);
+#endif
+    *(void **)object = pool->free_list;
+    pool->free_list = object;
+    pool->frees++;
+    pool->live--;
+}
+
+size_t fde_pool_reserved_bytes(const fde_pool_t *pool) {
+    return pool->num_slabs * (FDE_POOL_CACHE_LINE + pool->per_slab * pool->stride);
+}
+
+void fde_pool_for_each(fde_pool_iter_t iter, void *data) {
+    for (fde_pool_t *pool = pools; pool; pool = pool->next) {
+        iter(pool, data);
+    }
+}
+
+void fde_pool_finish_all(void) {
+    for (fde_pool_t *pool = pools; pool; pool = pool->next) {
+        if (pool->live) {
+            // Живые объекты ещё могут использоваться при выходе: память не освобождаем
+            fde_log(FDE_INFO, "Pool %s: %zu object(s) still allocated at exit", pool->name, pool->live);
+            continue;
+        }
+        while (pool->slabs) {
+            fde_pool_slab_t *slab = pool->slabs;
+            pool->slabs = slab->next;
+            free(slab);
+        }
+        pool->num_slabs = 0;
+        pool->free_list = NULL;
+    }
+}
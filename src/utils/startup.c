@@ -0,0 +1,79 @@
+#include <time.h>
+
+#include <fde/utils/startup.h>
+
+static const char *phase_names[] = {
+    [FDE_STARTUP_CONFIG] = "config",
+    [FDE_STARTUP_DISPLAY] = "display",
+    [FDE_STARTUP_BACKEND] = "backend",
+    [FDE_STARTUP_RENDERER] = "renderer",
+    [FDE_STARTUP_ALLOCATOR] = "allocator",
+    [FDE_STARTUP_GLOBALS] = "globals",
+    [FDE_STARTUP_SEAT] = "seat",
+    [FDE_STARTUP_BACKEND_START] = "backend_start",
+    [FDE_STARTUP_SOCKET] = "socket",
+    [FDE_STARTUP_DBUS] = "dbus",
+    [FDE_STARTUP_PLUGINS] = "plugins",
+    [FDE_STARTUP_FIRST_FRAME] = "first_frame",
+};
+
+// Все отметки ставятся из главного потока
+static struct {
+    uint64_t start_ns;
+    uint64_t last_ns;
+    bool report;
+    int count;
+    fde_startup_phase_t order[FDE_STARTUP_PHASE_LAST];
+    uint64_t duration_ns[FDE_STARTUP_PHASE_LAST];
+    uint64_t end_ns[FDE_STARTUP_PHASE_LAST];  // Since start, 0 = not reached
+} startup;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void fde_startup_init(bool report) {
+    startup.start_ns = startup.last_ns = monotonic_ns();
+    startup.report = report;
+}
+
+void fde_startup_mark(fde_startup_phase_t phase) {
+    if (phase >= FDE_STARTUP_PHASE_LAST || !startup.start_ns || startup.end_ns[phase]) {
+        return;
+    }
+    uint64_t now = monotonic_ns();
+    startup.duration_ns[phase] = now - startup.last_ns;
+    startup.end_ns[phase] = now - startup.start_ns ?: 1;
+    startup.order[startup.count++] = phase;
+    startup.last_ns = now;
+
+    if (phase == FDE_STARTUP_FIRST_FRAME && startup.report) {
+        fde_startup_report(stderr);
+    }
+}
+
+bool fde_startup_reached(fde_startup_phase_t phase) {
+    return phase < FDE_STARTUP_PHASE_LAST && startup.end_ns[phase];
+}
+
+void fde_startup_for_each_phase(fde_startup_iter_t iter, void *data) {
+    for (int i = 0; i < startup.count; i++) {
+        fde_startup_phase_t phase = startup.order[i];
+        iter(phase_names[phase], startup.duration_ns[phase] / 1000, startup.end_ns[phase] / 1000, data);
+    }
+}
+
+static void report_phase(const char *phase, uint64_t duration_usec, uint64_t end_usec, void *data) {
+    fprintf(data, "  %-14s %10.3f ms %10.3f ms\n", phase, duration_usec / 1000.0, end_usec / 1000.0);
+}
+
+void fde_startup_report(FILE *out) {
+    fprintf(out, "Startup report:\n  %-14s %13s %13s\n", "phase", "duration", "at");
+    fde_startup_for_each_phase(report_phase, out);
+    if (startup.end_ns[FDE_STARTUP_FIRST_FRAME]) {
+        fprintf(out, "Time to first frame: %.3f ms\n", startup.end_ns[FDE_STARTUP_FIRST_FRAME] / 1e6);
+    }
+    fflush(out);
+}
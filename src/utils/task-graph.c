@@ -0,0 +1,266 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fde/utils/log.h>
+#include <fde/utils/task-graph.h>
+#include <fde/utils/trace.h>
+#include <fde/utils/workqueue.h>
+
+typedef enum {
+    TASK_PENDING = 0,
+    TASK_RUNNING,       // Queued on the workqueue
+    TASK_WORKER_OK,     // Finished on a worker, not yet seen by the event loop
+    TASK_WORKER_FAILED,
+    TASK_DONE,
+    TASK_FAILED,
+} task_state_t;
+
+typedef struct task {
+    fde_task_graph_t *graph;
+    const char *name;
+    fde_task_kind_t kind;
+    fde_task_fn_t fn;
+    void *data;
+    uint64_t deps;
+    bool required;
+    bool signalled;     // Milestone reached
+    _Atomic int state;  // task_state_t
+    uint64_t start_ns;
+} task_t;
+
+struct fde_task_graph {
+    task_t tasks[FDE_TASK_GRAPH_MAX_TASKS];
+    int count;
+    uint64_t done_mask;
+    uint64_t failed_mask;
+    int finished;
+    bool ok;
+    bool started;
+
+    int threads;
+    fde_workqueue_t *wq;  // Created with the first worker task
+    int event_fd;
+    struct wl_event_source *event_source;
+
+    fde_task_graph_done_fn_t done;
+    void *done_data;
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void finish_task(fde_task_graph_t *graph, int id, bool success) {
+    task_t *task = &graph->tasks[id];
+    atomic_store_explicit(&task->state, success ? TASK_DONE : TASK_FAILED, memory_order_relaxed);
+    graph->finished++;
+    if (success) {
+        graph->done_mask |= FDE_TASK_DEP(id);
+        fde_log(FDE_DEBUG, "Task %s finished in %.3f ms", task->name,
+            task->start_ns ? (monotonic_ns() - task->start_ns) / 1e6 : 0.0);
+        return;
+    }
+    graph->failed_mask |= FDE_TASK_DEP(id);
+    if (task->required) {
+        graph->ok = false;
+    }
+}
+
+static bool run_task(task_t *task) {
+    fde_trace_site_t *trace __attribute__((cleanup(fde_trace_scope_end))) =
+        fde_trace_active() ? fde_trace_scope_begin(fde_trace_site(task->name)) : NULL;
+    return task->fn ? task->fn(task->data) : true;
+}
+
+static void run_worker_task(void *data) {
+    task_t *task = data;
+    bool success = run_task(task);
+    atomic_store_explicit(&task->state, success ? TASK_WORKER_OK : TASK_WORKER_FAILED, memory_order_release);
+
+    uint64_t one = 1;
+    if (write(task->graph->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        fde_log(FDE_ERROR, "Failed to wake the event loop for task %s: %s", task->name, strerror(errno));
+    }
+}
+
+static bool queue_worker_task(fde_task_graph_t *graph, task_t *task) {
+    if (!graph->wq && !(graph->wq = fde_workqueue_create(graph->threads))) {
+        return false;
+    }
+    atomic_store_explicit(&task->state, TASK_RUNNING, memory_order_relaxed);
+    return fde_workqueue_push(graph->wq, run_worker_task, task);
+}
+
+// Starts everything that became ready; main tasks run inline, so one pass can unlock the next
+static void schedule(fde_task_graph_t *graph) {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int id = 0; id < graph->count; id++) {
+            task_t *task = &graph->tasks[id];
+            if (atomic_load_explicit(&task->state, memory_order_relaxed) != TASK_PENDING) {
+                continue;
+            }
+            if (task->deps & graph->failed_mask) {
+                fde_log(FDE_ERROR, "Skipping startup task %s: a dependency failed", task->name);
+                finish_task(graph, id, false);
+                progress = true;
+                continue;
+            }
+            if (task->deps & ~graph->done_mask) {
+                continue;
+            }
+            if (task->kind == FDE_TASK_MILESTONE) {
+                if (task->signalled) {
+                    finish_task(graph, id, true);
+                    progress = true;
+                }
+                continue;
+            }
+
+            task->start_ns = monotonic_ns();
+            if (task->kind == FDE_TASK_WORKER) {
+                if (!queue_worker_task(graph, task)) {
+                    // Без рабочих потоков задача выполняется в главном
+                    fde_log(FDE_ERROR, "Cannot queue task %s, running it inline", task->name);
+                    finish_task(graph, id, run_task(task));
+                }
+            } else {
+                bool success = run_task(task);
+                if (!success) {
+                    fde_log(FDE_ERROR, "Startup task %s failed", task->name);
+                }
+                finish_task(graph, id, success);
+            }
+            progress = true;
+        }
+    }
+}
+
+// true if the graph was destroyed
+static bool check_finished(fde_task_graph_t *graph) {
+    if (graph->finished < graph->count) {
+        return false;
+    }
+    if (graph->done) {
+        graph->done(graph->ok, graph->done_data);
+    }
+    fde_task_graph_destroy(graph);
+    return true;
+}
+
+static int handle_worker_done(int fd, uint32_t mask, void *data) {
+    fde_task_graph_t *graph = data;
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        fde_log(FDE_ERROR, "Failed to read task graph eventfd: %s", strerror(errno));
+    }
+
+    for (int id = 0; id < graph->count; id++) {
+        int state = atomic_load_explicit(&graph->tasks[id].state, memory_order_acquire);
+        if (state == TASK_WORKER_OK || state == TASK_WORKER_FAILED) {
+            if (state == TASK_WORKER_FAILED) {
+                fde_log(FDE_ERROR, "Startup task %s failed", graph->tasks[id].name);
+            }
+            finish_task(graph, id, state == TASK_WORKER_OK);
+        }
+    }
+    schedule(graph);
+    check_finished(graph);
+    return 0;
+}
+
+fde_task_graph_t *fde_task_graph_create(struct wl_event_loop *loop, int threads,
+        fde_task_graph_done_fn_t done, void *data) {
+    fde_task_graph_t *graph = calloc(1, sizeof(fde_task_graph_t));
+    if (!graph) {
+        return NULL;
+    }
+    graph->threads = threads;
+    graph->ok = true;
+    graph->done = done;
+    graph->done_data = data;
+    graph->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (graph->event_fd < 0) {
+        fde_log(FDE_ERROR, "Failed to create task graph eventfd: %s", strerror(errno));
+        free(graph);
+        return NULL;
+    }
+    graph->event_source = wl_event_loop_add_fd(loop, graph->event_fd, WL_EVENT_READABLE, handle_worker_done, graph);
+    if (!graph->event_source) {
+        close(graph->event_fd);
+        free(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+int fde_task_graph_add(fde_task_graph_t *graph, const char *name, fde_task_kind_t kind,
+        fde_task_fn_t fn, void *data, uint64_t deps, bool required) {
+    if (graph->started || graph->count >= FDE_TASK_GRAPH_MAX_TASKS || (deps >> graph->count)) {
+        fde_log(FDE_ERROR, "Cannot add task %s to the startup graph", name);
+        return -1;
+    }
+    int id = graph->count++;
+    graph->tasks[id] = (task_t){
+        .graph = graph,
+        .name = name,
+        .kind = kind,
+        .fn = fn,
+        .data = data,
+        .deps = deps,
+        .required = required,
+    };
+    return id;
+}
+
+bool fde_task_graph_start(fde_task_graph_t *graph) {
+    graph->started = true;
+    schedule(graph);
+    bool ok = graph->ok;
+    check_finished(graph);
+    return ok;
+}
+
+void fde_task_graph_complete(fde_task_graph_t *graph, int milestone) {
+    if (!graph || milestone < 0 || milestone >= graph->count ||
+            graph->tasks[milestone].kind != FDE_TASK_MILESTONE ||
+            atomic_load_explicit(&graph->tasks[milestone].state, memory_order_relaxed) != TASK_PENDING) {
+        return;
+    }
+    // Засчитывается, когда готовы и его зависимости
+    graph->tasks[milestone].signalled = true;
+    schedule(graph);
+    check_finished(graph);
+}
+
+bool fde_task_graph_destroy(fde_task_graph_t *graph) {
+    if (!graph) {
+        return true;
+    }
+    wl_event_source_remove(graph->event_source);
+    if (graph->wq && !fde_workqueue_wait_timeout(graph->wq, FDE_TASK_GRAPH_JOIN_TIMEOUT_MS)) {
+        // Зависшая задача (например, dbus_bus_get) не должна держать выход: task_t и eventfd остаются ей
+        for (int id = 0; id < graph->count; id++) {
+            if (atomic_load_explicit(&graph->tasks[id].state, memory_order_relaxed) == TASK_RUNNING) {
+                fde_log(FDE_ERROR, "Startup task %s is still running, leaving it behind", graph->tasks[id].name);
+            }
+        }
+        fde_workqueue_abandon(graph->wq);
+        return false;
+    }
+    if (graph->wq) {
+        fde_workqueue_destroy(graph->wq);
+    }
+    close(graph->event_fd);
+    free(graph);
+    return true;
+}
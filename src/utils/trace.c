@@ -0,0 +1,291 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fde/utils/hashmap.h>
+#include <fde/utils/log.h>
+#include <fde/utils/trace.h>
+
+_Atomic bool fde_trace_enabled = false;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+static _Atomic uint32_t trace_session = 0;  // Bumped by every fde_trace_start
+static bool trace_running = false;
+static char trace_dir_path[256];
+static FILE *trace_names = NULL;
+
+// All sites that got an id, rewritten into the names file of every new session
+static fde_trace_site_t **sites = NULL;
+static uint32_t num_sites = 0, sites_capacity = 0;
+static fde_hashmap_t dynamic_sites;  // name -> fde_trace_site_t, see fde_trace_site
+static bool dynamic_sites_ready = false;
+
+typedef struct trace_thread {
+    uint32_t session;
+    fde_trace_file_header_t *header;  // NULL if the ring could not be mapped
+    fde_trace_record_t *records;
+    size_t map_size;
+} trace_thread_t;
+
+static _Thread_local trace_thread_t local;
+
+static void unmap_thread(trace_thread_t *thread) {
+    if (thread->header) {
+        munmap(thread->header, thread->map_size);
+    }
+    thread->header = NULL;
+    thread->records = NULL;
+}
+
+static void thread_exit(void *data) {
+    unmap_thread(data);
+}
+
+// Форкнутый ребёнок (запуск плагина) не должен писать в файлы родителя
+static void atfork_child(void) {
+    atomic_store_explicit(&fde_trace_enabled, false, memory_order_relaxed);
+    local.header = NULL;
+    local.records = NULL;
+}
+
+static void trace_init_once(void) {
+    pthread_key_create(&trace_key, thread_exit);
+    pthread_atfork(NULL, NULL, atfork_child);
+}
+
+static void write_site_name(fde_trace_site_t *site) {
+    fprintf(trace_names, "%u %s\n", (unsigned)atomic_load_explicit(&site->id, memory_order_relaxed), site->name);
+    fflush(trace_names);
+}
+
+static uint32_t register_site(fde_trace_site_t *site) {
+    pthread_mutex_lock(&trace_lock);
+    uint32_t id = atomic_load_explicit(&site->id, memory_order_relaxed);
+    if (!id) {
+        if (num_sites == sites_capacity) {
+            uint32_t capacity = sites_capacity ? sites_capacity * 2 : 64;
+            fde_trace_site_t **grown = realloc(sites, capacity * sizeof(*sites));
+            if (!grown) {
+                pthread_mutex_unlock(&trace_lock);
+                return 0;
+            }
+            sites = grown;
+            sites_capacity = capacity;
+        }
+        sites[num_sites++] = site;
+        id = num_sites;
+        atomic_store_explicit(&site->id, id, memory_order_release);
+        if (trace_names) {
+            write_site_name(site);
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    return id;
+}
+
+static bool map_thread_ring(uint32_t session) {
+    unmap_thread(&local);
+    local.session = session;
+
+    char dir[sizeof(trace_dir_path)], path[sizeof(trace_dir_path) + 48];
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    pthread_mutex_lock(&trace_lock);
+    bool current = trace_running && session == atomic_load_explicit(&trace_session, memory_order_relaxed);
+    if (current) {
+        memcpy(dir, trace_dir_path, sizeof(dir));
+    }
+    pthread_mutex_unlock(&trace_lock);
+    if (!current) {
+        return false;
+    }
+
+    size_t size = sizeof(fde_trace_file_header_t) + FDE_TRACE_RING_RECORDS * sizeof(fde_trace_record_t);
+    // Never reuse or follow an existing file; a recycled tid gets a numbered name
+    int fd = -1;
+    for (unsigned n = 0; fd < 0 && n < 16; n++) {
+        if (n == 0) {
+            snprintf(path, sizeof(path), "%s/thread-%d.trace", dir, (int)tid);
+        } else {
+            snprintf(path, sizeof(path), "%s/thread-%d-%u.trace", dir, (int)tid, n);
+        }
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+        if (fd < 0 && errno != EEXIST) break;
+    }
+    if (fd < 0) {
+        fde_log(FDE_ERROR, "Failed to create trace ring %s: %s", path, strerror(errno));
+        return false;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        fde_log(FDE_ERROR, "Failed to map trace ring %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    fde_trace_file_header_t *header = map;
+    memcpy(header->magic, FDE_TRACE_MAGIC, sizeof(header->magic));
+    header->version = FDE_TRACE_VERSION;
+    header->record_size = sizeof(fde_trace_record_t);
+    header->pid = (int32_t)getpid();
+    header->tid = (int32_t)tid;
+    header->capacity = FDE_TRACE_RING_RECORDS;
+    atomic_store_explicit(&header->written, 0, memory_order_relaxed);
+    prctl(PR_GET_NAME, header->thread_name);
+
+    local.header = header;
+    local.records = (fde_trace_record_t *)(header + 1);
+    local.map_size = size;
+    pthread_setspecific(trace_key, &local);
+    return true;
+}
+
+void fde_trace_record(fde_trace_site_t *site, fde_trace_type_t type, int64_t value) {
+    uint32_t id = atomic_load_explicit(&site->id, memory_order_acquire);
+    if (!id && !(id = register_site(site))) {
+        return;
+    }
+
+    uint32_t session = atomic_load_explicit(&trace_session, memory_order_acquire);
+    if (local.session != session && !map_thread_ring(session)) {
+        return;
+    }
+    fde_trace_file_header_t *header = local.header;
+    if (!header) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Единственный писатель кольца - этот поток; читатель (fde-trace) смотрит на written
+    uint64_t written = atomic_load_explicit(&header->written, memory_order_relaxed);
+    fde_trace_record_t *record = &local.records[written % FDE_TRACE_RING_RECORDS];
+    record->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    record->site = id;
+    record->type = type;
+    record->value = value;
+    atomic_store_explicit(&header->written, written + 1, memory_order_release);
+}
+
+fde_trace_site_t *fde_trace_site(const char *name) {
+    pthread_mutex_lock(&trace_lock);
+    if (!dynamic_sites_ready) {
+        fde_hashmap_init(&dynamic_sites, true);
+        dynamic_sites_ready = true;
+    }
+    fde_trace_site_t *site = fde_hashmap_get_str(&dynamic_sites, name);
+    if (!site) {
+        site = calloc(1, sizeof(fde_trace_site_t));
+        char *copy = strdup(name);
+        if (!site || !copy || !fde_hashmap_set_str(&dynamic_sites, copy, site)) {
+            free(site);
+            free(copy);
+            site = NULL;
+        } else {
+            site->name = copy;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    return site;
+}
+
+const char *fde_trace_start(void) {
+    pthread_once(&trace_once, trace_init_once);
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_running) {
+        pthread_mutex_unlock(&trace_lock);
+        return trace_dir_path;
+    }
+
+    const char *base = getenv("XDG_RUNTIME_DIR");
+    uint32_t session = atomic_load_explicit(&trace_session, memory_order_relaxed) + 1;
+    // mkdtemp: новый каталог 0700 с непредсказуемым именем, чужой каталог или symlink в /tmp не подсунуть
+    snprintf(trace_dir_path, sizeof(trace_dir_path), "%s/fde-trace-%d-%u-XXXXXX",
+        base ? base : "/tmp", (int)getpid(), (unsigned)session);
+    if (!mkdtemp(trace_dir_path)) {
+        fde_log(FDE_ERROR, "Failed to create trace directory %s: %s", trace_dir_path, strerror(errno));
+        pthread_mutex_unlock(&trace_lock);
+        return NULL;
+    }
+
+    char names_path[sizeof(trace_dir_path) + 8];
+    snprintf(names_path, sizeof(names_path), "%s/names", trace_dir_path);
+    int names_fd = open(names_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    trace_names = names_fd >= 0 ? fdopen(names_fd, "w") : NULL;
+    if (!trace_names) {
+        if (names_fd >= 0) close(names_fd);
+        fde_log(FDE_ERROR, "Failed to create %s: %s", names_path, strerror(errno));
+        pthread_mutex_unlock(&trace_lock);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < num_sites; i++) {
+        write_site_name(sites[i]);
+    }
+
+    trace_running = true;
+    atomic_store_explicit(&trace_session, session, memory_order_release);
+    atomic_store_explicit(&fde_trace_enabled, true, memory_order_release);
+    pthread_mutex_unlock(&trace_lock);
+
+    fde_log(FDE_INFO, "Tracing to %s", trace_dir_path);
+    return trace_dir_path;
+}
+
+void fde_trace_stop(void) {
+    pthread_mutex_lock(&trace_lock);
+    atomic_store_explicit(&fde_trace_enabled, false, memory_order_release);
+    if (trace_running) {
+        fclose(trace_names);
+        trace_names = NULL;
+        trace_running = false;
+        fde_log(FDE_INFO, "Tracing stopped, recording left in %s", trace_dir_path);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+const char *fde_trace_dir(void) {
+    pthread_mutex_lock(&trace_lock);
+    const char *dir = trace_running ? trace_dir_path : NULL;
+    pthread_mutex_unlock(&trace_lock);
+    return dir;
+}
+
+void fde_trace_finish(void) {
+    fde_trace_stop();
+    unmap_thread(&local);
+
+    pthread_mutex_lock(&trace_lock);
+    if (dynamic_sites_ready) {
+        size_t it = 0;
+        fde_hashmap_entry_t *entry;
+        while ((entry = fde_hashmap_next(&dynamic_sites, &it))) {
+            fde_trace_site_t *site = entry->value;
+            free((char *)site->name);
+            free(site);
+        }
+        fde_hashmap_finish(&dynamic_sites);
+        dynamic_sites_ready = false;
+    }
+    free(sites);
+    sites = NULL;
+    num_sites = sites_capacity = 0;
+    pthread_mutex_unlock(&trace_lock);
+}
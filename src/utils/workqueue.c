@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fde/utils/log.h>
+#include <fde/utils/workqueue.h>
+
+#define MAX_WORKERS 64
+
+typedef struct fde_work {
+    fde_work_fn_t fn;
+    void *data;
+    struct fde_work *next;
+} fde_work_t;
+
+struct fde_workqueue {
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+
+    fde_work_t *head, *tail;
+    size_t pending;  // Queued + running
+    bool stopping;
+    bool abandoned;  // The last exiting worker frees the queue
+    int alive;       // Workers that have not exited yet
+
+    int num_threads;
+    pthread_t threads[MAX_WORKERS];
+};
+
+static void free_workqueue(fde_workqueue_t *wq) {
+    pthread_cond_destroy(&wq->work_done);
+    pthread_cond_destroy(&wq->work_ready);
+    pthread_mutex_destroy(&wq->lock);
+    free(wq);
+}
+
+static void *worker_main(void *arg) {
+    fde_workqueue_t *wq = arg;
+    pthread_mutex_lock(&wq->lock);
+    for (;;) {
+        while (!wq->head && !wq->stopping) {
+            pthread_cond_wait(&wq->work_ready, &wq->lock);
+        }
+        if (!wq->head || wq->abandoned) break;  // stopping and drained
+
+        fde_work_t *work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) wq->tail = NULL;
+        pthread_mutex_unlock(&wq->lock);
+
+        work->fn(work->data);
+        free(work);
+
+        pthread_mutex_lock(&wq->lock);
+        if (--wq->pending == 0) {
+            pthread_cond_broadcast(&wq->work_done);
+        }
+    }
+    bool last = --wq->alive == 0 && wq->abandoned;
+    pthread_mutex_unlock(&wq->lock);
+    if (last) {
+        free_workqueue(wq);
+    }
+    return NULL;
+}
+
+fde_workqueue_t *fde_workqueue_create(int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > MAX_WORKERS) threads = MAX_WORKERS;
+
+    fde_workqueue_t *wq = calloc(1, sizeof(fde_workqueue_t));
+    if (!wq) {
+        return NULL;
+    }
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_cond_init(&wq->work_ready, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wq->work_done, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&wq->threads[i], NULL, worker_main, wq) != 0) {
+            fde_log(FDE_ERROR, "Failed to start worker thread %d", i);
+            break;
+        }
+        wq->num_threads++;
+        wq->alive++;
+    }
+    if (!wq->num_threads) {
+        fde_workqueue_destroy(wq);
+        return NULL;
+    }
+    return wq;
+}
+
+void fde_workqueue_destroy(fde_workqueue_t *wq) {
+    if (!wq) return;
+
+    pthread_mutex_lock(&wq->lock);
+    wq->stopping = true;
+    pthread_cond_broadcast(&wq->work_ready);
+    pthread_mutex_unlock(&wq->lock);
+
+    for (int i = 0; i < wq->num_threads; i++) {
+        pthread_join(wq->threads[i], NULL);
+    }
+    free_workqueue(wq);
+}
+
+void fde_workqueue_abandon(fde_workqueue_t *wq) {
+    if (!wq) return;
+
+    pthread_mutex_lock(&wq->lock);
+    while (wq->head) {
+        fde_work_t *work = wq->head;
+        wq->head = work->next;
+        free(work);
+        wq->pending--;
+    }
+    wq->tail = NULL;
+    wq->stopping = true;
+    wq->abandoned = true;
+    for (int i = 0; i < wq->num_threads; i++) {
+        pthread_detach(wq->threads[i]);
+    }
+    pthread_cond_broadcast(&wq->work_ready);
+    bool last = wq->alive == 0;
+    pthread_mutex_unlock(&wq->lock);
+    if (last) {
+        free_workqueue(wq);
+    }
+}
+
+bool fde_workqueue_push(fde_workqueue_t *wq, fde_work_fn_t fn, void *data) {
+    fde_work_t *work = malloc(sizeof(fde_work_t));
+    if (!work) {
+        return false;
+    }
+    work->fn = fn;
+    work->data = data;
+    work->next = NULL;
+
+    pthread_mutex_lock(&wq->lock);
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wq->pending++;
+    pthread_cond_signal(&wq->work_ready);
+    pthread_mutex_unlock(&wq->lock);
+    return true;
+}
+
+void fde_workqueue_wait(fde_workqueue_t *wq) {
+    pthread_mutex_lock(&wq->lock);
+    while (wq->pending) {
+        pthread_cond_wait(&wq->work_done, &wq->lock);
+    }
+    pthread_mutex_unlock(&wq->lock);
+}
+
+bool fde_workqueue_wait_timeout(fde_workqueue_t *wq, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&wq->lock);
+    int ret = 0;
+    while (wq->pending && ret == 0) {
+        ret = pthread_cond_timedwait(&wq->work_done, &wq->lock, &deadline);
+    }
+    bool done = wq->pending == 0;
+    pthread_mutex_unlock(&wq->lock);
+    return done;
+}
+
+int fde_workqueue_threads(const fde_workqueue_t *wq) {
+    return wq->num_threads;
+}